@@ -0,0 +1,421 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "../include/ringbuf.h"
+#include "../include/ringgroup.h"
+#include "../include/slotring.h"
+
+/* Throughput and latency of the ringbuffer under a sweep of configurations.
+ * Every combination of mode, framing, api, producer/consumer count, message size
+ * and ring size moves the same number of messages through a fresh ring.
+ * Each message carries the CLOCK_MONOTONIC time its producer started writing it,
+ * the consumer that gets it records the difference as the message's latency.
+ *
+ * usage: ringbench [-f csv|json] [-n messages] [-m modes] [-F framings] [-a apis]
+ *                  [-p producers] [-c consumers] [-s message sizes] [-r ring sizes]
+ * lists are comma separated, e.g. ringbench -m mpmc,group -p 1,4 -s 64 -f json
+ *
+ * modes: locked, spsc, mpmc, slots (fixed slot ring) and group (one SPSC shard per producer,
+ * consumers take turns over the shards like the daemon's reader threads)
+ * apis: spin (ringbuffer_write/read, yielding on RINGBUFFER_FULL/EMPTY) and wait (the *_wait variants) */
+
+#define MAX_LIST 16
+#define MAX_THREADS 64
+#define MAX_MESSAGE 65536
+#define STAMP_SIZE sizeof(uint64_t)
+#define POLL_NS 1000000L    // consumers re-check for the end of a run every millisecond
+
+enum { MODE_LOCKED, MODE_SPSC, MODE_MPMC, MODE_SLOTS, MODE_GROUP, MODE_COUNT };
+enum { API_SPIN, API_WAIT, API_COUNT };
+
+static const char *mode_names[MODE_COUNT] = {"locked", "spsc", "mpmc", "slots", "group"};
+static const char *api_names[API_COUNT] = {"spin", "wait"};
+
+typedef struct {
+    size_t values[MAX_LIST];
+    size_t count;
+} list_t;
+
+typedef struct {
+    int mode;
+    int framing;
+    int api;
+    size_t producers;
+    size_t consumers;
+    size_t message_size;
+    size_t ring_size;
+    size_t messages;
+} config_t;
+
+typedef struct {
+    double seconds;
+    uint64_t p50, p99, p999;
+} result_t;
+
+typedef struct {
+    const config_t *config;
+    rbctx_t *ring;              /* the producer's ring: the shared one, or its own group shard */
+    rbgroup_t *group;
+    size_t count;               /* messages to produce */
+    uint64_t *latencies;        /* consumer: one per message received */
+    size_t received;
+    _Atomic size_t *consumed;
+} worker_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *produce(void *arg) {
+    worker_t *worker = arg;
+    const config_t *config = worker->config;
+    uint8_t message[MAX_MESSAGE];
+    memset(message, 'x', config->message_size);
+
+    for (size_t i = 0; i < worker->count; i++) {
+        uint64_t stamp = now_ns();
+        memcpy(message, &stamp, STAMP_SIZE);
+        if (config->api == API_WAIT) {
+            ringbuffer_write_wait(worker->ring, message, config->message_size, NULL);
+        } else {
+            while (ringbuffer_write(worker->ring, message, config->message_size) != SUCCESS) {
+                sched_yield();
+            }
+        }
+    }
+    return NULL;
+}
+
+/* one message from the group into message, SUCCESS or RINGBUFFER_EMPTY */
+static int group_read(worker_t *worker, uint8_t *message, const struct timespec *deadline) {
+    rbspan_t span;
+    size_t shard;
+    int ret = worker->config->api == API_WAIT
+        ? ringbuffer_group_peek_wait(worker->group, &span, &shard, deadline)
+        : ringbuffer_group_peek(worker->group, &span, &shard);
+    if (ret != SUCCESS) {
+        return ret;
+    }
+    ringbuffer_span_copy_out(&span, 0, message, worker->config->message_size);
+    ringbuffer_group_consume(worker->group, shard, &span);
+    return SUCCESS;
+}
+
+static void *consume(void *arg) {
+    worker_t *worker = arg;
+    const config_t *config = worker->config;
+    uint8_t message[MAX_MESSAGE];
+    struct timespec deadline;
+
+    while (atomic_load(worker->consumed) < config->messages) {
+        size_t len = sizeof(message);
+        int ret;
+        ringbuffer_deadline(&deadline, POLL_NS);
+        if (config->mode == MODE_GROUP) {
+            ret = group_read(worker, message, &deadline);
+        } else if (config->api == API_WAIT) {
+            ret = ringbuffer_read_wait(worker->ring, message, &len, &deadline);
+        } else {
+            ret = ringbuffer_read(worker->ring, message, &len);
+        }
+        if (ret != SUCCESS) {
+            if (config->api == API_SPIN) {
+                sched_yield();
+            }
+            continue;
+        }
+
+        uint64_t stamp;
+        memcpy(&stamp, message, STAMP_SIZE);
+        worker->latencies[worker->received++] = now_ns() - stamp;
+        atomic_fetch_add(worker->consumed, 1);
+    }
+    return NULL;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(const uint64_t *sorted, size_t count, double fraction) {
+    size_t index = (size_t) (fraction * count);
+    return sorted[index < count ? index : count - 1];
+}
+
+/* the rings of one run, mode decides which of them are used */
+typedef struct {
+    rbctx_t ring;
+    slotring_t slots;
+    void *slot_memory;
+    rbshard_t shards[MAX_THREADS];
+    rbgroup_t group;
+} bench_rings_t;
+
+static int rings_create(bench_rings_t *rings, const config_t *config) {
+    // leave room for the record header, a record as large as the ring would never be written
+    if (config->mode != MODE_SLOTS && config->message_size + 2 * STAMP_SIZE > config->ring_size) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    switch (config->mode) {
+    case MODE_SLOTS:
+        rings->slot_memory = aligned_alloc(RBUF_CACHE_LINE, config->ring_size);
+        if (rings->slot_memory == NULL ||
+            slotring_init(&rings->slots, rings->slot_memory, config->ring_size, config->message_size) != SUCCESS) {
+            free(rings->slot_memory);
+            return RINGBUFFER_ALLOC_FAILED;
+        }
+        ringbuffer_init_slotring(&rings->ring, &rings->slots);
+        return SUCCESS;
+    case MODE_GROUP:
+        for (size_t i = 0; i < config->producers; i++) {
+            if (ringbuffer_create(&rings->shards[i].ring, config->ring_size,
+                                  RBUF_SPSC | config->framing | RBUF_PREFAULT) != SUCCESS) {
+                while (i-- > 0) {
+                    ringbuffer_free(&rings->shards[i].ring);
+                }
+                return RINGBUFFER_ALLOC_FAILED;
+            }
+        }
+        ringbuffer_group_init(&rings->group, rings->shards, config->producers);
+        return SUCCESS;
+    default: {
+        int sync = config->mode == MODE_MPMC ? RBUF_MPMC : config->mode == MODE_SPSC ? RBUF_SPSC : RBUF_LOCKED;
+        return ringbuffer_create(&rings->ring, config->ring_size, sync | config->framing | RBUF_PREFAULT);
+    }
+    }
+}
+
+static void rings_free(bench_rings_t *rings, const config_t *config) {
+    switch (config->mode) {
+    case MODE_SLOTS:
+        ringbuffer_destroy(&rings->ring);
+        free(rings->slot_memory);
+        break;
+    case MODE_GROUP:
+        ringbuffer_group_destroy(&rings->group);
+        for (size_t i = 0; i < config->producers; i++) {
+            ringbuffer_free(&rings->shards[i].ring);
+        }
+        break;
+    default:
+        ringbuffer_free(&rings->ring);
+    }
+}
+
+static int run(const config_t *config, result_t *result) {
+    bench_rings_t rings;
+    if (rings_create(&rings, config) != SUCCESS) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+
+    _Atomic size_t consumed = 0;
+    worker_t producers[MAX_THREADS], consumers[MAX_THREADS];
+    pthread_t producer_threads[MAX_THREADS], consumer_threads[MAX_THREADS];
+
+    for (size_t i = 0; i < config->consumers; i++) {
+        consumers[i] = (worker_t) {.config = config, .ring = &rings.ring, .group = &rings.group, .consumed = &consumed};
+        consumers[i].latencies = malloc(config->messages * sizeof(uint64_t));
+        if (consumers[i].latencies == NULL) {
+            fprintf(stderr, "Cannot allocate latency samples\n");
+            exit(1);
+        }
+    }
+    for (size_t i = 0; i < config->producers; i++) {
+        producers[i] = (worker_t) {.config = config, .ring = &rings.ring};
+        if (config->mode == MODE_GROUP) {
+            producers[i].ring = ringbuffer_group_shard(&rings.group, i);
+        }
+        // the first producers take the remainder
+        producers[i].count = config->messages / config->producers + (i < config->messages % config->producers);
+    }
+
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < config->consumers; i++) {
+        pthread_create(&consumer_threads[i], NULL, consume, &consumers[i]);
+    }
+    for (size_t i = 0; i < config->producers; i++) {
+        pthread_create(&producer_threads[i], NULL, produce, &producers[i]);
+    }
+    for (size_t i = 0; i < config->producers; i++) {
+        pthread_join(producer_threads[i], NULL);
+    }
+    for (size_t i = 0; i < config->consumers; i++) {
+        pthread_join(consumer_threads[i], NULL);
+    }
+    result->seconds = (now_ns() - start) / 1e9;
+
+    // gather all latencies behind the first consumer's
+    uint64_t *latencies = consumers[0].latencies;
+    size_t count = consumers[0].received;
+    for (size_t i = 1; i < config->consumers; i++) {
+        memcpy(latencies + count, consumers[i].latencies, consumers[i].received * sizeof(uint64_t));
+        count += consumers[i].received;
+        free(consumers[i].latencies);
+    }
+    qsort(latencies, count, sizeof(uint64_t), compare_u64);
+    result->p50 = percentile(latencies, count, 0.50);
+    result->p99 = percentile(latencies, count, 0.99);
+    result->p999 = percentile(latencies, count, 0.999);
+    free(latencies);
+
+    rings_free(&rings, config);
+    return SUCCESS;
+}
+
+static void print_result(const config_t *config, const result_t *result, int json, int first) {
+    const char *framing = config->mode == MODE_SLOTS ? "slot" : config->framing == RBUF_FRAME_VARINT ? "varint" : "fixed";
+    double msgs_per_s = config->messages / result->seconds;
+
+    if (json) {
+        printf("%s  {\"mode\": \"%s\", \"framing\": \"%s\", \"api\": \"%s\", \"producers\": %zu, \"consumers\": %zu, "
+               "\"msg_size\": %zu, \"ring_size\": %zu, \"messages\": %zu, \"seconds\": %.6f, "
+               "\"msgs_per_s\": %.0f, \"bytes_per_s\": %.0f, \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu}",
+               first ? "" : ",\n", mode_names[config->mode], framing, api_names[config->api],
+               config->producers, config->consumers, config->message_size, config->ring_size, config->messages,
+               result->seconds, msgs_per_s, msgs_per_s * config->message_size,
+               (unsigned long long) result->p50, (unsigned long long) result->p99, (unsigned long long) result->p999);
+    } else {
+        printf("%s,%s,%s,%zu,%zu,%zu,%zu,%zu,%.6f,%.0f,%.0f,%llu,%llu,%llu\n",
+               mode_names[config->mode], framing, api_names[config->api],
+               config->producers, config->consumers, config->message_size, config->ring_size, config->messages,
+               result->seconds, msgs_per_s, msgs_per_s * config->message_size,
+               (unsigned long long) result->p50, (unsigned long long) result->p99, (unsigned long long) result->p999);
+    }
+    fflush(stdout);
+}
+
+/* parse a comma separated list of numbers, or of names when names is not NULL */
+static int parse_list(const char *arg, list_t *list, const char **names, size_t name_count) {
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", arg);
+    list->count = 0;
+    for (char *item = strtok(copy, ","); item != NULL; item = strtok(NULL, ",")) {
+        if (list->count == MAX_LIST) {
+            return -1;
+        }
+        if (names == NULL) {
+            char *end;
+            list->values[list->count] = strtoull(item, &end, 10);
+            if (*end != '\0') {
+                return -1;
+            }
+        } else {
+            size_t i = 0;
+            while (i < name_count && strcmp(item, names[i]) != 0) {
+                i++;
+            }
+            if (i == name_count) {
+                return -1;
+            }
+            list->values[list->count] = i;
+        }
+        list->count++;
+    }
+    return list->count > 0 ? 0 : -1;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-f csv|json] [-n messages] [-m locked,spsc,mpmc,slots,group] [-F fixed,varint]\n"
+                    "          [-a spin,wait] [-p producers] [-c consumers] [-s message sizes] [-r ring sizes]\n", name);
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    static const char *framing_names[] = {"fixed", "varint"};
+    static const char *format_names[] = {"csv", "json"};
+    list_t modes = {{MODE_LOCKED, MODE_SPSC, MODE_MPMC, MODE_SLOTS, MODE_GROUP}, 5};
+    list_t framings = {{0}, 1};
+    list_t apis = {{API_SPIN, API_WAIT}, 2};
+    list_t producers = {{1, 2, 4}, 3};
+    list_t consumers = {{1, 2, 4}, 3};
+    list_t sizes = {{16, 256, 1024}, 3};
+    list_t ring_sizes = {{4096, 262144}, 2};
+    list_t format = {{0}, 1};
+    size_t messages = 100000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:n:m:F:a:p:c:s:r:")) != -1) {
+        int bad = 0;
+        switch (opt) {
+        case 'f': bad = parse_list(optarg, &format, format_names, 2); break;
+        case 'n': messages = strtoull(optarg, NULL, 10); bad = messages == 0; break;
+        case 'm': bad = parse_list(optarg, &modes, mode_names, MODE_COUNT); break;
+        case 'F': bad = parse_list(optarg, &framings, framing_names, 2); break;
+        case 'a': bad = parse_list(optarg, &apis, api_names, API_COUNT); break;
+        case 'p': bad = parse_list(optarg, &producers, NULL, 0); break;
+        case 'c': bad = parse_list(optarg, &consumers, NULL, 0); break;
+        case 's': bad = parse_list(optarg, &sizes, NULL, 0); break;
+        case 'r': bad = parse_list(optarg, &ring_sizes, NULL, 0); break;
+        default: bad = 1;
+        }
+        if (bad) {
+            usage(argv[0]);
+        }
+    }
+    for (size_t i = 0; i < sizes.count; i++) {
+        if (sizes.values[i] < STAMP_SIZE || sizes.values[i] > MAX_MESSAGE) {
+            fprintf(stderr, "message sizes must be between %zu and %d bytes\n", STAMP_SIZE, MAX_MESSAGE);
+            return 2;
+        }
+    }
+    for (size_t i = 0; i < producers.count; i++) {
+        if (producers.values[i] == 0 || producers.values[i] > MAX_THREADS) usage(argv[0]);
+    }
+    for (size_t i = 0; i < consumers.count; i++) {
+        if (consumers.values[i] == 0 || consumers.values[i] > MAX_THREADS) usage(argv[0]);
+    }
+
+    int json = format.values[0] == 1;
+    printf(json ? "[\n" : "mode,framing,api,producers,consumers,msg_size,ring_size,messages,"
+                          "seconds,msgs_per_s,bytes_per_s,p50_ns,p99_ns,p999_ns\n");
+
+    int first = 1;
+    for (size_t m = 0; m < modes.count; m++)
+    for (size_t f = 0; f < framings.count; f++)
+    for (size_t a = 0; a < apis.count; a++)
+    for (size_t p = 0; p < producers.count; p++)
+    for (size_t c = 0; c < consumers.count; c++)
+    for (size_t s = 0; s < sizes.count; s++)
+    for (size_t r = 0; r < ring_sizes.count; r++) {
+        config_t config = {
+            .mode = modes.values[m],
+            .framing = framings.values[f] ? RBUF_FRAME_VARINT : RBUF_FRAME_FIXED,
+            .api = apis.values[a],
+            .producers = producers.values[p],
+            .consumers = consumers.values[c],
+            .message_size = sizes.values[s],
+            .ring_size = ring_sizes.values[r],
+            .messages = messages,
+        };
+        // slot rings have no framing of their own, run them once
+        if (config.mode == MODE_SLOTS && f > 0) {
+            continue;
+        }
+        // one producer and one consumer is all an SPSC ring takes
+        if (config.mode == MODE_SPSC && (config.producers > 1 || config.consumers > 1)) {
+            continue;
+        }
+
+        result_t result;
+        if (run(&config, &result) != SUCCESS) {
+            fprintf(stderr, "skipped %s: a %zu byte ring cannot hold %zu byte messages\n",
+                    mode_names[config.mode], config.ring_size, config.message_size);
+            continue;
+        }
+        print_result(&config, &result, json, first);
+        first = 0;
+    }
+
+    if (json) {
+        printf("\n]\n");
+    }
+    return 0;
+}
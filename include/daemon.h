@@ -9,11 +9,48 @@ typedef struct {
 
 #define MESSAGE_SIZE 128    
 #define MINIMUM_PORT 0          /* this will always be 0 */
-#define MAXIMUM_PORT 128
-#define NUMBER_OF_PROCESSING_THREADS 4
+#define MAXIMUM_PORT 65535      /* ports are 16 bits */
+#ifndef NUMBER_OF_PROCESSING_THREADS
+#define NUMBER_OF_PROCESSING_THREADS 4  /* packets leave in order however many there are */
+#endif
+#define DAEMON_THREADS_AUTO 0       /* daemon_config_t.threads: scale between min_threads and max_threads */
+#define DAEMON_MAX_THREADS 1024     /* the most processing threads the environment can ask for */
+
+/* daemon_config_t.match: what the content rules see */
+#define DAEMON_MATCH_PACKET 0       /* every payload on its own */
+#define DAEMON_MATCH_STREAM 1       /* a connection's payloads in packet_id order, as one stream */
+
+/* what the daemon runs with, chosen at startup */
+typedef struct {
+    int threads;        /* processing threads, a fixed number or DAEMON_THREADS_AUTO */
+    int min_threads;    /* auto: never fewer, 0 for 1 */
+    int max_threads;    /* auto: never more, 0 for the number of online cpus */
+    const char *rules_file; /* filter rules, see rules.h, NULL for the built-in ones */
+    int match;          /* DAEMON_MATCH_PACKET or DAEMON_MATCH_STREAM */
+} daemon_config_t;
+
+/**
+ * @brief Fill in the processing pool from RBUF_THREADS (a number or "auto"), RBUF_THREADS_MIN
+ * and RBUF_THREADS_MAX, the filter rules from RBUF_RULES_FILE and RBUF_MATCH ("packet" or "stream").
+ * Without them the daemon runs NUMBER_OF_PROCESSING_THREADS threads with the built-in rules,
+ * matched per packet. A thread count that is not a number up to DAEMON_MAX_THREADS ends the program.
+ *
+ * @param config filled in
+ */
+void daemon_config_from_env(daemon_config_t *config);
+
+/**
+ * @brief simpledaemon with an explicit configuration
+ *
+ * @param connections
+ * @param number_of_connections
+ * @param config processing threads and filter rules
+ * @return int
+ */
+int simpledaemon_config(connection_t *connections, int number_of_connections, const daemon_config_t *config);
 
 /**
- * @brief simpledaemon
+ * @brief simpledaemon, configured by daemon_config_from_env
  * 
  * @param connections 
  * @param number_of_connections
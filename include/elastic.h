@@ -0,0 +1,111 @@
+#ifndef ELASTIC_H
+#define ELASTIC_H
+
+#include "ringbuf.h"
+
+/* when an elastic ring grows and shrinks */
+typedef struct {
+    size_t initial_size;        /* the ring starts with this and never shrinks below it */
+    size_t max_size;            /* memory cap, the ring never grows beyond it */
+    unsigned int high_water;    /* percent of the ring in use that counts as backpressure */
+    unsigned int low_water;     /* percent of the ring in use that counts as idle */
+    long grow_after_ns;         /* backpressure has to last this long before the ring doubles */
+    long shrink_after_ns;       /* idleness has to last this long before the ring halves */
+} rbelastic_config_t;
+
+#define RBUF_ELASTIC_DEFAULT_HIGH_WATER 75
+#define RBUF_ELASTIC_DEFAULT_LOW_WATER 10
+
+/**
+ * A ringbuffer that moves its records to a larger ring under sustained backpressure
+ * and back to a smaller one when it is idle, keeping their order.
+ * Operations share a lock that a migration takes exclusively, a reservation or a peek holds it
+ * until its commit/cancel or consume. So a thread must not hold a reservation and a peek at once.
+ */
+typedef struct {
+    rbctx_t rings[2];           /* the active ring and the one a migration moves to */
+    int active;
+    int flags;
+    rbelastic_config_t config;
+    pthread_rwlock_t migration;
+    _Atomic uint64_t high_since;    /* when the ring went above high_water, 0 if it isn't */
+    _Atomic uint64_t low_since;     /* when the ring went below low_water, 0 if it isn't */
+    _Atomic uint32_t grown;
+    _Atomic uint32_t shrunk;
+    rbsignal_t signal_read;     /* readers sleep here while the ring is empty */
+    rbsignal_t signal_write;    /* writers sleep here while their record doesn't fit */
+} rbelastic_t;
+
+/**
+ * Create an elastic ringbuffer, the rings are made with ringbuffer_create.
+ *
+ * @param elastic elastic ringbuffer
+ * @param config sizes and thresholds, high_water/low_water 0 select the defaults
+ * @param flags flags for ringbuffer_create
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if the first ring could not be created
+ */
+int ringbuffer_elastic_create(rbelastic_t *elastic, const rbelastic_config_t *config, int flags);
+
+/**
+ * Like ringbuffer_reserve. Backpressure is measured here, a reservation may migrate the ring first.
+ */
+int ringbuffer_elastic_reserve(rbelastic_t *elastic, size_t message_len, rbspan_t *span);
+
+/**
+ * Like ringbuffer_commit.
+ */
+void ringbuffer_elastic_commit(rbelastic_t *elastic, rbspan_t *span, size_t message_len);
+
+/**
+ * Like ringbuffer_cancel.
+ */
+void ringbuffer_elastic_cancel(rbelastic_t *elastic, rbspan_t *span);
+
+/**
+ * Like ringbuffer_peek.
+ */
+int ringbuffer_elastic_peek(rbelastic_t *elastic, rbspan_t *span);
+
+/**
+ * Like ringbuffer_consume. Idleness is measured here, a consume may migrate the ring afterwards.
+ */
+void ringbuffer_elastic_consume(rbelastic_t *elastic, rbspan_t *span);
+
+/**
+ * Like ringbuffer_write.
+ */
+int ringbuffer_elastic_write(rbelastic_t *elastic, const void *message, size_t message_len);
+
+/**
+ * Like ringbuffer_read.
+ */
+int ringbuffer_elastic_read(rbelastic_t *elastic, void *buffer, size_t *buffer_len);
+
+/**
+ * Like ringbuffer_write_wait.
+ */
+int ringbuffer_elastic_write_wait(rbelastic_t *elastic, const void *message, size_t message_len,
+                                  const struct timespec *deadline);
+
+/**
+ * Like ringbuffer_read_wait.
+ */
+int ringbuffer_elastic_read_wait(rbelastic_t *elastic, void *buffer, size_t *buffer_len,
+                                 const struct timespec *deadline);
+
+/**
+ * Current size of the ring.
+ *
+ * @param elastic elastic ringbuffer
+ * @return bytes of ring memory
+ */
+size_t ringbuffer_elastic_capacity(rbelastic_t *elastic);
+
+/**
+ * Release the ring and its memory.
+ *
+ * @param elastic elastic ringbuffer
+ */
+void ringbuffer_elastic_free(rbelastic_t *elastic);
+
+#endif //ELASTIC_H
@@ -0,0 +1,137 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "ringbuf.h"
+
+/* when a journal makes its records durable */
+#define RBUF_SYNC_NONE 0        /* never, the kernel writes the pages back when it likes */
+#define RBUF_SYNC_BATCH 1       /* before every write, batch, commit, read or consume returns */
+#define RBUF_SYNC_INTERVAL 2    /* at most every interval_ns, checked by those calls */
+
+/* how it syncs */
+#define RBUF_SYNC_MSYNC 0       /* msync of the pages written since the last sync, then of the metadata */
+#define RBUF_SYNC_FDATASYNC 1   /* fdatasync of the whole file */
+
+typedef struct {
+    int policy;                 /* RBUF_SYNC_NONE, RBUF_SYNC_BATCH or RBUF_SYNC_INTERVAL */
+    int method;                 /* RBUF_SYNC_MSYNC or RBUF_SYNC_FDATASYNC */
+    long interval_ns;           /* RBUF_SYNC_INTERVAL: time between syncs */
+} rbjournal_sync_t;
+
+#define RBUF_JOURNAL_MAGIC "RBUFJNL"
+#define RBUF_JOURNAL_VERSION 2
+
+/* first page of a journal file, the ring memory follows at data_offset.
+ * committed and consumed are the positions a reopened journal resumes from */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;             /* synchronization mode and framing */
+    uint64_t capacity;          /* bytes of ring memory */
+    uint64_t data_offset;       /* from the start of the file, a whole page */
+    char pad[RBUF_CACHE_LINE - 8 - 2 * sizeof(uint32_t) - 2 * sizeof(uint64_t)];
+    rbindex_t committed;        /* every record before it was committed */
+    rbindex_t consumed;         /* every record before it was consumed */
+} rbjournal_header_t;
+
+/**
+ * A ringbuffer in a memory-mapped file that survives its process: reopening the file
+ * resumes with exactly the records that were committed and not yet consumed.
+ * A record being written when the process died is dropped, one being read may or may not
+ * be read again. Any number of threads may write, reads are serialized so that the consumed
+ * position stays exact, a peek holds the read side until its consume.
+ * Reservations can't be cancelled, the read side would release a cancelled record before
+ * the journal could record it as consumed.
+ *
+ * RBUF_SYNC_NONE survives a killed process, whose pages stay in the page cache.
+ * RBUF_SYNC_BATCH also survives a crash of the machine: a call returns only after its records,
+ * or their consumption, are on disk, and data always gets there before the metadata covering it.
+ * RBUF_SYNC_INTERVAL resumes from its last sync, records committed since are lost.
+ */
+typedef struct {
+    rbctx_t ring;
+    rbjournal_header_t *header;
+    size_t mapping_len;
+    size_t page_size;
+    int fd;
+    rbjournal_sync_t sync;
+    pthread_mutex_t reader;         /* held from a peek to its consume */
+    pthread_mutex_t syncing;
+    uint64_t synced_committed;      /* on disk as of the last sync */
+    uint64_t synced_consumed;
+    _Atomic uint64_t last_sync_ns;
+    _Atomic int sync_failed;        /* sticky, pages that failed to sync may be lost */
+} rbjournal_t;
+
+/**
+ * Open a journal file, creating it if it doesn't exist.
+ * An existing journal keeps its size and flags and resumes where it stopped.
+ *
+ * @param journal journal
+ * @param path file name
+ * @param buffer_size size of the ring of a new journal
+ * @param flags RBUF_LOCKED, RBUF_MPMC or RBUF_SPSC, or'ed with the framing flags, for a new journal
+ * @param sync sync policy, NULL for RBUF_SYNC_NONE
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if the file could not be created or mapped,
+ *         RINGBUFFER_INCOMPATIBLE if it isn't a journal of this version
+ */
+int ringbuffer_journal_open(rbjournal_t *journal, const char *path, size_t buffer_size, int flags,
+                            const rbjournal_sync_t *sync);
+
+/**
+ * Like ringbuffer_reserve.
+ */
+int ringbuffer_journal_reserve(rbjournal_t *journal, size_t message_len, rbspan_t *span);
+
+/**
+ * Like ringbuffer_commit. The record survives a restart once this returns, as far as the policy goes.
+ *
+ * @return SUCCESS, or RINGBUFFER_SYNC_FAILED if the record is committed but may not be on disk
+ */
+int ringbuffer_journal_commit(rbjournal_t *journal, rbspan_t *span, size_t message_len);
+
+/**
+ * Like ringbuffer_write, RINGBUFFER_SYNC_FAILED as in ringbuffer_journal_commit.
+ */
+int ringbuffer_journal_write(rbjournal_t *journal, const void *message, size_t message_len);
+
+/**
+ * Like ringbuffer_write_batch, with at most one sync for the whole batch.
+ */
+int ringbuffer_journal_write_batch(rbjournal_t *journal, const struct iovec *messages, size_t count);
+
+/**
+ * Like ringbuffer_peek, the journal's read side stays held until ringbuffer_journal_consume.
+ */
+int ringbuffer_journal_peek(rbjournal_t *journal, rbspan_t *span);
+
+/**
+ * Like ringbuffer_consume. The record is not read again after a restart once this returns.
+ *
+ * @return SUCCESS, or RINGBUFFER_SYNC_FAILED if the record is consumed but that may not be on disk
+ */
+int ringbuffer_journal_consume(rbjournal_t *journal, rbspan_t *span);
+
+/**
+ * Like ringbuffer_read. A message too large for the buffer stays first in line.
+ * RINGBUFFER_SYNC_FAILED as in ringbuffer_journal_consume, the message was read.
+ */
+int ringbuffer_journal_read(rbjournal_t *journal, void *buffer, size_t *buffer_len);
+
+/**
+ * Make everything committed and consumed so far durable, whatever the policy.
+ * Call it from a timer to bound the loss of an idle RBUF_SYNC_INTERVAL journal.
+ *
+ * @param journal journal
+ * @return SUCCESS, or RINGBUFFER_SYNC_FAILED if msync or fdatasync failed, now or before
+ */
+int ringbuffer_journal_sync(rbjournal_t *journal);
+
+/**
+ * Sync and close the journal, the file stays.
+ *
+ * @param journal journal
+ */
+void ringbuffer_journal_close(rbjournal_t *journal);
+
+#endif //JOURNAL_H
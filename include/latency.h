@@ -0,0 +1,98 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+/* log-linear (HDR style) histogram: values below 2^LATENCY_SUB_BITS get a bucket each,
+ * above that every power of two is split into 2^LATENCY_SUB_BITS buckets, so a value is
+ * reported at most 1/2^LATENCY_SUB_BITS (about 3%) too high */
+#define LATENCY_SUB_BITS 5
+#define LATENCY_MAX_BITS 40     /* 2^40 ns is about 18 minutes, longer is counted as that */
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+
+/* X(id, name) of the stages a packet goes through */
+#define LATENCY_STAGES(X) \
+    X(LATENCY_RING, "ring") \
+    X(LATENCY_VALIDATE, "validate") \
+    X(LATENCY_ROUTE, "route") \
+    X(LATENCY_REORDER, "reorder") \
+    X(LATENCY_WRITE, "write") \
+    X(LATENCY_TOTAL, "total")
+
+#define LATENCY_ENUM(id, name) id,
+enum { LATENCY_STAGES(LATENCY_ENUM) LATENCY_NUMBER_OF_STAGES };
+#undef LATENCY_ENUM
+
+/* written by one thread, the counters are atomic so that others can merge it any time */
+typedef struct {
+    _Atomic uint64_t counts[LATENCY_BUCKETS];
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+} latency_hist_t;
+
+extern _Atomic int latency_enabled;
+
+/**
+ * Turn latency recording on or off. Packet layouts depend on it, so set it before the threads start.
+ *
+ * @param enabled 0 or 1
+ */
+void latency_set_enabled(int enabled);
+
+/**
+ * Turn latency recording on if the RBUF_LATENCY environment variable is 1.
+ *
+ * @return the report file named by RBUF_LATENCY_FILE, NULL to print it to stdout
+ */
+const char *latency_configure_from_env(void);
+
+/**
+ * Add a value to a histogram. Only one thread may record into a histogram at a time.
+ *
+ * @param hist histogram
+ * @param ns the latency
+ */
+void latency_hist_record(latency_hist_t *hist, uint64_t ns);
+
+/**
+ * Add all values of src to dst, src may be recorded into meanwhile.
+ */
+void latency_hist_merge(latency_hist_t *dst, latency_hist_t *src);
+
+/**
+ * The value below which a fraction of the recorded values lie, rounded up to its bucket's upper end.
+ *
+ * @param hist histogram
+ * @param fraction between 0 and 1, e.g. 0.999
+ * @return the percentile, 0 if nothing was recorded
+ */
+uint64_t latency_hist_percentile(latency_hist_t *hist, double fraction);
+
+/**
+ * Record the latency of a stage in the calling thread's histograms, if recording is on.
+ * Every thread gets its own histograms on its first record, nothing is shared while recording.
+ *
+ * @param stage stage id
+ * @param ns the latency, e.g. the difference of two ringbuffer_now_ns() values
+ */
+void latency_record(uint32_t stage, uint64_t ns);
+
+/**
+ * Merge the histograms of all threads, it can be called while they keep recording.
+ *
+ * @param stages receives one merged histogram per stage, zeroed before
+ */
+void latency_merge(latency_hist_t stages[LATENCY_NUMBER_OF_STAGES]);
+
+/**
+ * Print a compact table of count, mean and percentiles per stage, for all threads merged.
+ *
+ * @param fp where to print
+ * @return 0 on success, -1 if out of memory
+ */
+int latency_report(FILE *fp);
+
+#endif //LATENCY_H
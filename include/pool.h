@@ -0,0 +1,93 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "ringbuf.h"
+
+/* when a pool adds and parks workers */
+typedef struct {
+    int min_threads;            /* the pool starts with this and never parks below it */
+    int max_threads;            /* it never runs more, equal to min_threads for a fixed pool */
+    unsigned int high_water;    /* percent ring occupancy that asks for another worker */
+    unsigned int low_water;     /* percent ring occupancy that lets a worker go */
+    long scale_after_ns;        /* occupancy has to stay beyond a water mark this long */
+} rbpool_config_t;
+
+#define RBUF_POOL_DEFAULT_HIGH_WATER 50
+#define RBUF_POOL_DEFAULT_LOW_WATER 10
+#define RBUF_POOL_DEFAULT_SCALE_AFTER_NS 2000000L
+
+/**
+ * Worker threads that scale with the occupancy of the rings they drain.
+ * Workers run until cancelled, between two items they report the occupancy they saw and
+ * check whether they are parked. Workers 0 .. active-1 run, the others sleep.
+ * A worker is started the first time the pool grows to it and parked, not ended, when it shrinks.
+ */
+typedef struct {
+    rbpool_config_t config;
+    void *(*worker)(void *);
+    void **args;                /* worker i gets args[i] */
+    pthread_t *threads;
+    int started;
+    _Atomic int stopping;
+    _Atomic int active;
+    pthread_mutex_t mutex;      /* held to grow, shrink, start and stop */
+    _Atomic uint64_t high_since;    /* when occupancy went above high_water, 0 if it isn't */
+    _Atomic uint64_t low_since;     /* when occupancy went below low_water, 0 if it isn't */
+    _Atomic uint32_t grown;
+    _Atomic uint32_t shrunk;
+    rbsignal_t unparked;        /* parked workers sleep here */
+} rbpool_t;
+
+/**
+ * Start a pool with config->min_threads workers.
+ *
+ * @param pool pool
+ * @param config bounds and thresholds, 0 water marks and scale_after_ns select the defaults
+ * @param worker thread function
+ * @param args one argument per possible worker, config->max_threads of them
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if the first workers could not be started,
+ *         the ones that did are cancelled and joined and the pool is released
+ */
+int pool_start(rbpool_t *pool, const rbpool_config_t *config, void *(*worker)(void *), void **args);
+
+/**
+ * Called by a worker before it looks for an item: sleeps while the worker is parked.
+ *
+ * @param pool pool
+ * @param index the worker's index
+ * @param deadline absolute CLOCK_MONOTONIC time to give up at, NULL to wait forever
+ * @return SUCCESS if the worker runs, RINGBUFFER_EMPTY if it is still parked at the deadline
+ */
+int pool_park(rbpool_t *pool, int index, const struct timespec *deadline);
+
+/**
+ * Called by a worker after an item, or after finding none: adds a worker after sustained
+ * high occupancy, parks the last one after sustained low occupancy.
+ *
+ * @param pool pool
+ * @param occupancy percent of the rings in use, e.g. from ringbuffer_group_occupancy
+ */
+void pool_observe(rbpool_t *pool, unsigned int occupancy);
+
+/**
+ * Number of running workers.
+ */
+int pool_active(rbpool_t *pool);
+
+/**
+ * Stop starting workers and wake the parked ones. The caller cancels and joins
+ * the threads afterwards.
+ *
+ * @param pool pool
+ * @return the number of threads in pool->threads
+ */
+int pool_stop(rbpool_t *pool);
+
+/**
+ * Release the pool, after its threads were joined.
+ *
+ * @param pool pool
+ */
+void pool_destroy(rbpool_t *pool);
+
+#endif //POOL_H
@@ -0,0 +1,108 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+#include "ringbuf.h"
+
+/* what a reorder window does about an id that doesn't arrive */
+#define RBUF_REORDER_WAIT 0         /* wait for it, an insert beyond a full window blocks */
+#define RBUF_REORDER_SKIP_FULL 1    /* skip it when the window is full instead of blocking */
+#define RBUF_REORDER_SKIP_AFTER 2   /* skip it once records waited behind it for gap_timeout_ns */
+
+/* reorder_insert and reorder_skip: the id was skipped already, past the ringbuffer status codes */
+#define REORDER_LATE 7
+
+/* called for every record in id order, by one thread at a time */
+typedef void (*rbreorder_sink_t)(void *arg, uint64_t id, const void *data, size_t len);
+
+/* a window entry */
+typedef struct {
+    size_t len;
+    int state;              /* empty, holding a record, or an id without output */
+} rbreorder_slot_t;
+
+/**
+ * A sliding window that puts records processed in parallel back into id order.
+ * Ids start at 0 and every one of them is either inserted, skipped or lost to the gap policy.
+ * Records are copied into the window and go to the sink in runs without gaps, the thread whose
+ * insert completes a run delivers it while others keep inserting.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t advanced;    /* base moved, inserts beyond the window retry */
+    uint64_t base;              /* next id for the sink */
+    uint64_t end;               /* one past the highest id put into the window */
+    size_t pending;             /* slots in use */
+    size_t mask;                /* window size - 1 */
+    size_t max_len;
+    rbreorder_slot_t *slots;
+    uint8_t *data;              /* max_len bytes per slot */
+    int releasing;              /* a thread is delivering, the others leave the run to it */
+    int policy;
+    long gap_timeout_ns;
+    uint64_t gap_since;         /* RBUF_REORDER_SKIP_AFTER: when records started to wait behind base, 0 if none do */
+    rbreorder_sink_t sink;
+    void *sink_arg;
+    uint64_t released;          /* records given to the sink */
+    uint64_t skipped;           /* ids given up on by the gap policy or a flush */
+    uint64_t late;              /* records that came after their id was skipped, dropped */
+} rbreorder_t;
+
+/**
+ * Initialize a reorder window.
+ *
+ * @param window reorder window
+ * @param window_size ids in flight at once, rounded up to a power of two
+ * @param max_len longest record
+ * @param policy RBUF_REORDER_WAIT, RBUF_REORDER_SKIP_FULL or RBUF_REORDER_SKIP_AFTER
+ * @param gap_timeout_ns RBUF_REORDER_SKIP_AFTER: how long records wait for a missing id
+ * @param sink receives the records in order
+ * @param sink_arg first argument of the sink
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if the window could not be allocated
+ */
+int reorder_init(rbreorder_t *window, size_t window_size, size_t max_len, int policy,
+                 long gap_timeout_ns, rbreorder_sink_t sink, void *sink_arg);
+
+/**
+ * Put a record into its place. If that completes a run at the start of the window, the run
+ * goes to the sink before this returns.
+ * An id beyond the window waits for it to move, RBUF_REORDER_SKIP_FULL skips the missing ids instead.
+ *
+ * @param window reorder window
+ * @param id the record's id
+ * @param data the record
+ * @param len its length, at most max_len
+ * @return SUCCESS on success, REORDER_LATE if the id was skipped already, the record is dropped
+ */
+int reorder_insert(rbreorder_t *window, uint64_t id, const void *data, size_t len);
+
+/**
+ * Mark an id that has no record, e.g. a filtered one, so the records after it don't wait for it.
+ *
+ * @param window reorder window
+ * @param id the id
+ * @return SUCCESS on success, REORDER_LATE if the id was skipped already
+ */
+int reorder_skip(rbreorder_t *window, uint64_t id);
+
+/**
+ * RBUF_REORDER_SKIP_AFTER: deliver records whose gap timed out, for windows nobody inserts into.
+ *
+ * @param window reorder window
+ */
+void reorder_poll(rbreorder_t *window);
+
+/**
+ * Deliver everything in the window, skipping the ids that are missing. Later ids start after them.
+ *
+ * @param window reorder window
+ */
+void reorder_flush(rbreorder_t *window);
+
+/**
+ * Release the window's memory, records still in it are dropped.
+ *
+ * @param window reorder window
+ */
+void reorder_destroy(rbreorder_t *window);
+
+#endif //REORDER_H
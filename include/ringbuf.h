@@ -8,27 +8,150 @@
 #include <string.h>
 #include <time.h>
 #include <errno.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
 
 #define SUCCESS 0
 #define RINGBUFFER_FULL 1
 #define RINGBUFFER_EMPTY 2
 #define OUTPUT_BUFFER_TOO_SMALL 3
+#define RINGBUFFER_ALLOC_FAILED 4
+#define RINGBUFFER_INCOMPATIBLE 5
+#define RINGBUFFER_SYNC_FAILED 6    /* journals: done in memory, but msync or fdatasync failed */
 
 #define RBUF_TIMEOUT 1
 
+/* init flags */
+#define RBUF_LOCKED 0x0         /* default: one mutex per side */
+#define RBUF_MPMC 0x1           /* lock-free multi-producer/multi-consumer, every record carries its commit state */
+#define RBUF_SPSC 0x8           /* one producer and one consumer thread at a time, no locks and no CAS */
+#define RBUF_OVERWRITE 0x10     /* lossy: a write that doesn't fit drops the oldest records, RBUF_LOCKED or RBUF_MPMC */
+#define RBUF_FRAME_FIXED 0x0    /* default: 8 byte length header per record */
+#define RBUF_FRAME_VARINT 0x2   /* 1-3 byte varint header for messages up to 512 KB */
+#define RBUF_FRAME_ALIGNED 0x4  /* records start on cache lines, combinable with either framing */
+#define RBUF_MIRRORED 0x100     /* set by ringbuffer_create_mirrored, memory is owned by the ring */
+#define RBUF_SLOTS 0x200        /* set by ringbuffer_init_slotring, records live in fixed size slots */
+#define RBUF_SHARED 0x400       /* set by ringbuffer_shm_create/attach, the ring lives in memory shared between processes */
+#define RBUF_OWNED 0x800        /* set by ringbuffer_create, the memory is released by ringbuffer_free */
+
+/* memory options for ringbuffer_create */
+#define RBUF_HUGE_PAGES 0x1000  /* explicit huge pages (MAP_HUGETLB), falling back to transparent ones */
+#define RBUF_PREFAULT 0x2000    /* fault every page in up front instead of on first touch */
+#define RBUF_MLOCK 0x4000       /* lock the memory into RAM, implies RBUF_PREFAULT */
+#define RBUF_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+#define RBUF_CACHE_LINE 64
+
+/* readiness event fds, see ringbuffer_events_enable */
+#define RBUF_EVENT_READABLE 0
+#define RBUF_EVENT_WRITABLE 1
+
+/* a ring position padded to a full cache line, so producers and consumers don't false share */
+typedef struct {
+    _Atomic uint64_t pos;
+    char pad[RBUF_CACHE_LINE - sizeof(uint64_t)];
+} rbindex_t;
+
+/* futex word bumped on every wakeup, and the number of threads sleeping on it */
+typedef struct {
+    _Atomic uint32_t seq;
+    _Atomic uint32_t waiters;
+    uint32_t process_shared;    /* sleepers may be in other processes */
+    char pad[RBUF_CACHE_LINE - 3 * sizeof(uint32_t)];
+} rbsignal_t;
+
+/* everything producers and consumers synchronize on, it contains no pointers so it can be shared between processes.
+ * byte positions only ever grow, the ring offset is pos % size.
+ * write_head: reserved by producers, write_tail: committed and visible to consumers,
+ * read_head: claimed by consumers, read_tail: released and reusable by producers */
+typedef struct {
+    rbindex_t write_head;
+    rbindex_t write_tail;
+    rbindex_t read_head;
+    rbindex_t read_tail;
+    rbindex_t missed;           /* RBUF_OVERWRITE: records dropped since a reader last asked, see ringbuffer_missed */
+    rbsignal_t signal_read;     /* readers sleep here while the ring is empty */
+    rbsignal_t signal_write;    /* writers sleep here while their record doesn't fit */
+} rbstate_t;
+
+/* one side's statistics counters, on a cache line of their own. a side that has one thread
+ * at a time (locked or SPSC) counts its messages without atomic read-modify-writes */
+typedef struct {
+    _Atomic uint64_t messages;
+    _Atomic uint64_t bytes;         /* message bytes, headers not counted */
+    _Atomic uint64_t refused;       /* RINGBUFFER_FULL or RINGBUFFER_EMPTY returns */
+    _Atomic uint64_t wait_ns;       /* time asleep in the *_wait functions */
+    _Atomic uint64_t splits;        /* messages that wrapped around the end of the ring */
+    _Atomic uint64_t high_water;    /* write side only: most bytes in use at once */
+    _Atomic uint64_t evicted;       /* write side only: records dropped by RBUF_OVERWRITE */
+    char pad[RBUF_CACHE_LINE - 7 * sizeof(uint64_t)];
+} rbcounters_t;
+
+/* what ringbuffer_get_stats reports, counted since the ring was initialized or the last ringbuffer_reset_stats */
+typedef struct {
+    uint64_t messages_in;       /* committed messages, cancelled reservations not counted */
+    uint64_t bytes_in;          /* their message bytes, headers not counted */
+    uint64_t messages_out;      /* consumed messages */
+    uint64_t bytes_out;
+    uint64_t full;              /* writes and reservations that returned RINGBUFFER_FULL */
+    uint64_t empty;             /* reads and peeks that returned RINGBUFFER_EMPTY */
+    uint64_t write_wait_ns;     /* time writers slept on signal_write */
+    uint64_t read_wait_ns;      /* time readers slept on signal_read */
+    uint64_t write_splits;      /* messages written in two parts because they wrapped around the end */
+    uint64_t read_splits;       /* messages read in two parts */
+    uint64_t evicted;           /* RBUF_OVERWRITE: records dropped unread to make room */
+    size_t occupancy;           /* bytes in use right now, headers and reservations included */
+    size_t high_water;          /* most bytes in use at once */
+} rbstats_t;
+
+struct slotring;
+
 typedef struct {
-    uint8_t* read;
-    uint8_t* write;
     uint8_t* begin;
     uint8_t* end; //1 step AFTER the last readable address
+    size_t size;
+    int flags;
     pthread_mutex_t mutex_read;
     pthread_mutex_t mutex_write;
-    pthread_cond_t signal_read;
-    pthread_cond_t signal_write;
+    rbstate_t *state;           /* points to local_state, or into shared memory for RBUF_SHARED */
+    struct slotring *slots;     /* RBUF_SLOTS: the slot ring behind the context */
+    rbsignal_t *notify_read;    /* woken along with signal_read, e.g. by the ring's group */
+    int event_fds[2];           /* eventfds for RBUF_EVENT_READABLE/WRITABLE, -1 until enabled */
+    void *mapping;              /* RBUF_OWNED: the memory mapped by ringbuffer_create */
+    size_t mapping_len;
+    _Atomic int writer_full;    /* a writer got RINGBUFFER_FULL and waits for RBUF_EVENT_WRITABLE */
+    char pad[RBUF_CACHE_LINE];
+    rbcounters_t stats_write;   /* counted by this context's producers, see ringbuffer_get_stats */
+    rbcounters_t stats_read;    /* counted by its consumers */
+    rbstats_t stats_base;       /* the counters at the last ringbuffer_reset_stats */
+    rbstate_t local_state;
 } rbctx_t;
 
+#define RBUF_SHM_MAGIC "RBUFSHM"
+#define RBUF_SHM_VERSION 3
+
+/* start of a shared memory ring, the ring memory follows at data_offset */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;             /* synchronization mode and framing */
+    uint64_t capacity;          /* bytes of ring memory */
+    uint64_t data_offset;       /* from the start of the header */
+    char pad[RBUF_CACHE_LINE - 8 - 2 * sizeof(uint32_t) - 2 * sizeof(uint64_t)];
+    rbstate_t state;
+} rbshm_header_t;
+
+/* a record's message inside ring memory, split in two when it wraps around the end */
+typedef struct {
+    uint8_t* data[2];
+    size_t len[2];          /* len[1] is 0 unless the message wraps */
+    uint64_t position;      /* where the record starts, used by commit/consume */
+    size_t header_len;
+    size_t record_len;
+} rbspan_t;
+
 /**
- * Initialize a thread-safe lock-free ringbuffer.
+ * Initialize a thread-safe ringbuffer, RBUF_LOCKED with one mutex per side.
  * Generate ringbuffer context and memory before initialization.
  * 
  * @param context ringbuffer context.
@@ -37,8 +160,114 @@ typedef struct {
  */
 void ringbuffer_init(rbctx_t *context, void *buffer_location, size_t buffer_size);
 
+/**
+ * Initialize a ringbuffer with a synchronization mode.
+ * RBUF_LOCKED serializes writers and readers with one mutex per side,
+ * RBUF_MPMC claims records with atomic head/tail counters and never blocks: a record's commit word says
+ * whether it is committed or consumed, and the tails are moved over finished records by whichever thread
+ * finds them finished. A stalled thread holds back the visibility of the records behind its own, or the
+ * reuse of their space, but no other thread waits for it. Its records start on 8 bytes with a commit word,
+ * the ring keeps free memory zeroed,
+ * RBUF_SPSC is the locked mode without the mutexes, for one writer and one reader at a time.
+ * RBUF_OVERWRITE makes a locked or MPMC ring lossy, see ringbuffer_write.
+ * Both store the same length-prefixed records, framed as selected by
+ * RBUF_FRAME_FIXED or RBUF_FRAME_VARINT, optionally with RBUF_FRAME_ALIGNED.
+ * Aligned rings drop the bytes before the first cache line of buffer_location
+ * and the partial line at its end.
+ *
+ * @param context ringbuffer context.
+ * @param buffer_location the first byte location of the ringbuffer in memory
+ * @param buffer_size size of the ringbuffer (and memory)
+ * @param flags RBUF_LOCKED, RBUF_MPMC or RBUF_SPSC, or'ed with the framing flags
+ */
+void ringbuffer_init_flags(rbctx_t *context, void *buffer_location, size_t buffer_size, int flags);
+
+/**
+ * Initialize a ringbuffer on memory that still holds records from before, e.g. a reopened file.
+ * The records in [released, committed) are kept and read first, the rest of the memory is free.
+ *
+ * @param context ringbuffer context.
+ * @param buffer_location the first byte location of the ringbuffer in memory
+ * @param buffer_size size of the ringbuffer (and memory), as it was initialized before
+ * @param flags the flags it was initialized with before
+ * @param released position up to which records were consumed
+ * @param committed position up to which records were committed
+ */
+void ringbuffer_init_resume(rbctx_t *context, void *buffer_location, size_t buffer_size, int flags,
+                            uint64_t released, uint64_t committed);
+
+/**
+ * Initialize a ringbuffer on memory it maps and owns itself. The memory is page aligned,
+ * so RBUF_FRAME_ALIGNED keeps the whole size if it is a multiple of the cache line.
+ * RBUF_HUGE_PAGES asks for explicit huge pages and falls back to normal pages advised
+ * as transparent huge pages. RBUF_PREFAULT faults the pages in now rather than on the
+ * first write, RBUF_MLOCK also keeps them from being swapped out.
+ * Release it with ringbuffer_free.
+ *
+ * @param context ringbuffer context.
+ * @param buffer_size size of the ringbuffer
+ * @param flags RBUF_LOCKED, RBUF_MPMC or RBUF_SPSC, or'ed with the framing and memory flags
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if the memory could not be mapped or locked
+ */
+int ringbuffer_create(rbctx_t *context, size_t buffer_size, int flags);
+
+/**
+ * Destroy a ringbuffer made by ringbuffer_create and release its memory.
+ *
+ * @param context ringbuffer context
+ */
+void ringbuffer_free(rbctx_t *context);
+
+/**
+ * Initialize a ringbuffer on memory it maps itself: the same pages are mapped
+ * twice back to back, so every record is contiguous in virtual memory and is
+ * never split at the end of the ring. The size is rounded up to whole pages.
+ * The mapping is released by ringbuffer_destroy.
+ *
+ * @param context ringbuffer context.
+ * @param buffer_size minimum size of the ringbuffer
+ * @param flags RBUF_LOCKED or RBUF_MPMC
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if the memory could not be mapped
+ */
+int ringbuffer_create_mirrored(rbctx_t *context, size_t buffer_size, int flags);
+
+/**
+ * Create a ringbuffer in shared memory that other processes can attach to.
+ * The memory starts with an rbshm_header_t and has no pointers in it, every process maps it
+ * where it wants. Only the modes without mutexes, RBUF_MPMC and RBUF_SPSC, work across processes.
+ * The mapping is released by ringbuffer_destroy, the name stays until ringbuffer_shm_unlink.
+ *
+ * @param context ringbuffer context.
+ * @param name POSIX shared memory name ("/name"), or NULL for an anonymous ring that is shared with children after fork
+ * @param buffer_size size of the ringbuffer
+ * @param flags RBUF_MPMC or RBUF_SPSC, or'ed with the framing flags
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if the memory could not be created or mapped
+ */
+int ringbuffer_shm_create(rbctx_t *context, const char *name, size_t buffer_size, int flags);
+
+/**
+ * Attach to a ringbuffer made by ringbuffer_shm_create in another process.
+ * Mode and framing are taken from the header.
+ *
+ * @param context ringbuffer context.
+ * @param name the name it was created with
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if it could not be opened or mapped,
+ *         RINGBUFFER_INCOMPATIBLE if the memory isn't a ring of this version
+ */
+int ringbuffer_shm_attach(rbctx_t *context, const char *name);
+
+/**
+ * Remove the name of a shared memory ring, attached processes keep their mappings.
+ *
+ * @param name the name it was created with
+ */
+void ringbuffer_shm_unlink(const char *name);
+
 /**
  * Write to the ringbuffer.
+ * An RBUF_OVERWRITE ring makes room by dropping the oldest whole records nobody has claimed yet,
+ * it never waits for readers. Records that readers are reading right now stay, if they are
+ * in the way the write gets RINGBUFFER_FULL like on any other ring.
  * 
  * @param context ringbuffer context
  * @param message The message to be placed in the ringbuffer
@@ -57,6 +286,269 @@ int ringbuffer_write(rbctx_t *context, void *message, size_t message_len);
  */
 int ringbuffer_read(rbctx_t *context, void *buffer, size_t *buffer_len_ptr);
 
+/**
+ * Records an RBUF_OVERWRITE ring dropped unread since the last call, readers calling it after
+ * every read see how many they missed. Several readers share the count.
+ *
+ * @param context ringbuffer context
+ * @return number of records dropped
+ */
+uint64_t ringbuffer_missed(rbctx_t *context);
+
+/**
+ * Free bytes in the ringbuffer, a snapshot that other threads may change right away.
+ *
+ * @param context ringbuffer context
+ * @return bytes that are neither reserved nor waiting to be read, record headers take some of them
+ */
+size_t ringbuffer_available(rbctx_t *context);
+
+/**
+ * How full the ringbuffer is, a snapshot like ringbuffer_available.
+ *
+ * @param context ringbuffer context
+ * @return percent of the ring in use, 0 to 100
+ */
+unsigned int ringbuffer_occupancy(rbctx_t *context);
+
+/**
+ * Runtime statistics of a ringbuffer, to tell whether it is sized right.
+ * The counters are kept per context, the contexts of a shared ring count their own process.
+ * They are read without stopping producers and consumers, so they may be a few operations apart.
+ * RBUF_SLOTS rings count occupancy in whole slots and never split messages.
+ *
+ * @param context ringbuffer context
+ * @param stats receives the counters since initialization or the last ringbuffer_reset_stats
+ */
+void ringbuffer_get_stats(rbctx_t *context, rbstats_t *stats);
+
+/**
+ * Start a new statistics window: counters read as zero again and the high-water mark
+ * drops to the current occupancy. Meant for one monitoring thread sampling windows
+ * with ringbuffer_get_stats, producers and consumers keep running meanwhile.
+ *
+ * @param context ringbuffer context
+ */
+void ringbuffer_reset_stats(rbctx_t *context);
+
+/**
+ * Reserve room for a message and hand out the ring memory to write it to.
+ * In RBUF_LOCKED mode the write side stays locked until the reservation is
+ * committed or cancelled, so the same thread has to call one of them next.
+ *
+ * @param context ringbuffer context
+ * @param message_len number of bytes to reserve
+ * @param span receives the one or two memory regions of the reservation
+ * @return SUCCESS on success, RINGBUFFER_FULL when message doesn't fit
+ */
+int ringbuffer_reserve(rbctx_t *context, size_t message_len, rbspan_t *span);
+
+/**
+ * Make a reserved message visible to readers.
+ *
+ * @param context ringbuffer context
+ * @param span the reservation
+ * @param message_len bytes actually written, at most the reserved length
+ */
+void ringbuffer_commit(rbctx_t *context, rbspan_t *span, size_t message_len);
+
+/**
+ * Give a reservation back without producing a message, readers skip it.
+ *
+ * @param context ringbuffer context
+ * @param span the reservation
+ */
+void ringbuffer_cancel(rbctx_t *context, rbspan_t *span);
+
+/**
+ * Claim the oldest message and hand out the ring memory holding it.
+ * The memory stays valid until ringbuffer_consume. In RBUF_LOCKED mode the
+ * read side stays locked until then, so the same thread has to consume it.
+ *
+ * @param context ringbuffer context
+ * @param span receives the one or two memory regions of the message
+ * @return SUCCESS on success, RINGBUFFER_EMPTY if no data to read
+ */
+int ringbuffer_peek(rbctx_t *context, rbspan_t *span);
+
+/**
+ * Like ringbuffer_peek, but a message longer than max_len is left in the ring unclaimed.
+ *
+ * @param context ringbuffer context
+ * @param span receives the one or two memory regions of the message
+ * @param max_len longest message to claim
+ * @param message_len receives the message's length, also on OUTPUT_BUFFER_TOO_SMALL
+ * @return SUCCESS on success, RINGBUFFER_EMPTY if no data to read,
+ *         OUTPUT_BUFFER_TOO_SMALL if the oldest message is longer than max_len
+ */
+int ringbuffer_peek_max(rbctx_t *context, rbspan_t *span, size_t max_len, size_t *message_len);
+
+/**
+ * Release a peeked message, its memory can be reused by writers afterwards.
+ *
+ * @param context ringbuffer context
+ * @param span the peeked message
+ */
+void ringbuffer_consume(rbctx_t *context, rbspan_t *span);
+
+/**
+ * Describe the part of a span that starts offset bytes into it.
+ *
+ * @param span the whole span
+ * @param offset bytes to skip, at most the span's total length
+ * @param slice receives the remaining one or two memory regions
+ */
+void ringbuffer_span_slice(const rbspan_t *span, size_t offset, rbspan_t *slice);
+
+/**
+ * Copy data into a span, starting offset bytes into it.
+ *
+ * @return number of bytes copied, less than data_len if the span ends first
+ */
+size_t ringbuffer_span_copy_in(rbspan_t *span, size_t offset, const void *data, size_t data_len);
+
+/**
+ * Copy data out of a span, starting offset bytes into it.
+ *
+ * @return number of bytes copied, less than buffer_len if the span ends first
+ */
+size_t ringbuffer_span_copy_out(const rbspan_t *span, size_t offset, void *buffer, size_t buffer_len);
+
+/**
+ * Write several messages with one reservation. Either all messages are
+ * written, back to back and visible to readers at once, or none is.
+ *
+ * @param context ringbuffer context
+ * @param messages the messages to be placed in the ringbuffer
+ * @param count number of messages
+ * @return SUCCESS on success, RINGBUFFER_FULL when the messages don't fit together
+ */
+int ringbuffer_write_batch(rbctx_t *context, const struct iovec *messages, size_t count);
+
+/**
+ * Read as many whole messages as fit into buffer, at most max_messages, with one claim.
+ *
+ * @param context ringbuffer context
+ * @param buffer messages are copied to this location, back to back
+ * @param buffer_len size of buffer
+ * @param messages receives where each message starts in buffer and its length
+ * @param max_messages size of the messages array
+ * @param count number of messages read is stored here
+ * @return SUCCESS on success, RINGBUFFER_EMPTY if no data to read, OUTPUT_BUFFER_TOO_SMALL when the first message doesn't fit
+ */
+int ringbuffer_read_batch(rbctx_t *context, void *buffer, size_t buffer_len,
+                          struct iovec *messages, size_t max_messages, size_t *count);
+
+/**
+ * Compute a deadline for the *_wait functions.
+ *
+ * @param deadline receives CLOCK_MONOTONIC now + timeout_ns
+ * @param timeout_ns timeout in nanoseconds
+ */
+void ringbuffer_deadline(struct timespec *deadline, long timeout_ns);
+
+/**
+ * The CLOCK_MONOTONIC time, for timestamps and durations.
+ *
+ * @return nanoseconds
+ */
+static inline uint64_t ringbuffer_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * Like ringbuffer_write, but sleeps while the message doesn't fit.
+ *
+ * @param context ringbuffer context
+ * @param message The message to be placed in the ringbuffer
+ * @param message_len size of the message
+ * @param deadline absolute CLOCK_MONOTONIC time to give up at, NULL to wait forever
+ * @return SUCESS on succes, RINGBUFFER_FULL when the deadline passed
+ */
+int ringbuffer_write_wait(rbctx_t *context, void *message, size_t message_len, const struct timespec *deadline);
+
+/**
+ * Like ringbuffer_read, but sleeps while the ringbuffer is empty.
+ *
+ * @param context ringbuffer context
+ * @param buffer reads to this location
+ * @param buffer_len_ptr size of the message buffer. Size of message received from ringbuffer is stored here
+ * @param deadline absolute CLOCK_MONOTONIC time to give up at, NULL to wait forever
+ * @return SUCCESS on succes, RINGBUFFER_EMPTY when the deadline passed, OUTPUT_BUFFER_TOO_SMALL when read message doesn't fit
+ */
+int ringbuffer_read_wait(rbctx_t *context, void *buffer, size_t *buffer_len_ptr, const struct timespec *deadline);
+
+/**
+ * Like ringbuffer_reserve, but sleeps while the message doesn't fit.
+ *
+ * @param deadline absolute CLOCK_MONOTONIC time to give up at, NULL to wait forever
+ * @return SUCCESS on success, RINGBUFFER_FULL when the deadline passed
+ */
+int ringbuffer_reserve_wait(rbctx_t *context, size_t message_len, rbspan_t *span, const struct timespec *deadline);
+
+/**
+ * Like ringbuffer_peek, but sleeps while the ringbuffer is empty.
+ *
+ * @param deadline absolute CLOCK_MONOTONIC time to give up at, NULL to wait forever
+ * @return SUCCESS on success, RINGBUFFER_EMPTY when the deadline passed
+ */
+int ringbuffer_peek_wait(rbctx_t *context, rbspan_t *span, const struct timespec *deadline);
+
+/**
+ * Create readiness file descriptors for event loops (epoll, poll, select).
+ * RBUF_EVENT_READABLE fires when a record is committed to an empty ring,
+ * RBUF_EVENT_WRITABLE fires when space is released after a write got RINGBUFFER_FULL.
+ * Both start out matching the current state. They only report transitions: after an event,
+ * acknowledge it with ringbuffer_event_ack and then read (or write) until RINGBUFFER_EMPTY (or RINGBUFFER_FULL).
+ * The fds belong to this process, the events of a shared ring are only raised by its own producers and consumers.
+ * They are closed by ringbuffer_destroy.
+ *
+ * @param context ringbuffer context
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if the eventfds could not be created
+ */
+int ringbuffer_events_enable(rbctx_t *context);
+
+/**
+ * A readiness file descriptor, readable while its event is pending.
+ *
+ * @param context ringbuffer context
+ * @param event RBUF_EVENT_READABLE or RBUF_EVENT_WRITABLE
+ * @return the fd, -1 if events are not enabled
+ */
+int ringbuffer_event_fd(rbctx_t *context, int event);
+
+/**
+ * Clear a pending event.
+ *
+ * @param context ringbuffer context
+ * @param event RBUF_EVENT_READABLE or RBUF_EVENT_WRITABLE
+ */
+void ringbuffer_event_ack(rbctx_t *context, int event);
+
+/**
+ * Retry an operation while it returns again_status, sleeping on a signal in between.
+ * The *_wait functions are built on this, it lets structures made of several rings wait the same way.
+ *
+ * @param signal woken by whoever can make op succeed, see ringbuffer_signal_wake
+ * @param again_status the status of op that means "try again later"
+ * @param deadline absolute CLOCK_MONOTONIC time to give up at, NULL to wait forever
+ * @param op the operation
+ * @param arg passed to op
+ * @return the last status of op
+ */
+int ringbuffer_signal_wait(rbsignal_t *signal, int again_status, const struct timespec *deadline,
+                           int (*op)(void *arg), void *arg);
+
+/**
+ * Wake everybody sleeping in ringbuffer_signal_wait on a signal, cheap if nobody is.
+ *
+ * @param signal the signal
+ */
+void ringbuffer_signal_wake(rbsignal_t *signal);
+
 /**
  * Frees all memory allocated and syncronization variables created during initialization.
  * 
@@ -0,0 +1,100 @@
+#ifndef RINGGROUP_H
+#define RINGGROUP_H
+
+#include "ringbuf.h"
+
+/* one producer's ring in a group */
+typedef struct {
+    rbctx_t ring;
+    _Atomic int claimed;    /* a consumer is between peek and consume on this ring */
+    char pad[RBUF_CACHE_LINE - sizeof(int)];
+} rbshard_t;
+
+/**
+ * A group of rings, one per producer, read by any number of consumers.
+ * Producers use their shard's ring with the normal ringbuffer API and never contend with each other.
+ * A consumer claims a whole shard from peek to consume, so the records of one producer
+ * are processed one after the other in the order they were written.
+ */
+typedef struct {
+    rbshard_t *shards;
+    size_t shard_count;
+    rbindex_t cursor;           /* consumers start looking for records here, round-robin */
+    rbsignal_t signal_read;     /* consumers sleep here while every shard is empty or claimed */
+} rbgroup_t;
+
+/**
+ * Initialize a group. The rings of the shards have to be initialized before,
+ * typically with RBUF_SPSC. The shards have to outlive the group.
+ *
+ * @param group ringbuffer group
+ * @param shards shards with initialized rings
+ * @param shard_count number of shards
+ */
+void ringbuffer_group_init(rbgroup_t *group, rbshard_t *shards, size_t shard_count);
+
+/**
+ * The ring a producer writes to.
+ *
+ * @param group ringbuffer group
+ * @param index index of the producer
+ * @return ring of shard index
+ */
+rbctx_t *ringbuffer_group_shard(rbgroup_t *group, size_t index);
+
+/**
+ * Claim the oldest record of the next shard that has one, shards take turns.
+ * The shard stays claimed by the caller until ringbuffer_group_consume.
+ *
+ * @param group ringbuffer group
+ * @param span receives the message
+ * @param shard receives the index of the shard
+ * @return SUCCESS on success, RINGBUFFER_EMPTY if no unclaimed shard has a record
+ */
+int ringbuffer_group_peek(rbgroup_t *group, rbspan_t *span, size_t *shard);
+
+/**
+ * Like ringbuffer_group_peek, but sleeps while there is nothing to claim.
+ *
+ * @param deadline absolute CLOCK_MONOTONIC time to give up at, NULL to wait forever
+ * @return SUCCESS on success, RINGBUFFER_EMPTY when the deadline passed
+ */
+int ringbuffer_group_peek_wait(rbgroup_t *group, rbspan_t *span, size_t *shard, const struct timespec *deadline);
+
+/**
+ * Release a peeked record and its shard.
+ *
+ * @param group ringbuffer group
+ * @param shard index of the shard, as returned by the peek
+ * @param span the span of the peek
+ */
+void ringbuffer_group_consume(rbgroup_t *group, size_t shard, rbspan_t *span);
+
+/**
+ * Release a peeked record and claim the next one of the same shard, for consumers that
+ * take several records of a producer at once.
+ *
+ * @param group ringbuffer group
+ * @param shard index of the claimed shard
+ * @param span the span of the peek, receives the next record
+ * @return SUCCESS if the shard had another record and stays claimed,
+ *         RINGBUFFER_EMPTY if it had none and was released
+ */
+int ringbuffer_group_consume_next(rbgroup_t *group, size_t shard, rbspan_t *span);
+
+/**
+ * How full the fullest shard is, the backlog of its producer.
+ *
+ * @param group ringbuffer group
+ * @return percent, see ringbuffer_occupancy
+ */
+unsigned int ringbuffer_group_occupancy(rbgroup_t *group);
+
+/**
+ * Detach the shards from the group, their rings are destroyed by the caller.
+ *
+ * @param group ringbuffer group
+ */
+void ringbuffer_group_destroy(rbgroup_t *group);
+
+#endif //RINGGROUP_H
@@ -0,0 +1,71 @@
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include "ringbuf.h"
+
+#define RBUF_ROUTE_PORTS 65536      /* destination ports 0 to 65535 */
+
+/* packets to port go to sink, a port with several routes fans out to all of them */
+typedef struct {
+    uint16_t port;
+    uint32_t sink;
+} rbroute_t;
+
+/* a compiled routing table: the sinks of port p are sinks[first[p]] up to sinks[first[p + 1]] */
+typedef struct {
+    uint32_t first[RBUF_ROUTE_PORTS + 1];
+    uint32_t *sinks;
+} rbroute_table_t;
+
+/**
+ * Routes destination ports to sinks in constant time, however many routes there are.
+ * A lookup is one index into a dense table over all ports. Reconfiguring compiles a new table
+ * and swaps it in atomically: a lookup sees the old table or the new one, never a mix, and
+ * the old one is freed once no lookup uses it any more.
+ */
+typedef struct {
+    _Atomic(rbroute_table_t *) table;
+    _Atomic uint32_t phase;         /* which of the reader counts new lookups use */
+    _Atomic uint64_t readers[2];    /* lookups in progress per phase */
+    pthread_mutex_t writer;         /* one reconfiguration at a time */
+} rbrouter_t;
+
+/**
+ * Initialize a router without routes.
+ *
+ * @param router router
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if the table could not be allocated
+ */
+int route_init(rbrouter_t *router);
+
+/**
+ * Replace all routes. Lookups go on while the new table is compiled, and this returns
+ * once the old table is freed.
+ *
+ * @param router router
+ * @param routes the new routes, in the order a port's sinks are listed
+ * @param count number of routes
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if the new table could not be allocated,
+ *         the old routes stay then
+ */
+int route_set(rbrouter_t *router, const rbroute_t *routes, size_t count);
+
+/**
+ * The sinks of a destination port, safe to call while the routes are replaced.
+ *
+ * @param router router
+ * @param port destination port
+ * @param sinks receives up to max_sinks sinks
+ * @param max_sinks size of sinks
+ * @return the number of sinks of the port, more than max_sinks if they didn't all fit
+ */
+size_t route_lookup(rbrouter_t *router, uint16_t port, uint32_t *sinks, size_t max_sinks);
+
+/**
+ * Release the router, no lookups may run.
+ *
+ * @param router router
+ */
+void route_destroy(rbrouter_t *router);
+
+#endif //ROUTE_H
@@ -0,0 +1,127 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include "ringbuf.h"
+#include "scan.h"
+
+#define RBUF_RULES_MAX_STATES 65536     /* rule files whose content automaton needs more are rejected */
+#define RBUF_RULES_MAX_PATTERN 65535    /* longest content pattern */
+
+/* rules_compile and rules_load: malformed, unreadable or too large to compile, past the ringbuffer status codes */
+#define RULES_INVALID 8
+
+/* content automaton states every rule set has */
+#define RBUF_RULES_START 0      /* nothing of the payload seen yet */
+#define RBUF_RULES_MATCH 1      /* a content rule matched, the automaton stays here */
+
+/**
+ * Compiled packet filter rules. A rule file has one rule per line, lines starting with '#' are comments.
+ * A packet is dropped if any rule matches it:
+ *
+ *   port same              its from and to port are the same
+ *   port from N[-M]        its from port is N, or in N to M
+ *   port to N[-M]          its to port is
+ *   port either N[-M]      its from or its to port is
+ *   port sum N             its ports add up to N
+ *   substring TEXT         its payload contains TEXT
+ *   subsequence TEXT       its payload contains the characters of TEXT in order, anything in between
+ *
+ * TEXT is the rest of the line after one space, \xHH and \\ escape bytes.
+ * The port rules compile into bitmaps over the port range, one each for the from port, the to port
+ * and their sum, so a pair costs three lookups. The content rules compile into a single DFA,
+ * Aho-Corasick over the substrings in product with the progress of every subsequence, so a packet
+ * costs one lookup and one pass over its payload however many rules there are. Where only a few
+ * bytes leave a state, the scan jumps to the next of them with ringbuffer_scan_find.
+ */
+typedef struct {
+    size_t max_port;
+    int drop_same;              /* packets whose from and to port are the same are dropped */
+    uint8_t *dropped_from;      /* bit per from port, 0 to max_port */
+    uint8_t *dropped_to;        /* bit per to port */
+    uint8_t *dropped_sums;      /* bit per sum of the ports, 0 to 2 * max_port */
+    uint16_t classes[256];      /* bytes no pattern tells apart share a class */
+    size_t class_count;
+    uint32_t *next;             /* [state * class_count + class]: the state after a byte */
+    size_t state_count;
+    uint8_t *exit_count;        /* per state: how many bytes leave it, 0 if too many to jump to */
+    uint8_t (*exits)[RBUF_SCAN_MAX_FIND];   /* per state: those bytes */
+    size_t port_rules;
+    size_t content_rules;
+} rbrules_t;
+
+/**
+ * Compile rules from text.
+ *
+ * @param rules compiled rules
+ * @param text rules, in the format of a rule file
+ * @param max_port highest port, ports of port rules have to be in 0 to max_port
+ * @param error receives a message with the line number if the rules are rejected, may be NULL
+ * @param error_len size of error
+ * @return SUCCESS on success, RULES_INVALID if the rules are malformed or need too many
+ *         automaton states, RINGBUFFER_ALLOC_FAILED if memory ran out
+ */
+int rules_compile(rbrules_t *rules, const char *text, size_t max_port, char *error, size_t error_len);
+
+/**
+ * Compile a rule file.
+ *
+ * @param path the rule file
+ * @return like rules_compile, RULES_INVALID if the file can't be read
+ */
+int rules_load(rbrules_t *rules, const char *path, size_t max_port, char *error, size_t error_len);
+
+/**
+ * Whether the port rules let a packet through.
+ *
+ * @param rules compiled rules
+ * @param from from port, ports above max_port are dropped
+ * @param to to port
+ * @return 1 if no port rule matches, 0 if one does
+ */
+int rules_ports_allowed(const rbrules_t *rules, size_t from, size_t to);
+
+/**
+ * Run the content automaton over a piece of payload. A payload can be scanned in pieces,
+ * each continuing from the state the last one returned.
+ *
+ * @param rules compiled rules
+ * @param state RBUF_RULES_START for a new payload, or the state after the previous piece
+ * @param data bytes of the payload
+ * @param len number of bytes
+ * @return the state after them, RBUF_RULES_MATCH once a content rule matched
+ */
+uint32_t rules_scan(const rbrules_t *rules, uint32_t state, const unsigned char *data, size_t len);
+
+/**
+ * Check the next piece of a stream, e.g. the next packet of a connection in order: content rules
+ * match across the pieces as if the stream were one payload. After a match the stream starts over,
+ * so the pieces after the one that completed it are checked on their own again.
+ *
+ * @param rules compiled rules
+ * @param state the stream's state, RBUF_RULES_START before its first piece
+ * @param data the piece
+ * @param len its length
+ * @return 1 if the piece passes, 0 if a content rule matched in it
+ */
+int rules_stream(const rbrules_t *rules, uint32_t *state, const unsigned char *data, size_t len);
+
+/**
+ * Whether a packet passes every rule.
+ *
+ * @param rules compiled rules
+ * @param from from port
+ * @param to to port
+ * @param payload the whole payload
+ * @param len its length
+ * @return 1 if it passes, 0 if a rule drops it
+ */
+int rules_allowed(const rbrules_t *rules, size_t from, size_t to, const unsigned char *payload, size_t len);
+
+/**
+ * Release compiled rules.
+ *
+ * @param rules compiled rules
+ */
+void rules_destroy(rbrules_t *rules);
+
+#endif //RULES_H
@@ -0,0 +1,73 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+/* implementations of the subsequence scan */
+#define RBUF_SCAN_SCALAR 0
+#define RBUF_SCAN_SSE2 1    /* 16 bytes at a time, x86_64 */
+#define RBUF_SCAN_AVX2 2    /* 32 bytes at a time, x86_64 cpus that have it */
+
+#define RBUF_SCAN_MAX_FIND 4    /* bytes ringbuffer_scan_find looks for at once */
+
+/**
+ * Look for pattern as a subsequence of data: its characters in order, anything in between.
+ * The scan continues a match from an earlier part of the same message, so a message can be
+ * scanned in pieces. It jumps from one wanted character to the next with the fastest
+ * implementation the cpu supports.
+ *
+ * @param data bytes to scan
+ * @param len number of bytes
+ * @param pattern characters to find in order
+ * @param pattern_len number of characters
+ * @param matched characters of pattern found in earlier parts, 0 for a new message
+ * @return characters of pattern found so far, pattern_len once it was found
+ */
+size_t ringbuffer_scan_subsequence(const unsigned char *data, size_t len, const char *pattern,
+                                   size_t pattern_len, size_t matched);
+
+/**
+ * Find the first byte that is one of a few given ones, the way the subsequence scan jumps.
+ *
+ * @param data bytes to scan
+ * @param len number of bytes
+ * @param bytes the bytes to look for
+ * @param byte_count how many, 1 to RBUF_SCAN_MAX_FIND
+ * @return index of the first of them in data, len if there is none
+ */
+size_t ringbuffer_scan_find(const unsigned char *data, size_t len, const unsigned char *bytes, size_t byte_count);
+
+/**
+ * ringbuffer_scan_subsequence with a given implementation, e.g. to compare them.
+ *
+ * @param impl RBUF_SCAN_SCALAR, RBUF_SCAN_SSE2 or RBUF_SCAN_AVX2, supported by the cpu
+ * @return like ringbuffer_scan_subsequence
+ */
+size_t ringbuffer_scan_subsequence_with(int impl, const unsigned char *data, size_t len, const char *pattern,
+                                        size_t pattern_len, size_t matched);
+
+/**
+ * ringbuffer_scan_find with a given implementation.
+ *
+ * @param impl RBUF_SCAN_SCALAR, RBUF_SCAN_SSE2 or RBUF_SCAN_AVX2, supported by the cpu
+ * @return like ringbuffer_scan_find
+ */
+size_t ringbuffer_scan_find_with(int impl, const unsigned char *data, size_t len, const unsigned char *bytes,
+                                 size_t byte_count);
+
+/**
+ * Whether the cpu supports an implementation.
+ *
+ * @param impl RBUF_SCAN_SCALAR, RBUF_SCAN_SSE2 or RBUF_SCAN_AVX2
+ * @return 1 if it does, 0 if not
+ */
+int ringbuffer_scan_supported(int impl);
+
+/**
+ * The implementation ringbuffer_scan_subsequence uses.
+ *
+ * @return RBUF_SCAN_SCALAR, RBUF_SCAN_SSE2 or RBUF_SCAN_AVX2
+ */
+int ringbuffer_scan_impl(void);
+
+#endif //SCAN_H
@@ -0,0 +1,148 @@
+#ifndef SLOTRING_H
+#define SLOTRING_H
+
+#include "ringbuf.h"
+#include <stddef.h>
+
+/* define SLOTRING_SLOT_SIZE at compile time to make the slot size a constant,
+ * slotring_init then only accepts that size */
+
+/* the slot length is a byte when the compile time slot size leaves room for the cancel marker in one.
+ * without SLOTRING_SLOT_SIZE the size is only known at init and can be anything up to 0xfffe,
+ * so it takes two bytes */
+#if defined(SLOTRING_SLOT_SIZE) && SLOTRING_SLOT_SIZE <= 0xfe
+typedef uint8_t slotring_len_t;
+#define SLOTRING_MAX_SLOT_SIZE 0xfe
+#define SLOTRING_CANCELLED 0xff     /* length of a slot given back by slotring_cancel */
+#else
+typedef uint16_t slotring_len_t;
+#define SLOTRING_MAX_SLOT_SIZE 0xfffe
+#define SLOTRING_CANCELLED 0xffff   /* length of a slot given back by slotring_cancel */
+#endif
+
+/* every slot: its sequence number, the message length and the message right after it */
+typedef struct {
+    _Atomic uint64_t seq;
+    slotring_len_t len;
+    uint8_t data[];
+} slot_t;
+
+#ifdef SLOTRING_SLOT_SIZE
+/* bytes between two slots, the same as slotring_memory_size(1, SLOTRING_SLOT_SIZE) */
+#define SLOTRING_STRIDE ((offsetof(slot_t, data) + SLOTRING_SLOT_SIZE + 7) & ~(size_t) 7)
+#endif
+
+/**
+ * A multi-producer/multi-consumer ring of fixed size slots.
+ * A slot is free for the producer at position pos when its sequence number is pos,
+ * and holds a message for the consumer at pos when it is pos + 1.
+ * Enqueue and dequeue are not branch-free: they claim their position with a CAS and loop
+ * when another producer or consumer got it first, and check the slot's sequence number.
+ */
+typedef struct slotring {
+    uint8_t* slots;
+    size_t slot_size;       /* bytes of message per slot */
+    size_t stride;          /* bytes between two slots */
+    uint64_t mask;          /* number of slots - 1 */
+    char pad[RBUF_CACHE_LINE];
+    rbindex_t enqueue_pos;
+    rbindex_t dequeue_pos;
+} slotring_t;
+
+/**
+ * Memory needed for a slot ring.
+ *
+ * @param slot_count number of slots, a power of two
+ * @param slot_size maximum message size
+ * @return bytes to pass to slotring_init
+ */
+size_t slotring_memory_size(size_t slot_count, size_t slot_size);
+
+/**
+ * Initialize a slot ring with as many slots as fit into the memory, rounded down to a power of two.
+ *
+ * @param ring slot ring
+ * @param buffer_location the memory for the slots, 8 byte aligned
+ * @param buffer_size size of the memory
+ * @param slot_size maximum message size, at most SLOTRING_MAX_SLOT_SIZE
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if not even one slot fits
+ */
+int slotring_init(slotring_t *ring, void *buffer_location, size_t buffer_size, size_t slot_size);
+
+/**
+ * Claim free slots for consecutive messages.
+ *
+ * @param ring slot ring
+ * @param count number of slots
+ * @param ticket receives the position of the first slot
+ * @return SUCCESS on success, RINGBUFFER_FULL when fewer than count slots are free
+ */
+int slotring_reserve(slotring_t *ring, size_t count, uint64_t *ticket);
+
+/**
+ * Hand a reserved slot to consumers.
+ *
+ * @param ring slot ring
+ * @param ticket position of the slot
+ * @param message_len bytes written to the slot, SLOTRING_CANCELLED to give it back
+ */
+void slotring_commit(slotring_t *ring, uint64_t ticket, size_t message_len);
+
+/**
+ * Claim the oldest filled slot, skipping cancelled ones.
+ * A message longer than max_len stays in the ring.
+ *
+ * @param ring slot ring
+ * @param max_len longest message the caller can take
+ * @param ticket receives the position of the slot
+ * @param message_len receives the length of the message
+ * @return SUCCESS on success, RINGBUFFER_EMPTY if no slot is filled,
+ *         OUTPUT_BUFFER_TOO_SMALL when the message is longer than max_len
+ */
+int slotring_peek(slotring_t *ring, size_t max_len, uint64_t *ticket, size_t *message_len);
+
+/**
+ * Hand a peeked slot back to producers.
+ *
+ * @param ring slot ring
+ * @param ticket position of the slot
+ */
+void slotring_consume(slotring_t *ring, uint64_t ticket);
+
+/**
+ * The slot at a position.
+ */
+static inline slot_t *slotring_slot(slotring_t *ring, uint64_t ticket)
+{
+#ifdef SLOTRING_SLOT_SIZE
+    return (slot_t *) (ring->slots + (ticket & ring->mask) * SLOTRING_STRIDE);
+#else
+    return (slot_t *) (ring->slots + (ticket & ring->mask) * ring->stride);
+#endif
+}
+
+/**
+ * Write a message into the next free slot.
+ *
+ * @return SUCCESS on success, RINGBUFFER_FULL if no slot is free
+ */
+int slotring_write(slotring_t *ring, const void *message, size_t message_len);
+
+/**
+ * Read the message of the oldest filled slot.
+ *
+ * @return SUCCESS on success, RINGBUFFER_EMPTY if no slot is filled,
+ *         OUTPUT_BUFFER_TOO_SMALL when the message doesn't fit, its length is stored in buffer_len
+ */
+int slotring_read(slotring_t *ring, void *buffer, size_t *buffer_len);
+
+/**
+ * Run the ringbuffer API on top of a slot ring, messages are limited to its slot size.
+ * The slot ring has to outlive the context.
+ *
+ * @param context ringbuffer context
+ * @param slots an initialized slot ring
+ */
+void ringbuffer_init_slotring(rbctx_t *context, slotring_t *slots);
+
+#endif //SLOTRING_H
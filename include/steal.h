@@ -0,0 +1,88 @@
+#ifndef STEAL_H
+#define STEAL_H
+
+#include "ringbuf.h"
+
+/**
+ * A worker's task deque (Chase-Lev, fixed size). The owner pushes and pops at the bottom without
+ * contention, other workers steal from the top.
+ */
+typedef struct {
+    _Atomic int64_t top;        /* thieves take the oldest task here */
+    char pad_top[RBUF_CACHE_LINE - sizeof(int64_t)];
+    _Atomic int64_t bottom;     /* one past the newest task */
+    char pad_bottom[RBUF_CACHE_LINE - sizeof(int64_t)];
+    _Atomic(void *) *tasks;
+    int64_t mask;               /* deque size - 1 */
+    _Atomic uint64_t stolen;    /* tasks other workers took from this deque */
+} rbdeque_t;
+
+/**
+ * A work-stealing executor: one deque per worker. A worker runs its own tasks newest first and,
+ * once it has none, steals the oldest task of another worker, so a worker stuck on a slow task
+ * doesn't hold up the tasks queued behind it.
+ * Tasks are opaque pointers, the workers and how they sleep belong to the caller.
+ */
+typedef struct {
+    rbdeque_t *deques;
+    int workers;
+    _Atomic uint32_t victim;    /* thieves start at a different deque each time */
+    rbsignal_t *notify;         /* woken by every push, e.g. the signal idle workers sleep on */
+} rbsteal_t;
+
+/**
+ * Initialize an executor.
+ *
+ * @param exec executor
+ * @param workers number of workers
+ * @param deque_size tasks a worker can have queued, rounded up to a power of two
+ * @param notify woken when a task is pushed, NULL for none
+ * @return SUCCESS on success, RINGBUFFER_ALLOC_FAILED if the deques could not be allocated
+ */
+int steal_init(rbsteal_t *exec, int workers, size_t deque_size, rbsignal_t *notify);
+
+/**
+ * Queue a task on a worker's own deque, only that worker may call this.
+ *
+ * @param exec executor
+ * @param worker the calling worker
+ * @param task task, not NULL
+ * @return SUCCESS on success, RINGBUFFER_FULL if the deque is full
+ */
+int steal_push(rbsteal_t *exec, int worker, void *task);
+
+/**
+ * Take the newest task of a worker's own deque, only that worker may call this.
+ *
+ * @param exec executor
+ * @param worker the calling worker
+ * @return the task, NULL if the deque is empty
+ */
+void *steal_pop(rbsteal_t *exec, int worker);
+
+/**
+ * Take the oldest task of another worker's deque, any thread may call this.
+ *
+ * @param exec executor
+ * @param thief the calling worker, its own deque is left out, -1 for none
+ * @return the task, NULL if every other deque is empty
+ */
+void *steal_oldest(rbsteal_t *exec, int thief);
+
+/**
+ * A worker's next task: its own newest, or else another worker's oldest.
+ *
+ * @param exec executor
+ * @param worker the calling worker
+ * @return the task, NULL if there is none
+ */
+void *steal_take(rbsteal_t *exec, int worker);
+
+/**
+ * Release the deques, tasks still in them are dropped.
+ *
+ * @param exec executor
+ */
+void steal_destroy(rbsteal_t *exec);
+
+#endif //STEAL_H
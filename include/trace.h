@@ -0,0 +1,111 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/* trace levels, an event is recorded if its level is at most the runtime level */
+#define TRACE_OFF 0
+#define TRACE_INFO 1            /* unusual outcomes: full, too small, sleeping, evicted */
+#define TRACE_DEBUG 2           /* every reserve, commit, claim and release */
+
+/* events above this level are compiled out, build with -DTRACE_COMPILE_LEVEL=0 to drop all */
+#ifndef TRACE_COMPILE_LEVEL
+#define TRACE_COMPILE_LEVEL TRACE_DEBUG
+#endif
+
+#define TRACE_RING_EVENTS 4096  /* per thread, the oldest events are overwritten */
+#define TRACE_FILE_MAGIC "RBTRACE"
+#define TRACE_FILE_VERSION 1
+
+/* X(id, name, name of arg0, name of arg1) */
+#define TRACE_EVENTS(X) \
+    X(TRACE_WRITE_RESERVE, "write_reserve", "available", "record_len") \
+    X(TRACE_WRITE_FULL, "write_full", "available", "record_len") \
+    X(TRACE_WRITE_COMMIT, "write_commit", "position", "record_len") \
+    X(TRACE_READ_CLAIM, "read_claim", "position", "message_len") \
+    X(TRACE_READ_EMPTY, "read_empty", "position", "-") \
+    X(TRACE_READ_TOO_SMALL, "read_too_small", "buffer_len", "message_len") \
+    X(TRACE_READ_RELEASE, "read_release", "position", "record_len") \
+    X(TRACE_WAIT_SLEEP, "wait_sleep", "status", "seq") \
+    X(TRACE_WAIT_WAKE, "wait_wake", "status", "seq") \
+    X(TRACE_WRITE_EVICT, "write_evict", "position", "record_len")
+
+#define TRACE_ENUM(id, name, arg0, arg1) id,
+enum { TRACE_EVENTS(TRACE_ENUM) TRACE_NUMBER_OF_EVENTS };
+#undef TRACE_ENUM
+
+/* one binary record, also the on-disk format */
+typedef struct {
+    uint64_t timestamp_ns;      /* CLOCK_MONOTONIC */
+    uint32_t event;
+    uint32_t thread;
+    uint64_t arg0;
+    uint64_t arg1;
+} trace_event_t;
+
+/* file layout: trace_file_header_t, then per thread a trace_file_thread_t followed by its events */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t event_size;
+} trace_file_header_t;
+
+typedef struct {
+    uint32_t thread;
+    uint32_t reserved;
+    uint64_t number_of_events;
+} trace_file_thread_t;
+
+extern _Atomic int trace_level;
+
+#define TRACE(level, event, arg0, arg1) do { \
+    if ((level) <= TRACE_COMPILE_LEVEL && \
+        (level) <= atomic_load_explicit(&trace_level, memory_order_relaxed)) { \
+        trace_record((event), (uint64_t) (arg0), (uint64_t) (arg1)); \
+    } \
+} while (0)
+
+/**
+ * Set the runtime trace level.
+ *
+ * @param level TRACE_OFF, TRACE_INFO or TRACE_DEBUG
+ */
+void trace_set_level(int level);
+
+/**
+ * Set the runtime trace level from the RBUF_TRACE_LEVEL environment variable.
+ *
+ * @return the dump file named by RBUF_TRACE_FILE, NULL if unset
+ */
+const char *trace_configure_from_env(void);
+
+/**
+ * Append an event to the calling thread's trace ring, use the TRACE macro instead.
+ *
+ * @param event event id
+ * @param arg0 first event argument
+ * @param arg1 second event argument
+ */
+void trace_record(uint32_t event, uint64_t arg0, uint64_t arg1);
+
+/**
+ * Write the trace rings of all threads to a binary file, to be read by tools/trace_decode.
+ * Threads still tracing meanwhile may leave torn events in the dump.
+ *
+ * @param path file to write
+ * @return 0 on success, -1 if the file could not be written
+ */
+int trace_dump(const char *path);
+
+/**
+ * Name of an event, or NULL for an unknown id.
+ */
+const char *trace_event_name(uint32_t event);
+
+/**
+ * Name of an event's argument (0 or 1).
+ */
+const char *trace_event_arg_name(uint32_t event, int arg);
+
+#endif //TRACE_H
@@ -5,9 +5,19 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <errno.h>
 
 #include "../include/daemon.h"
 #include "../include/ringbuf.h"
+#include "../include/slotring.h"
+#include "../include/ringgroup.h"
+#include "../include/trace.h"
+#include "../include/latency.h"
+#include "../include/reorder.h"
+#include "../include/pool.h"
+#include "../include/steal.h"
+#include "../include/rules.h"
+#include "../include/route.h"
 
 /* IN THE FOLLOWING IS THE CODE PROVIDED FOR YOU
  * changing the code will result in points deduction */
@@ -32,6 +42,18 @@ typedef struct {
     connection_t* connection;
 } w_thread_args_t;
 
+/* fill a reserved span with file data, starting offset bytes into it */
+static size_t fread_span(rbspan_t *span, size_t offset, FILE *fp) {
+    rbspan_t payload;
+    ringbuffer_span_slice(span, offset, &payload);
+
+    size_t read = fread(payload.data[0], 1, payload.len[0], fp);
+    if (read == payload.len[0] && payload.len[1] > 0) {
+        read += fread(payload.data[1], 1, payload.len[1], fp);
+    }
+    return read;
+}
+
 void* write_packets(void* arg) {
     /* extract arguments */
     rbctx_t* ctx = ((w_thread_args_t*) arg)->ctx;
@@ -46,20 +68,30 @@ void* write_packets(void* arg) {
         exit(1);
     }
 
-    /* read file in chunks and write to ringbuffer with random delay */
-    unsigned char buf[MESSAGE_SIZE];
+    /* with latency recording on, every packet carries the time it arrived after its ids.
+     * the packet grows by it, so the file is cut into the same chunks either way */
+    int latency_on = atomic_load_explicit(&latency_enabled, memory_order_relaxed);
+    size_t stamp_len = latency_on ? sizeof(uint64_t) : 0;
+    size_t header_len = 3 * sizeof(size_t) + stamp_len;
+
+    /* read file in chunks straight into the ringbuffer with random delay */
     size_t packet_id = 0;
     size_t read = 1;
     while (read > 0) {
-        size_t msg_size = MESSAGE_SIZE - 3 * sizeof(size_t);
-        read = fread(buf + 3 * sizeof(size_t), 1, msg_size, fp);
+        rbspan_t span;
+        uint64_t ingested = latency_on ? ringbuffer_now_ns() : 0;
+        ringbuffer_reserve_wait(ctx, MESSAGE_SIZE + stamp_len, &span, NULL); // sleeps until a reader makes room
+        read = fread_span(&span, header_len, fp);
         if (read > 0) {
-            memcpy(buf, &from, sizeof(size_t));
-            memcpy(buf + sizeof(size_t), &to, sizeof(size_t));
-            memcpy(buf + 2 * sizeof(size_t), &packet_id, sizeof(size_t));
-            while(ringbuffer_write(ctx, buf, read + 3 * sizeof(size_t)) != SUCCESS){
-                usleep(((rand() % 50) + 25)); // sleep for a random time between 25 and 75 us
+            ringbuffer_span_copy_in(&span, 0, &from, sizeof(size_t));
+            ringbuffer_span_copy_in(&span, sizeof(size_t), &to, sizeof(size_t));
+            ringbuffer_span_copy_in(&span, 2 * sizeof(size_t), &packet_id, sizeof(size_t));
+            if (latency_on) {
+                ringbuffer_span_copy_in(&span, 3 * sizeof(size_t), &ingested, sizeof(ingested));
             }
+            ringbuffer_commit(ctx, &span, read + header_len);
+        } else {
+            ringbuffer_cancel(ctx, &span);
         }
         packet_id++;
         usleep(((rand() % (100 -1)) + 1)); // sleep for a random time between 1 and 100 us
@@ -79,72 +111,301 @@ void* write_packets(void* arg) {
 // 2. filtering functionality
 // 3. (thread-safe) write to file functionality
 
+#define READ_WAIT_NS 100000000L  // 0.1 second
+#define REORDER_WINDOW 64        // packets of one connection in flight at once
+#define STEAL_BATCH 8            // packets per task of the work-stealing executor
+#define STEAL_BATCHES 4          // batches a worker fills at once, from one connection
+
+/* packet ids never go missing here, every packet is written or filtered */
+#ifndef DAEMON_REORDER_POLICY
+#define DAEMON_REORDER_POLICY RBUF_REORDER_WAIT
+#endif
+
 // Reader thread arguments struct
 typedef struct {
-    rbctx_t* ctx;
-    connection_t* connections;
-    FILE** file_handlers;
+    rbgroup_t* group;
+    rbreorder_t* windows;       // one per connection, puts its packets back in packet_id order
+    rbpool_t* pool;
+    int index;                  // in the pool and the executor, threads past the pool's active count park
+    rbsteal_t* exec;
+    const rbrules_t* rules;
+    rbrouter_t* router;         // destination port -> the connections whose file gets the packet
+    int match_stream;           // the reorder sink checks the content, we only the ports
+    struct packet_batch* batches;   // STEAL_BATCHES of this thread's own
     int nr_of_connections;
-    pthread_mutex_t* file_mutexes;
     volatile bool* running;
 } r_thread_args_t;
 
-// Mesaj filtreleme fonksiyonu
-bool validate(size_t from, size_t to, unsigned char* msg, size_t msg_len) {
-    if (from == to || from == 42 || to == 42 || (from + to) == 42) {
-        return false;
+// a packet copied out of its shard
+typedef struct {
+    size_t from;
+    size_t to;
+    size_t packet_id;
+    size_t payload_len;
+    uint64_t ingested;
+    unsigned char payload[MESSAGE_SIZE];
+} packet_in_t;
+
+// an executor task: packets of one connection in packet_id order. it belongs to the thread
+// that filled it, whoever runs it hands it back by clearing busy
+typedef struct packet_batch {
+    int owner;
+    _Atomic int busy;
+    size_t shard;
+    size_t count;
+    packet_in_t packets[STEAL_BATCH];
+} packet_batch_t;
+
+// a processed packet waiting in its connection's reorder window: this, the targets, then the payload
+typedef struct {
+    uint64_t ingested;
+    uint64_t routed;
+    size_t target_count;
+    size_t payload_offset;
+} packet_out_t;
+
+/* the rules validate() applied before they came from a rule file */
+static const char default_rules[] =
+    "port same\n"
+    "port either 42\n"
+    "port sum 42\n"
+    "subsequence malicious\n";
+
+// Mesaj filtreleme fonksiyonu: the port pair is one table lookup, the payload one pass of the rules' automaton
+bool validate(const rbrules_t* rules, size_t from, size_t to, unsigned char* msg, size_t msg_len) {
+    return rules_allowed(rules, from, to, msg, msg_len);
+}
+
+// what a connection's reorder window hands its packets to
+typedef struct {
+    FILE** file_handlers;
+    const rbrules_t* rules;
+    int match_stream;           // DAEMON_MATCH_STREAM: the content rules are checked here, across packets
+    uint32_t match_state;       // where the connection's stream left the rules' automaton
+    unsigned int seed;          // rand_r state for the simulated output work, the sink runs one thread at a time
+} flow_t;
+
+// reorder sink: gets a connection's packets one at a time in packet_id order
+static void write_packet(void* arg, uint64_t packet_id, const void* data, size_t len) {
+    flow_t* flow = arg;
+    FILE** file_handlers = flow->file_handlers;
+    const uint8_t* packet = data;
+    packet_out_t out;
+    memcpy(&out, packet, sizeof(out));
+    (void) packet_id;
+
+    uint64_t released = out.ingested != 0 ? ringbuffer_now_ns() : 0;
+    // a pattern split over packets completes in the later one, which is dropped. the earlier ones are out already
+    if (flow->match_stream &&
+        !rules_stream(flow->rules, &flow->match_state, packet + out.payload_offset, len - out.payload_offset)) {
+        out.target_count = 0;
+    }
+    for (size_t i = 0; i < out.target_count; i++) {
+        uint32_t target;
+        memcpy(&target, packet + sizeof(out) + i * sizeof(uint32_t), sizeof(uint32_t));
+        fwrite(packet + out.payload_offset, 1, len - out.payload_offset, file_handlers[target]);
+        // stands in for the work of delivering to one target, routing itself doesn't depend on their number
+        usleep((rand_r(&flow->seed) % 50) + 25); // sleep for a random time between 25 and 75 us
+    }
+    if (out.ingested != 0) {
+        uint64_t done = ringbuffer_now_ns();
+        latency_record(LATENCY_REORDER, released - out.routed);
+        latency_record(LATENCY_WRITE, done - released);
+        latency_record(LATENCY_TOTAL, done - out.ingested);
+    }
+}
+
+// copies a claimed packet out of its shard
+static void copy_packet(rbspan_t* span, packet_in_t* packet, int latency_on) {
+    rbspan_t payload;
+    size_t header_len = 3 * sizeof(size_t);
+    ringbuffer_span_copy_out(span, 0, &packet->from, sizeof(size_t));
+    ringbuffer_span_copy_out(span, sizeof(size_t), &packet->to, sizeof(size_t));
+    ringbuffer_span_copy_out(span, 2 * sizeof(size_t), &packet->packet_id, sizeof(size_t));
+    packet->ingested = 0;
+    if (latency_on) {
+        ringbuffer_span_copy_out(span, header_len, &packet->ingested, sizeof(packet->ingested));
+        header_len += sizeof(packet->ingested);
+    }
+    ringbuffer_span_slice(span, header_len, &payload);
+    packet->payload_len = ringbuffer_span_copy_out(&payload, 0, packet->payload, MESSAGE_SIZE);
+}
+
+// the first of this thread's batches that nobody runs, starting at index
+static packet_batch_t* free_batch(r_thread_args_t* args, int* index) {
+    for (; *index < STEAL_BATCHES; (*index)++) {
+        packet_batch_t* batch = &args->batches[*index];
+        if (!atomic_load_explicit(&batch->busy, memory_order_acquire)) {
+            return batch;
+        }
+    }
+    return NULL;
+}
+
+// copies packets of the claimed shard into this thread's free batches until they are full or the
+// shard is empty, then releases the shard. returns the number of batches, oldest packets first
+static size_t fill_batches(r_thread_args_t* args, rbspan_t* span, size_t shard, packet_batch_t** filled,
+                           int latency_on) {
+    size_t filled_count = 0;
+    int next = 0;
+    packet_batch_t* batch = NULL;
+
+    for (;;) {
+        if (batch == NULL || batch->count == STEAL_BATCH) {
+            // the caller only claims a shard when there is a free batch
+            batch = free_batch(args, &next);
+            next++;
+            batch->shard = shard;
+            batch->count = 0;
+            atomic_store_explicit(&batch->busy, 1, memory_order_relaxed);
+            filled[filled_count++] = batch;
+        }
+        copy_packet(span, &batch->packets[batch->count++], latency_on);
+
+        int room = next;
+        if (batch->count == STEAL_BATCH && free_batch(args, &room) == NULL) {
+            ringbuffer_group_consume(args->group, shard, span);
+            break;
+        }
+        if (ringbuffer_group_consume_next(args->group, shard, span) != SUCCESS) {
+            break;
+        }
     }
+    return filled_count;
+}
+
+// validates, routes and writes a batch. cancellation stays off throughout, packets of the batch that
+// were never put into the reorder window would keep the threads waiting on it from being joined
+static void run_batch(r_thread_args_t* args, packet_batch_t* batch, int latency_on) {
+    int nr_of_connections = args->nr_of_connections;
+    rbreorder_t* window = &args->windows[batch->shard];
+
+    // room for every connection as a target, the payload after them
+    size_t payload_offset = sizeof(packet_out_t) + nr_of_connections * sizeof(uint32_t);
+    uint8_t packet[payload_offset + MESSAGE_SIZE];
+    packet_out_t out;
+
+    for (size_t p = 0; p < batch->count; p++) {
+        packet_in_t* in = &batch->packets[p];
+        uint64_t claimed = 0, validated = 0;
+        if (latency_on) {
+            claimed = ringbuffer_now_ns();
+        }
+        out.ingested = in->ingested;
 
-    const char* malicious = "malicious";
-    size_t malicious_len = strlen(malicious);
-    size_t msg_index = 0, mal_index = 0;
+        bool valid = args->match_stream ? rules_ports_allowed(args->rules, in->from, in->to) :
+                     validate(args->rules, in->from, in->to, in->payload, in->payload_len);
+        if (latency_on) {
+            validated = ringbuffer_now_ns();
+        }
+        out.target_count = 0;
+        if (valid) {
+            // the rules only let ports up to MAXIMUM_PORT through
+            uint32_t targets[nr_of_connections];
+            out.target_count = route_lookup(args->router, (uint16_t) in->to, targets, nr_of_connections);
+            if (out.target_count > (size_t) nr_of_connections) {
+                out.target_count = nr_of_connections;
+            }
+            memcpy(packet + sizeof(out), targets, out.target_count * sizeof(uint32_t));
+            out.routed = latency_on ? ringbuffer_now_ns() : 0;
+            out.payload_offset = payload_offset;
+            memcpy(packet, &out, sizeof(out));
+            memcpy(packet + payload_offset, in->payload, in->payload_len);
+            // blocks while the window is full, the thread with its oldest packet never waits here
+            reorder_insert(window, in->packet_id, packet, payload_offset + in->payload_len);
+        } else {
+            reorder_skip(window, in->packet_id);
+        }
 
-    while (msg_index < msg_len && mal_index < malicious_len) {
-        if (msg[msg_index] == malicious[mal_index]) {
-            mal_index++;
-            if (mal_index == malicious_len) {
-                return false;
+        if (latency_on) {
+            // ring: from arrival until a thread processes it, waiting for room and in a batch included
+            latency_record(LATENCY_RING, claimed - out.ingested);
+            latency_record(LATENCY_VALIDATE, validated - claimed);
+            if (valid) {
+                latency_record(LATENCY_ROUTE, out.routed - validated);
             }
         }
-        msg_index++;
     }
 
-    return true;
+    int owner = batch->owner;
+    atomic_store_explicit(&batch->busy, 0, memory_order_release);
+    if (owner != args->index) {
+        // the owner may be waiting for a free batch to read into
+        ringbuffer_signal_wake(&args->group->signal_read);
+    }
+}
+
+typedef struct {
+    r_thread_args_t* args;
+    packet_batch_t* stolen;
+    rbspan_t* span;
+    size_t* shard;
+} work_args_t;
+
+// another thread's batch, or else a packet to read into a batch of our own
+static int try_work(void* arg) {
+    work_args_t* work = arg;
+    r_thread_args_t* args = work->args;
+    int index = 0;
+
+    work->stolen = steal_oldest(args->exec, args->index);
+    if (work->stolen != NULL) {
+        return SUCCESS;
+    }
+    if (free_batch(args, &index) == NULL) {
+        return RINGBUFFER_EMPTY;
+    }
+    return ringbuffer_group_peek(args->group, work->span, work->shard);
 }
 
 // Reader thread fonksiyonu
 void* read_packets(void* arg) {
     r_thread_args_t* args = (r_thread_args_t*) arg;
-    rbctx_t* ctx = args->ctx;
-    connection_t* connections = args->connections;
-    int nr_of_connections = args->nr_of_connections;
+    rbgroup_t* group = args->group;
     volatile bool* running = args->running;
-    size_t buffer_len;
-    buffer_len = MESSAGE_SIZE;
-    unsigned char buf[MESSAGE_SIZE];
+    rbspan_t span;
+    struct timespec deadline;
+    size_t shard;
+    int latency_on = atomic_load_explicit(&latency_enabled, memory_order_relaxed);
+    work_args_t work = {.args = args, .span = &span, .shard = &shard};
 
     while (*running) {
-        while (ringbuffer_read(ctx, buf, &buffer_len) == SUCCESS) {
-            size_t from, to, packet_id;
-            memcpy(&from, buf, sizeof(size_t));
-            memcpy(&to, buf + sizeof(size_t), sizeof(size_t));
-            memcpy(&packet_id, buf + 2 * sizeof(size_t), sizeof(size_t));
-            bool is_message_valid = validate(from, to, buf + 3 * sizeof(size_t), buffer_len - 3 * sizeof(size_t));
-
-            if(!is_message_valid) {
-                break;
+        // our own batches first, oldest packets first
+        packet_batch_t* batch = steal_pop(args->exec, args->index);
+        if (batch == NULL) {
+            // sleep until a packet arrives or another thread queues a batch, or while parked,
+            // wake up now and then to notice cancellation
+            ringbuffer_deadline(&deadline, READ_WAIT_NS);
+            if (pool_park(args->pool, args->index, &deadline) != SUCCESS) {
+                pthread_testcancel();
+                continue;
+            }
+            int found = ringbuffer_signal_wait(&group->signal_read, RINGBUFFER_EMPTY, &deadline, try_work, &work);
+            if (found != SUCCESS) {
+                pool_observe(args->pool, ringbuffer_group_occupancy(group));
+                pthread_testcancel();
+                continue;
             }
+        }
 
-            for (int i = 0; i < nr_of_connections; i++) {
-                if ((size_t) connections[i].to == to) {
-                    // pthread_mutex_lock(&args->file_mutexes[i]);
-                    fwrite(buf + 3 * sizeof(size_t), 1, buffer_len - 3 * sizeof(size_t), args->file_handlers[i]);
-                    // pthread_mutex_unlock(&args->file_mutexes[i]);
-                    usleep(((rand() % 50) + 25)); // sleep for a random time between 25 and 75 us
-                }
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        if (batch == NULL && work.stolen != NULL) {
+            batch = work.stolen;
+        } else if (batch == NULL) {
+            // the packets are copied out and the shard released right away, so the connection's
+            // next packets are read in parallel. its reorder window restores their order.
+            // we run the oldest batch, the others wait in our deque for us or for idle threads,
+            // pushed newest first so we pop them oldest first and thieves take the newest
+            packet_batch_t* filled[STEAL_BATCHES];
+            size_t filled_count = fill_batches(args, &span, shard, filled, latency_on);
+            for (size_t i = filled_count; i-- > 1;) {
+                steal_push(args->exec, args->index, filled[i]);
             }
+            batch = filled[0];
         }
-        usleep(((rand() % 99) + 1)); // sleep for a random time between 25 and 75 us
+        pool_observe(args->pool, ringbuffer_group_occupancy(group));
+        run_batch(args, batch, latency_on);
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
     }
     return NULL;
 }
@@ -153,16 +414,111 @@ void* read_packets(void* arg) {
 
 /********************************************************************/
 
+// a thread count from the environment, anything but a whole number in [min, DAEMON_MAX_THREADS] ends the program
+static int env_threads(const char* name, const char* value, int min) {
+    char* end;
+    errno = 0;
+    long threads = strtol(value, &end, 10);
+    if (errno != 0 || end == value || *end != '\0' || threads < min || threads > DAEMON_MAX_THREADS) {
+        fprintf(stderr, "%s=%s is not a thread count between %d and %d\n", name, value, min, DAEMON_MAX_THREADS);
+        exit(1);
+    }
+    return (int) threads;
+}
+
+void daemon_config_from_env(daemon_config_t* config) {
+    config->threads = NUMBER_OF_PROCESSING_THREADS;
+    config->min_threads = 0;
+    config->max_threads = 0;
+    config->rules_file = getenv("RBUF_RULES_FILE");
+    const char* match = getenv("RBUF_MATCH");
+    config->match = match != NULL && strcmp(match, "stream") == 0 ? DAEMON_MATCH_STREAM : DAEMON_MATCH_PACKET;
+
+    const char* threads = getenv("RBUF_THREADS");
+    if (threads != NULL) {
+        config->threads = strcmp(threads, "auto") == 0 ? DAEMON_THREADS_AUTO :
+                          env_threads("RBUF_THREADS", threads, 1);
+    }
+    const char* min_threads = getenv("RBUF_THREADS_MIN");
+    if (min_threads != NULL) {
+        config->min_threads = env_threads("RBUF_THREADS_MIN", min_threads, 0);
+    }
+    const char* max_threads = getenv("RBUF_THREADS_MAX");
+    if (max_threads != NULL) {
+        config->max_threads = env_threads("RBUF_THREADS_MAX", max_threads, 0);
+    }
+}
+
+// the pool's bounds, a fixed size is a pool that never scales
+static rbpool_config_t pool_config(const daemon_config_t* config) {
+    rbpool_config_t pool = {0};
+    if (config->threads > 0) {
+        pool.min_threads = pool.max_threads = config->threads;
+        return pool;
+    }
+    pool.min_threads = config->min_threads > 0 ? config->min_threads : 1;
+    pool.max_threads = config->max_threads > 0 ? config->max_threads : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (pool.max_threads < pool.min_threads) {
+        pool.max_threads = pool.min_threads;
+    }
+    return pool;
+}
+
 int simpledaemon(connection_t* connections, int nr_of_connections) {
-    /* initialize ringbuffer */
-    rbctx_t rb_ctx;
-    size_t rbuf_size = 1024;
-    void *rbuf = malloc(rbuf_size);
+    /* RBUF_THREADS, RBUF_THREADS_MIN and RBUF_THREADS_MAX size the processing pool,
+     * RBUF_RULES_FILE replaces the built-in filter rules */
+    daemon_config_t config;
+    daemon_config_from_env(&config);
+    return simpledaemon_config(connections, nr_of_connections, &config);
+}
+
+int simpledaemon_config(connection_t* connections, int nr_of_connections, const daemon_config_t* config) {
+    /* RBUF_TRACE_LEVEL / RBUF_TRACE_FILE turn on ringbuffer tracing */
+    const char* trace_file = trace_configure_from_env();
+    /* RBUF_LATENCY=1 times every packet, the report goes to RBUF_LATENCY_FILE or stdout */
+    const char* latency_file = latency_configure_from_env();
+
+    /* the filter rules are compiled once, before any packet */
+    rbrules_t rules;
+    char rules_error[256];
+    int rules_status = config->rules_file != NULL ?
+        rules_load(&rules, config->rules_file, MAXIMUM_PORT, rules_error, sizeof(rules_error)) :
+        rules_compile(&rules, default_rules, MAXIMUM_PORT, rules_error, sizeof(rules_error));
+    if (rules_status != SUCCESS) {
+        fprintf(stderr, "Error in filter rules %s: %s\n", config->rules_file != NULL ? config->rules_file : "",
+                rules_status == RINGBUFFER_ALLOC_FAILED ? "out of memory" : rules_error);
+        exit(1);
+    }
+
+    /* initialize ringbuffer: a group with one single-producer ring per connection */
+    rbgroup_t rb_group;
+    rbshard_t shards[nr_of_connections];
+#ifdef DAEMON_SLOT_RING
+    /* -DDAEMON_SLOT_RING: every packet is MESSAGE_SIZE bytes (and a timestamp), so they go into fixed slots */
+    slotring_t slot_rings[nr_of_connections];
+    size_t packet_size = MESSAGE_SIZE + (atomic_load_explicit(&latency_enabled, memory_order_relaxed) ? sizeof(uint64_t) : 0);
+    size_t shard_size = slotring_memory_size(8, packet_size);
+    void *rbuf = malloc(shard_size * nr_of_connections);
     if (rbuf == NULL) {
         fprintf(stderr, "Error allocation ringbuffer\n");
+        exit(1);
     }
+#else
+    size_t shard_size = 1024;
+#endif
 
-    ringbuffer_init(&rb_ctx, rbuf, rbuf_size);
+    for (int i = 0; i < nr_of_connections; i++) {
+#ifdef DAEMON_SLOT_RING
+        slotring_init(&slot_rings[i], (uint8_t *) rbuf + i * shard_size, shard_size, packet_size);
+        ringbuffer_init_slotring(&shards[i].ring, &slot_rings[i]);
+#else
+        if (ringbuffer_create(&shards[i].ring, shard_size, RBUF_SPSC | RBUF_FRAME_VARINT | RBUF_PREFAULT) != SUCCESS) {
+            fprintf(stderr, "Error allocation ringbuffer\n");
+            exit(1);
+        }
+#endif
+    }
+    ringbuffer_group_init(&rb_group, shards, nr_of_connections);
 
     /****************************************************************
     * WRITER THREADS
@@ -171,7 +527,7 @@ int simpledaemon(connection_t* connections, int nr_of_connections) {
     /* prepare writer thread arguments */
     w_thread_args_t w_thread_args[nr_of_connections];
     for (int i = 0; i < nr_of_connections; i++) {
-        w_thread_args[i].ctx = &rb_ctx;
+        w_thread_args[i].ctx = ringbuffer_group_shard(&rb_group, i);
         w_thread_args[i].connection = &connections[i];
         /* guarantee that port numbers range from MINIMUM_PORT (0) - MAXIMUMPORT */
         if (connections[i].from > MAXIMUM_PORT || connections[i].to > MAXIMUM_PORT ||
@@ -191,7 +547,8 @@ int simpledaemon(connection_t* connections, int nr_of_connections) {
     * READER THREADS
     * ***************************************************************/
 
-    pthread_t r_threads[NUMBER_OF_PROCESSING_THREADS];
+    rbpool_t pool;
+    rbpool_config_t r_pool_config = pool_config(config);
 
     /* END OF PROVIDED CODE */
 
@@ -203,27 +560,76 @@ int simpledaemon(connection_t* connections, int nr_of_connections) {
     // 2. start the processing threads
 
     // Prepare arguments for reader threads
-    pthread_mutex_t file_mutexes[nr_of_connections];
     FILE* file_handlers[nr_of_connections];
     for (int i = 0; i < nr_of_connections; i++) {
         char output_filename[20];
         int to = connections[i].to;
         sprintf(output_filename, "%d.txt", to);
         file_handlers[i] = fopen(output_filename, "a");
-        pthread_mutex_init(&file_mutexes[i], NULL);
+    }
+
+    // a connection's packets leave through its window in packet_id order, which is the order
+    // its flow state sees them in
+    rbreorder_t windows[nr_of_connections];
+    flow_t flows[nr_of_connections];
+    size_t packet_out_len = sizeof(packet_out_t) + nr_of_connections * sizeof(uint32_t) + MESSAGE_SIZE;
+    for (int i = 0; i < nr_of_connections; i++) {
+        flows[i] = (flow_t) {.file_handlers = file_handlers, .rules = &rules,
+                             .match_stream = config->match == DAEMON_MATCH_STREAM, .match_state = RBUF_RULES_START,
+                             .seed = (unsigned int) i + 1};
+        if (reorder_init(&windows[i], REORDER_WINDOW, packet_out_len, DAEMON_REORDER_POLICY,
+                         READ_WAIT_NS, write_packet, &flows[i]) != SUCCESS) {
+            fprintf(stderr, "Error allocation reorder window\n");
+            exit(1);
+        }
+    }
+
+    // a packet goes to every connection whose to port is its destination, looked up in one step
+    rbrouter_t router;
+    rbroute_t routes[nr_of_connections];
+    for (int i = 0; i < nr_of_connections; i++) {
+        routes[i] = (rbroute_t) {.port = (uint16_t) connections[i].to, .sink = (uint32_t) i};
+    }
+    if (route_init(&router) != SUCCESS || route_set(&router, routes, nr_of_connections) != SUCCESS) {
+        fprintf(stderr, "Error allocation routing table\n");
+        exit(1);
     }
 
     volatile bool running = true;
 
-    r_thread_args_t r_thread_args[NUMBER_OF_PROCESSING_THREADS];
-    for (int i = 0; i < NUMBER_OF_PROCESSING_THREADS; i++) {
-        r_thread_args[i].ctx = &rb_ctx;
-        r_thread_args[i].connections = connections;
-        r_thread_args[i].file_handlers = file_handlers;
+    // idle threads take batches from busy ones, a slow write doesn't hold up the packets behind it
+    rbsteal_t exec;
+    packet_batch_t* batches = malloc(r_pool_config.max_threads * STEAL_BATCHES * sizeof(packet_batch_t));
+    if (batches == NULL ||
+        steal_init(&exec, r_pool_config.max_threads, STEAL_BATCHES, &rb_group.signal_read) != SUCCESS) {
+        fprintf(stderr, "Error allocation executor\n");
+        exit(1);
+    }
+    for (int i = 0; i < r_pool_config.max_threads * STEAL_BATCHES; i++) {
+        batches[i].owner = i / STEAL_BATCHES;
+        atomic_init(&batches[i].busy, 0);
+    }
+
+    // arguments for every thread the pool may start, it starts min_threads of them now
+    r_thread_args_t r_thread_args[r_pool_config.max_threads];
+    void* r_thread_arg_ptrs[r_pool_config.max_threads];
+    for (int i = 0; i < r_pool_config.max_threads; i++) {
+        r_thread_args[i].group = &rb_group;
+        r_thread_args[i].windows = windows;
+        r_thread_args[i].pool = &pool;
+        r_thread_args[i].index = i;
+        r_thread_args[i].exec = &exec;
+        r_thread_args[i].rules = &rules;
+        r_thread_args[i].router = &router;
+        r_thread_args[i].match_stream = config->match == DAEMON_MATCH_STREAM;
+        r_thread_args[i].batches = batches + i * STEAL_BATCHES;
         r_thread_args[i].nr_of_connections = nr_of_connections;
-        r_thread_args[i].file_mutexes = file_mutexes;
         r_thread_args[i].running = &running;
-        pthread_create(&r_threads[i], NULL, read_packets, &r_thread_args[i]);
+        r_thread_arg_ptrs[i] = &r_thread_args[i];
+    }
+    if (pool_start(&pool, &r_pool_config, read_packets, r_thread_arg_ptrs) != SUCCESS) {
+        fprintf(stderr, "Error starting processing threads\n");
+        exit(1);
     }
 
     pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
@@ -247,8 +653,10 @@ int simpledaemon(connection_t* connections, int nr_of_connections) {
     sleep(5);
 
     printf("Cancelling read threads \n");
-    for (int i = 0; i < NUMBER_OF_PROCESSING_THREADS; i++) {
-        pthread_cancel(r_threads[i]);
+    /* the pool starts no more threads after this */
+    int r_thread_count = pool_stop(&pool);
+    for (int i = 0; i < r_thread_count; i++) {
+        pthread_cancel(pool.threads[i]);
     }
     printf("Cancelled read threads \n");
 
@@ -261,8 +669,8 @@ int simpledaemon(connection_t* connections, int nr_of_connections) {
 
     printf("Joining read threads \n");
     /* join all threads */
-    for (int i = 0; i < NUMBER_OF_PROCESSING_THREADS; i++) {
-        pthread_join(r_threads[i], NULL);
+    for (int i = 0; i < r_thread_count; i++) {
+        pthread_join(pool.threads[i], NULL);
     }
     printf("Joined read threads \n");
 
@@ -274,10 +682,32 @@ int simpledaemon(connection_t* connections, int nr_of_connections) {
 
     /* YOUR CODE STARTS HERE */
 
+    pool_destroy(&pool);
+    steal_destroy(&exec);
+    rules_destroy(&rules);
+    route_destroy(&router);
+    free(batches);
+    for (int i = 0; i < nr_of_connections; i++) {
+        // a window left with a gap by a cancelled thread still gets out what it has
+        reorder_flush(&windows[i]);
+        reorder_destroy(&windows[i]);
+    }
     for (int i = 0; i < nr_of_connections; i++) {
-        pthread_mutex_destroy(&file_mutexes[i]);
         fclose(file_handlers[i]);
     }
+
+    if (trace_file != NULL && trace_dump(trace_file) != 0) {
+        fprintf(stderr, "Cannot write trace file %s\n", trace_file);
+    }
+    if (atomic_load_explicit(&latency_enabled, memory_order_relaxed)) {
+        FILE* latency_fp = latency_file != NULL ? fopen(latency_file, "w") : stdout;
+        if (latency_fp == NULL || latency_report(latency_fp) != 0) {
+            fprintf(stderr, "Cannot write latency report %s\n", latency_file);
+        }
+        if (latency_fp != NULL && latency_fp != stdout) {
+            fclose(latency_fp);
+        }
+    }
     /* YOUR CODE ENDS HERE */
 
     /********************************************************************/
@@ -287,8 +717,18 @@ int simpledaemon(connection_t* connections, int nr_of_connections) {
     /* IN THE FOLLOWING IS THE CODE PROVIDED FOR YOU
     * changing the code will result in points deduction */
 
+    /* the rings go before their memory */
+    ringbuffer_group_destroy(&rb_group);
+    for (int i = 0; i < nr_of_connections; i++) {
+#ifdef DAEMON_SLOT_RING
+        ringbuffer_destroy(&shards[i].ring);
+#else
+        ringbuffer_free(&shards[i].ring);
+#endif
+    }
+#ifdef DAEMON_SLOT_RING
     free(rbuf);
-    ringbuffer_destroy(&rb_ctx);
+#endif
 
     return 0;
 
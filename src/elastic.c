@@ -0,0 +1,293 @@
+#define _GNU_SOURCE
+#include "../include/elastic.h"
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+int ringbuffer_elastic_create(rbelastic_t *elastic, const rbelastic_config_t *config, int flags)
+{
+    elastic->config = *config;
+    if (elastic->config.high_water == 0) {
+        elastic->config.high_water = RBUF_ELASTIC_DEFAULT_HIGH_WATER;
+    }
+    if (elastic->config.low_water == 0) {
+        elastic->config.low_water = RBUF_ELASTIC_DEFAULT_LOW_WATER;
+    }
+    if (elastic->config.max_size < elastic->config.initial_size) {
+        elastic->config.max_size = elastic->config.initial_size;
+    }
+    assert(elastic->config.low_water < elastic->config.high_water && elastic->config.high_water <= 100);
+
+    elastic->active = 0;
+    elastic->flags = flags;
+    if (ringbuffer_create(&elastic->rings[0], elastic->config.initial_size, flags) != SUCCESS) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+
+    // a waiting migration keeps new operations out, otherwise a steady stream of them could starve it
+    pthread_rwlockattr_t attr;
+    pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+    pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init(&elastic->migration, &attr);
+    pthread_rwlockattr_destroy(&attr);
+
+    atomic_init(&elastic->high_since, 0);
+    atomic_init(&elastic->low_since, 0);
+    atomic_init(&elastic->grown, 0);
+    atomic_init(&elastic->shrunk, 0);
+    atomic_init(&elastic->signal_read.seq, 0);
+    atomic_init(&elastic->signal_read.waiters, 0);
+    elastic->signal_read.process_shared = 0;
+    atomic_init(&elastic->signal_write.seq, 0);
+    atomic_init(&elastic->signal_write.waiters, 0);
+    elastic->signal_write.process_shared = 0;
+    return SUCCESS;
+}
+
+/* track how long a condition has held, returns true once it held for duration_ns */
+static int held_for(_Atomic uint64_t *since, int condition, long duration_ns)
+{
+    if (!condition) {
+        if (atomic_load_explicit(since, memory_order_relaxed) != 0) {
+            atomic_store_explicit(since, 0, memory_order_relaxed);
+        }
+        return 0;
+    }
+
+    uint64_t now = ringbuffer_now_ns();
+    uint64_t start = 0;
+    if (atomic_compare_exchange_strong_explicit(since, &start, now, memory_order_relaxed, memory_order_relaxed)) {
+        return duration_ns <= 0;
+    }
+    return now - start >= (uint64_t) duration_ns;
+}
+
+/* the caller holds the lock shared, incoming bytes are about to be written */
+static int should_grow(rbelastic_t *elastic, rbctx_t *ring, size_t incoming)
+{
+    if (ring->size >= elastic->config.max_size) {
+        return 0;
+    }
+    size_t used = ring->size - ringbuffer_available(ring) + incoming;
+    return held_for(&elastic->high_since, used * 100 >= ring->size * elastic->config.high_water,
+                    elastic->config.grow_after_ns);
+}
+
+static int should_shrink(rbelastic_t *elastic, rbctx_t *ring)
+{
+    if (ring->size <= elastic->config.initial_size) {
+        return 0;
+    }
+    size_t used = ring->size - ringbuffer_available(ring);
+    return held_for(&elastic->low_since, used * 100 <= ring->size * elastic->config.low_water,
+                    elastic->config.shrink_after_ns);
+}
+
+/* move every record into a new ring of new_size, in order. The ring must still be
+ * old_size, another thread may have migrated it while we waited for the lock */
+static void migrate(rbelastic_t *elastic, size_t old_size, size_t new_size)
+{
+    pthread_rwlock_wrlock(&elastic->migration);
+
+    rbctx_t *from = &elastic->rings[elastic->active];
+    rbctx_t *to = &elastic->rings[!elastic->active];
+    size_t used = from->size - ringbuffer_available(from);
+    // records are framed the same in both rings, so they take at most the bytes they take now
+    if (from->size != old_size || used > new_size || ringbuffer_create(to, new_size, elastic->flags) != SUCCESS) {
+        pthread_rwlock_unlock(&elastic->migration);
+        return;
+    }
+
+    rbspan_t span, copy;
+    while (ringbuffer_peek(from, &span) == SUCCESS) {
+        size_t message_len = span.len[0] + span.len[1];
+        int status = ringbuffer_reserve(to, message_len, &copy);
+        assert(status == SUCCESS);
+        (void) status;
+        ringbuffer_span_copy_in(&copy, 0, span.data[0], span.len[0]);
+        ringbuffer_span_copy_in(&copy, span.len[0], span.data[1], span.len[1]);
+        ringbuffer_commit(to, &copy, message_len);
+        ringbuffer_consume(from, &span);
+    }
+    ringbuffer_free(from);
+    elastic->active = !elastic->active;
+
+    atomic_store_explicit(&elastic->high_since, 0, memory_order_relaxed);
+    atomic_store_explicit(&elastic->low_since, 0, memory_order_relaxed);
+    atomic_fetch_add_explicit(new_size > old_size ? &elastic->grown : &elastic->shrunk, 1, memory_order_relaxed);
+    pthread_rwlock_unlock(&elastic->migration);
+
+    // sleeping writers may fit now, readers may have missed records while they moved
+    ringbuffer_signal_wake(&elastic->signal_write);
+    ringbuffer_signal_wake(&elastic->signal_read);
+}
+
+static void grow(rbelastic_t *elastic, size_t size)
+{
+    size_t new_size = size * 2 < elastic->config.max_size ? size * 2 : elastic->config.max_size;
+    migrate(elastic, size, new_size);
+}
+
+static void shrink(rbelastic_t *elastic, size_t size)
+{
+    size_t new_size = size / 2 > elastic->config.initial_size ? size / 2 : elastic->config.initial_size;
+    migrate(elastic, size, new_size);
+}
+
+int ringbuffer_elastic_reserve(rbelastic_t *elastic, size_t message_len, rbspan_t *span)
+{
+    for (;;) {
+        pthread_rwlock_rdlock(&elastic->migration);
+        rbctx_t *ring = &elastic->rings[elastic->active];
+
+        if (should_grow(elastic, ring, message_len)) {
+            size_t size = ring->size;
+            pthread_rwlock_unlock(&elastic->migration);
+            grow(elastic, size);
+            continue;
+        }
+
+        // the lock stays shared until the commit, the reservation points into this ring
+        if (ringbuffer_reserve(ring, message_len, span) == SUCCESS) {
+            return SUCCESS;
+        }
+        pthread_rwlock_unlock(&elastic->migration);
+        return RINGBUFFER_FULL;
+    }
+}
+
+void ringbuffer_elastic_commit(rbelastic_t *elastic, rbspan_t *span, size_t message_len)
+{
+    ringbuffer_commit(&elastic->rings[elastic->active], span, message_len);
+    pthread_rwlock_unlock(&elastic->migration);
+    ringbuffer_signal_wake(&elastic->signal_read);
+}
+
+void ringbuffer_elastic_cancel(rbelastic_t *elastic, rbspan_t *span)
+{
+    ringbuffer_cancel(&elastic->rings[elastic->active], span);
+    pthread_rwlock_unlock(&elastic->migration);
+}
+
+/* end of a read side operation: drop the shared lock, wake writers if room was freed, shrink if idle long enough */
+static void finish_read(rbelastic_t *elastic, rbctx_t *ring, int freed)
+{
+    size_t size = ring->size;
+    int shrink_now = should_shrink(elastic, ring);
+    pthread_rwlock_unlock(&elastic->migration);
+
+    if (freed) {
+        ringbuffer_signal_wake(&elastic->signal_write);
+    }
+    if (shrink_now) {
+        shrink(elastic, size);
+    }
+}
+
+int ringbuffer_elastic_peek(rbelastic_t *elastic, rbspan_t *span)
+{
+    pthread_rwlock_rdlock(&elastic->migration);
+    rbctx_t *ring = &elastic->rings[elastic->active];
+
+    // the lock stays shared until the consume, the span points into this ring
+    if (ringbuffer_peek(ring, span) == SUCCESS) {
+        return SUCCESS;
+    }
+    finish_read(elastic, ring, 0);
+    return RINGBUFFER_EMPTY;
+}
+
+void ringbuffer_elastic_consume(rbelastic_t *elastic, rbspan_t *span)
+{
+    rbctx_t *ring = &elastic->rings[elastic->active];
+    ringbuffer_consume(ring, span);
+    finish_read(elastic, ring, 1);
+}
+
+int ringbuffer_elastic_write(rbelastic_t *elastic, const void *message, size_t message_len)
+{
+    rbspan_t span;
+    if (ringbuffer_elastic_reserve(elastic, message_len, &span) != SUCCESS) {
+        return RINGBUFFER_FULL;
+    }
+    ringbuffer_span_copy_in(&span, 0, message, message_len);
+    ringbuffer_elastic_commit(elastic, &span, message_len);
+    return SUCCESS;
+}
+
+int ringbuffer_elastic_read(rbelastic_t *elastic, void *buffer, size_t *buffer_len)
+{
+    pthread_rwlock_rdlock(&elastic->migration);
+    rbctx_t *ring = &elastic->rings[elastic->active];
+
+    int status = ringbuffer_read(ring, buffer, buffer_len);
+    finish_read(elastic, ring, status == SUCCESS);
+    return status;
+}
+
+typedef struct {
+    rbelastic_t *elastic;
+    void *data;
+    size_t len;
+    size_t *len_ptr;
+} wait_args_t;
+
+static int try_write(void *arg)
+{
+    wait_args_t *args = arg;
+    return ringbuffer_elastic_write(args->elastic, args->data, args->len);
+}
+
+static int try_read(void *arg)
+{
+    wait_args_t *args = arg;
+    return ringbuffer_elastic_read(args->elastic, args->data, args->len_ptr);
+}
+
+static int before(const struct timespec *a, const struct timespec *b)
+{
+    return a->tv_sec < b->tv_sec || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+int ringbuffer_elastic_write_wait(rbelastic_t *elastic, const void *message, size_t message_len,
+                                  const struct timespec *deadline)
+{
+    wait_args_t args = {.elastic = elastic, .data = (void *) message, .len = message_len};
+
+    // a full ring only grows when a writer comes back to it, so don't sleep past the grow delay
+    for (;;) {
+        struct timespec step;
+        ringbuffer_deadline(&step, elastic->config.grow_after_ns > 0 ? elastic->config.grow_after_ns : 1000000L);
+        if (deadline != NULL && before(deadline, &step)) {
+            step = *deadline;
+        }
+
+        int status = ringbuffer_signal_wait(&elastic->signal_write, RINGBUFFER_FULL, &step, try_write, &args);
+        if (status != RINGBUFFER_FULL || (deadline != NULL && !before(&step, deadline))) {
+            return status;
+        }
+    }
+}
+
+int ringbuffer_elastic_read_wait(rbelastic_t *elastic, void *buffer, size_t *buffer_len,
+                                 const struct timespec *deadline)
+{
+    wait_args_t args = {.elastic = elastic, .data = buffer, .len_ptr = buffer_len};
+    return ringbuffer_signal_wait(&elastic->signal_read, RINGBUFFER_EMPTY, deadline, try_read, &args);
+}
+
+size_t ringbuffer_elastic_capacity(rbelastic_t *elastic)
+{
+    pthread_rwlock_rdlock(&elastic->migration);
+    size_t size = elastic->rings[elastic->active].size;
+    pthread_rwlock_unlock(&elastic->migration);
+    return size;
+}
+
+void ringbuffer_elastic_free(rbelastic_t *elastic)
+{
+    ringbuffer_free(&elastic->rings[elastic->active]);
+    pthread_rwlock_destroy(&elastic->migration);
+}
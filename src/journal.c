@@ -0,0 +1,311 @@
+#define _GNU_SOURCE
+#include "../include/journal.h"
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* positions only grow, a late store must not move one back */
+static void advance(rbindex_t *index, uint64_t pos)
+{
+    uint64_t current = atomic_load_explicit(&index->pos, memory_order_relaxed);
+    while (current < pos && !atomic_compare_exchange_weak_explicit(&index->pos, &current, pos,
+                                                                  memory_order_release, memory_order_relaxed)) {
+    }
+}
+
+/* the header and ring of a new file, the magic goes last so a half created journal is never opened */
+static int create_journal(rbjournal_t *journal, size_t buffer_size, int flags)
+{
+    if (flags & RBUF_FRAME_ALIGNED) {
+        buffer_size -= buffer_size % RBUF_CACHE_LINE;
+    } else if (flags & RBUF_MPMC) {
+        // whole commit words, see ringbuffer_init_flags
+        buffer_size -= buffer_size % sizeof(uint64_t);
+    }
+    journal->mapping_len = journal->page_size + buffer_size;
+    if (ftruncate(journal->fd, journal->mapping_len) != 0) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    void *mapping = mmap(NULL, journal->mapping_len, PROT_READ | PROT_WRITE, MAP_SHARED, journal->fd, 0);
+    if (mapping == MAP_FAILED) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+
+    rbjournal_header_t *header = mapping;
+    header->version = RBUF_JOURNAL_VERSION;
+    header->flags = (uint32_t) flags;
+    header->capacity = buffer_size;
+    header->data_offset = journal->page_size;
+    atomic_init(&header->committed.pos, 0);
+    atomic_init(&header->consumed.pos, 0);
+    if (fdatasync(journal->fd) != 0) {
+        munmap(mapping, journal->mapping_len);
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    memcpy(header->magic, RBUF_JOURNAL_MAGIC, sizeof(header->magic));
+    if (fdatasync(journal->fd) != 0) {
+        munmap(mapping, journal->mapping_len);
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    journal->header = header;
+    return SUCCESS;
+}
+
+static int map_journal(rbjournal_t *journal, size_t file_size)
+{
+    if (file_size < journal->page_size) {
+        return RINGBUFFER_INCOMPATIBLE;
+    }
+    journal->mapping_len = file_size;
+    void *mapping = mmap(NULL, journal->mapping_len, PROT_READ | PROT_WRITE, MAP_SHARED, journal->fd, 0);
+    if (mapping == MAP_FAILED) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+
+    rbjournal_header_t *header = mapping;
+    uint64_t committed = atomic_load_explicit(&header->committed.pos, memory_order_relaxed);
+    uint64_t consumed = atomic_load_explicit(&header->consumed.pos, memory_order_relaxed);
+    // a reader may have consumed records whose commit wasn't recorded yet
+    if (committed < consumed) {
+        committed = consumed;
+    }
+    if (memcmp(header->magic, RBUF_JOURNAL_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != RBUF_JOURNAL_VERSION || header->data_offset % journal->page_size != 0 ||
+        header->data_offset == 0 || header->data_offset + header->capacity > file_size ||
+        committed - consumed > header->capacity) {
+        munmap(mapping, journal->mapping_len);
+        return RINGBUFFER_INCOMPATIBLE;
+    }
+    atomic_store_explicit(&header->committed.pos, committed, memory_order_relaxed);
+    journal->header = header;
+    return SUCCESS;
+}
+
+int ringbuffer_journal_open(rbjournal_t *journal, const char *path, size_t buffer_size, int flags,
+                            const rbjournal_sync_t *sync)
+{
+    // the journal tracks one contiguous consumed position, so nothing may be released before it is recorded
+    assert(!(flags & (RBUF_OVERWRITE | RBUF_MIRRORED | RBUF_SLOTS | RBUF_SHARED | RBUF_OWNED)));
+
+    journal->page_size = (size_t) sysconf(_SC_PAGESIZE);
+    journal->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (journal->fd < 0) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    struct stat st;
+    if (fstat(journal->fd, &st) != 0) {
+        close(journal->fd);
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    // a crash while creating it leaves a file without magic, that one is created again
+    char magic[sizeof(RBUF_JOURNAL_MAGIC)] = {0};
+    static const char no_magic[sizeof(magic)];
+    if (st.st_size > 0 && pread(journal->fd, magic, sizeof(magic), 0) < 0) {
+        close(journal->fd);
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    int fresh = st.st_size == 0 || memcmp(magic, no_magic, sizeof(magic)) == 0;
+    int status = fresh ? create_journal(journal, buffer_size, flags) : map_journal(journal, st.st_size);
+    if (status != SUCCESS) {
+        close(journal->fd);
+        return status;
+    }
+
+    // resume where it stopped: reservations and claims of the last run are gone
+    rbjournal_header_t *header = journal->header;
+    uint64_t committed = atomic_load_explicit(&header->committed.pos, memory_order_relaxed);
+    uint64_t consumed = atomic_load_explicit(&header->consumed.pos, memory_order_relaxed);
+    ringbuffer_init_resume(&journal->ring, (uint8_t *) header + header->data_offset, header->capacity,
+                           (int) header->flags, consumed, committed);
+
+    if (sync != NULL) {
+        journal->sync = *sync;
+    } else {
+        journal->sync = (rbjournal_sync_t) {.policy = RBUF_SYNC_NONE, .method = RBUF_SYNC_MSYNC};
+    }
+    pthread_mutex_init(&journal->reader, NULL);
+    pthread_mutex_init(&journal->syncing, NULL);
+    journal->synced_committed = committed;
+    journal->synced_consumed = consumed;
+    atomic_init(&journal->last_sync_ns, ringbuffer_now_ns());
+    atomic_init(&journal->sync_failed, 0);
+    return SUCCESS;
+}
+
+/* msync the pages holding ring bytes [from, to) */
+static int msync_ring(rbjournal_t *journal, uint64_t from, uint64_t to)
+{
+    rbctx_t *ring = &journal->ring;
+    if (to - from >= ring->size) {
+        from = 0;
+        to = ring->size;
+    }
+    size_t start = from % ring->size, end = start + (size_t) (to - from);
+    if (end > ring->size) {
+        // wraps around the end, the part at the start of the ring goes first
+        if (msync(ring->begin, end - ring->size, MS_SYNC) != 0) {
+            return -1;
+        }
+        end = ring->size;
+    }
+    uint8_t *page = ring->begin + start - (uintptr_t) (ring->begin + start) % journal->page_size;
+    return msync(page, ring->begin + end - page, MS_SYNC);
+}
+
+static int sync_locked(rbjournal_t *journal)
+{
+    rbjournal_header_t *header = journal->header;
+    uint64_t committed = atomic_load_explicit(&journal->ring.state->write_tail.pos, memory_order_acquire);
+    uint64_t consumed = atomic_load_explicit(&header->consumed.pos, memory_order_acquire);
+    if (committed == journal->synced_committed && consumed == journal->synced_consumed) {
+        return 0;
+    }
+
+    // the records first, then the header that makes them part of the journal
+    int failed = 0;
+    if (committed != journal->synced_committed) {
+        if (journal->sync.method == RBUF_SYNC_FDATASYNC) {
+            failed |= fdatasync(journal->fd) != 0;
+        } else {
+            failed |= msync_ring(journal, journal->synced_committed, committed) != 0;
+        }
+        advance(&header->committed, committed);
+    }
+    if (journal->sync.method == RBUF_SYNC_FDATASYNC) {
+        failed |= fdatasync(journal->fd) != 0;
+    } else {
+        failed |= msync(header, journal->page_size, MS_SYNC) != 0;
+    }
+
+    journal->synced_committed = committed;
+    journal->synced_consumed = consumed;
+    atomic_store_explicit(&journal->last_sync_ns, ringbuffer_now_ns(), memory_order_relaxed);
+    return failed ? -1 : 0;
+}
+
+int ringbuffer_journal_sync(rbjournal_t *journal)
+{
+    pthread_mutex_lock(&journal->syncing);
+    if (sync_locked(journal) != 0) {
+        atomic_store_explicit(&journal->sync_failed, 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&journal->syncing);
+    return atomic_load_explicit(&journal->sync_failed, memory_order_relaxed) ? RINGBUFFER_SYNC_FAILED : SUCCESS;
+}
+
+/* called after records were committed or consumed, syncs if the policy says so */
+static int after_change(rbjournal_t *journal)
+{
+    switch (journal->sync.policy) {
+    case RBUF_SYNC_BATCH:
+        return ringbuffer_journal_sync(journal);
+    case RBUF_SYNC_INTERVAL:
+        if (ringbuffer_now_ns() - atomic_load_explicit(&journal->last_sync_ns, memory_order_relaxed) >=
+            (uint64_t) journal->sync.interval_ns) {
+            return ringbuffer_journal_sync(journal);
+        }
+        break;
+    }
+    return SUCCESS;
+}
+
+/* records are committed in the ring, the header follows per policy */
+static int after_commit(rbjournal_t *journal)
+{
+    if (journal->sync.policy == RBUF_SYNC_NONE) {
+        // without syncs there is no order to keep, the page cache has the records already
+        advance(&journal->header->committed, atomic_load_explicit(&journal->ring.state->write_tail.pos,
+                                                                  memory_order_acquire));
+        return SUCCESS;
+    }
+    return after_change(journal);
+}
+
+int ringbuffer_journal_reserve(rbjournal_t *journal, size_t message_len, rbspan_t *span)
+{
+    return ringbuffer_reserve(&journal->ring, message_len, span);
+}
+
+int ringbuffer_journal_commit(rbjournal_t *journal, rbspan_t *span, size_t message_len)
+{
+    ringbuffer_commit(&journal->ring, span, message_len);
+    return after_commit(journal);
+}
+
+int ringbuffer_journal_write(rbjournal_t *journal, const void *message, size_t message_len)
+{
+    int status = ringbuffer_write(&journal->ring, (void *) message, message_len);
+    if (status != SUCCESS) {
+        return status;
+    }
+    return after_commit(journal);
+}
+
+int ringbuffer_journal_write_batch(rbjournal_t *journal, const struct iovec *messages, size_t count)
+{
+    int status = ringbuffer_write_batch(&journal->ring, messages, count);
+    if (status != SUCCESS) {
+        return status;
+    }
+    return after_commit(journal);
+}
+
+int ringbuffer_journal_peek(rbjournal_t *journal, rbspan_t *span)
+{
+    pthread_mutex_lock(&journal->reader);
+    int status = ringbuffer_peek(&journal->ring, span);
+    if (status != SUCCESS) {
+        pthread_mutex_unlock(&journal->reader);
+    }
+    return status;
+}
+
+int ringbuffer_journal_consume(rbjournal_t *journal, rbspan_t *span)
+{
+    // recorded before the ring releases the memory, a writer may reuse it right after
+    advance(&journal->header->consumed, span->position + span->record_len);
+    int status = SUCCESS;
+    if (journal->sync.policy == RBUF_SYNC_BATCH) {
+        status = ringbuffer_journal_sync(journal);
+    }
+    ringbuffer_consume(&journal->ring, span);
+    pthread_mutex_unlock(&journal->reader);
+    if (journal->sync.policy == RBUF_SYNC_INTERVAL) {
+        status = after_change(journal);
+    }
+    return status;
+}
+
+int ringbuffer_journal_read(rbjournal_t *journal, void *buffer, size_t *buffer_len)
+{
+    rbspan_t span;
+    size_t message_len;
+
+    pthread_mutex_lock(&journal->reader);
+    int status = ringbuffer_peek_max(&journal->ring, &span, *buffer_len, &message_len);
+    if (status == OUTPUT_BUFFER_TOO_SMALL) {
+        *buffer_len = message_len;
+    }
+    if (status != SUCCESS) {
+        pthread_mutex_unlock(&journal->reader);
+        return status;
+    }
+
+    ringbuffer_span_copy_out(&span, 0, buffer, message_len);
+    *buffer_len = message_len;
+    return ringbuffer_journal_consume(journal, &span);
+}
+
+void ringbuffer_journal_close(rbjournal_t *journal)
+{
+    ringbuffer_journal_sync(journal);
+    ringbuffer_destroy(&journal->ring);
+    pthread_mutex_destroy(&journal->reader);
+    pthread_mutex_destroy(&journal->syncing);
+    munmap(journal->header, journal->mapping_len);
+    close(journal->fd);
+}
@@ -0,0 +1,179 @@
+#include "../include/latency.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct latency_thread {
+    struct latency_thread *next;
+    latency_hist_t stages[LATENCY_NUMBER_OF_STAGES];
+} latency_thread_t;
+
+_Atomic int latency_enabled = 0;
+
+static _Atomic(latency_thread_t *) threads = NULL;
+static _Thread_local latency_thread_t *local_thread = NULL;
+
+#define LATENCY_NAME(id, name) name,
+static const char *stage_names[] = { LATENCY_STAGES(LATENCY_NAME) };
+#undef LATENCY_NAME
+
+void latency_set_enabled(int enabled)
+{
+    atomic_store_explicit(&latency_enabled, enabled, memory_order_relaxed);
+}
+
+const char *latency_configure_from_env(void)
+{
+    const char *enabled = getenv("RBUF_LATENCY");
+    if (enabled != NULL) {
+        latency_set_enabled(atoi(enabled) != 0);
+    }
+    return getenv("RBUF_LATENCY_FILE");
+}
+
+static size_t bucket_index(uint64_t ns)
+{
+    if (ns < (1u << LATENCY_SUB_BITS)) {
+        return ns;
+    }
+    // group g >= 1 covers [2^(g + SUB - 1), 2^(g + SUB)) in buckets 2^(g - 1) wide
+    size_t group = 63 - __builtin_clzll(ns) - LATENCY_SUB_BITS + 1;
+    if (group > LATENCY_MAX_BITS - LATENCY_SUB_BITS) {
+        return LATENCY_BUCKETS - 1;
+    }
+    return (group << LATENCY_SUB_BITS) + (ns >> (group - 1)) - (1u << LATENCY_SUB_BITS);
+}
+
+/* the largest value that falls into a bucket */
+static uint64_t bucket_upper(size_t index)
+{
+    size_t group = index >> LATENCY_SUB_BITS;
+    if (group == 0) {
+        return index;
+    }
+    uint64_t low = (uint64_t) ((index & ((1u << LATENCY_SUB_BITS) - 1)) + (1u << LATENCY_SUB_BITS)) << (group - 1);
+    return low + (1ull << (group - 1)) - 1;
+}
+
+/* single writer: a load and a store, no read-modify-write */
+static inline void add_relaxed(_Atomic uint64_t *counter, uint64_t n)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+void latency_hist_record(latency_hist_t *hist, uint64_t ns)
+{
+    add_relaxed(&hist->counts[bucket_index(ns)], 1);
+    add_relaxed(&hist->count, 1);
+    add_relaxed(&hist->sum, ns);
+    if (ns > atomic_load_explicit(&hist->max, memory_order_relaxed)) {
+        atomic_store_explicit(&hist->max, ns, memory_order_relaxed);
+    }
+}
+
+void latency_hist_merge(latency_hist_t *dst, latency_hist_t *src)
+{
+    // the total is the sum of the buckets read, so it matches them even while src grows
+    uint64_t count = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        uint64_t n = atomic_load_explicit(&src->counts[i], memory_order_relaxed);
+        add_relaxed(&dst->counts[i], n);
+        count += n;
+    }
+    add_relaxed(&dst->count, count);
+    add_relaxed(&dst->sum, atomic_load_explicit(&src->sum, memory_order_relaxed));
+    uint64_t max = atomic_load_explicit(&src->max, memory_order_relaxed);
+    if (max > atomic_load_explicit(&dst->max, memory_order_relaxed)) {
+        atomic_store_explicit(&dst->max, max, memory_order_relaxed);
+    }
+}
+
+uint64_t latency_hist_percentile(latency_hist_t *hist, double fraction)
+{
+    uint64_t count = atomic_load_explicit(&hist->count, memory_order_relaxed);
+    if (count == 0) {
+        return 0;
+    }
+    // the rank of the value, rounded up and at least the first one
+    double exact = fraction * count;
+    uint64_t rank = (uint64_t) exact;
+    if (rank < exact || rank == 0) {
+        rank++;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += atomic_load_explicit(&hist->counts[i], memory_order_relaxed);
+        if (seen >= rank) {
+            // the last bucket has no upper end, everything too large is in it
+            uint64_t max = atomic_load_explicit(&hist->max, memory_order_relaxed);
+            uint64_t upper = i == LATENCY_BUCKETS - 1 ? max : bucket_upper(i);
+            return upper < max ? upper : max;
+        }
+    }
+    return atomic_load_explicit(&hist->max, memory_order_relaxed);
+}
+
+/* first record of a thread: allocate its histograms and push them onto the global list */
+static latency_thread_t *register_thread(void)
+{
+    latency_thread_t *thread = calloc(1, sizeof(latency_thread_t));
+    if (thread == NULL) {
+        return NULL;
+    }
+
+    thread->next = atomic_load_explicit(&threads, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&threads, &thread->next, thread,
+                                                  memory_order_release, memory_order_relaxed)) {
+    }
+
+    local_thread = thread;
+    return thread;
+}
+
+void latency_record(uint32_t stage, uint64_t ns)
+{
+    if (!atomic_load_explicit(&latency_enabled, memory_order_relaxed) || stage >= LATENCY_NUMBER_OF_STAGES) {
+        return;
+    }
+    latency_thread_t *thread = local_thread;
+    if (thread == NULL && (thread = register_thread()) == NULL) {
+        return;
+    }
+    latency_hist_record(&thread->stages[stage], ns);
+}
+
+void latency_merge(latency_hist_t stages[LATENCY_NUMBER_OF_STAGES])
+{
+    memset(stages, 0, LATENCY_NUMBER_OF_STAGES * sizeof(latency_hist_t));
+    for (latency_thread_t *thread = atomic_load_explicit(&threads, memory_order_acquire); thread != NULL; thread = thread->next) {
+        for (int stage = 0; stage < LATENCY_NUMBER_OF_STAGES; stage++) {
+            latency_hist_merge(&stages[stage], &thread->stages[stage]);
+        }
+    }
+}
+
+int latency_report(FILE *fp)
+{
+    latency_hist_t *stages = malloc(LATENCY_NUMBER_OF_STAGES * sizeof(latency_hist_t));
+    if (stages == NULL) {
+        return -1;
+    }
+    latency_merge(stages);
+
+    fprintf(fp, "%-10s %10s %10s %10s %10s %10s %10s %10s\n",
+            "stage (ns)", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+    for (int stage = 0; stage < LATENCY_NUMBER_OF_STAGES; stage++) {
+        latency_hist_t *hist = &stages[stage];
+        uint64_t count = atomic_load_explicit(&hist->count, memory_order_relaxed);
+        uint64_t mean = count > 0 ? atomic_load_explicit(&hist->sum, memory_order_relaxed) / count : 0;
+        fprintf(fp, "%-10s %10llu %10llu %10llu %10llu %10llu %10llu %10llu\n", stage_names[stage],
+                (unsigned long long) count, (unsigned long long) mean,
+                (unsigned long long) latency_hist_percentile(hist, 0.50),
+                (unsigned long long) latency_hist_percentile(hist, 0.90),
+                (unsigned long long) latency_hist_percentile(hist, 0.99),
+                (unsigned long long) latency_hist_percentile(hist, 0.999),
+                (unsigned long long) atomic_load_explicit(&hist->max, memory_order_relaxed));
+    }
+
+    free(stages);
+    return 0;
+}
@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+#include "../include/pool.h"
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* the caller holds the mutex */
+static int start_worker(rbpool_t *pool)
+{
+    if (pthread_create(&pool->threads[pool->started], NULL, pool->worker, pool->args[pool->started]) != 0) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    pool->started++;
+    return SUCCESS;
+}
+
+/* a start failed: end the workers that did start, nobody else knows about them */
+static void abandon_start(rbpool_t *pool)
+{
+    pool_stop(pool);
+    for (int i = 0; i < pool->started; i++) {
+        pthread_cancel(pool->threads[i]);
+        pthread_join(pool->threads[i], NULL);
+    }
+    pool->started = 0;
+    pool_destroy(pool);
+}
+
+int pool_start(rbpool_t *pool, const rbpool_config_t *config, void *(*worker)(void *), void **args)
+{
+    pool->config = *config;
+    if (pool->config.high_water == 0) {
+        pool->config.high_water = RBUF_POOL_DEFAULT_HIGH_WATER;
+    }
+    if (pool->config.low_water == 0) {
+        pool->config.low_water = RBUF_POOL_DEFAULT_LOW_WATER;
+    }
+    if (pool->config.scale_after_ns == 0) {
+        pool->config.scale_after_ns = RBUF_POOL_DEFAULT_SCALE_AFTER_NS;
+    }
+    if (pool->config.min_threads < 1) {
+        pool->config.min_threads = 1;
+    }
+    if (pool->config.max_threads < pool->config.min_threads) {
+        pool->config.max_threads = pool->config.min_threads;
+    }
+    assert(pool->config.low_water < pool->config.high_water && pool->config.high_water <= 100);
+
+    pool->threads = malloc(pool->config.max_threads * sizeof(pthread_t));
+    if (pool->threads == NULL) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    pool->worker = worker;
+    pool->args = args;
+    pool->started = 0;
+    atomic_init(&pool->stopping, 0);
+    if (pthread_mutex_init(&pool->mutex, NULL) != 0) {
+        free(pool->threads);
+        pool->threads = NULL;
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    atomic_init(&pool->high_since, 0);
+    atomic_init(&pool->low_since, 0);
+    atomic_init(&pool->grown, 0);
+    atomic_init(&pool->shrunk, 0);
+    atomic_init(&pool->unparked.seq, 0);
+    atomic_init(&pool->unparked.waiters, 0);
+    pool->unparked.process_shared = 0;
+
+    atomic_init(&pool->active, pool->config.min_threads);
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->started < pool->config.min_threads) {
+        if (start_worker(pool) != SUCCESS) {
+            pthread_mutex_unlock(&pool->mutex);
+            abandon_start(pool);
+            return RINGBUFFER_ALLOC_FAILED;
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return SUCCESS;
+}
+
+typedef struct {
+    rbpool_t *pool;
+    int index;
+} park_args_t;
+
+static int try_unpark(void *arg)
+{
+    park_args_t *args = arg;
+    if (args->index < atomic_load_explicit(&args->pool->active, memory_order_acquire) ||
+        atomic_load_explicit(&args->pool->stopping, memory_order_relaxed)) {
+        return SUCCESS;
+    }
+    return RINGBUFFER_EMPTY;
+}
+
+int pool_park(rbpool_t *pool, int index, const struct timespec *deadline)
+{
+    park_args_t args = {pool, index};
+    return ringbuffer_signal_wait(&pool->unparked, RINGBUFFER_EMPTY, deadline, try_unpark, &args);
+}
+
+/* track how long a condition has held, returns true once it held for duration_ns */
+static int held_for(_Atomic uint64_t *since, int condition, long duration_ns)
+{
+    if (!condition) {
+        if (atomic_load_explicit(since, memory_order_relaxed) != 0) {
+            atomic_store_explicit(since, 0, memory_order_relaxed);
+        }
+        return 0;
+    }
+
+    uint64_t now = ringbuffer_now_ns();
+    uint64_t start = 0;
+    if (atomic_compare_exchange_strong_explicit(since, &start, now, memory_order_relaxed, memory_order_relaxed)) {
+        return duration_ns <= 0;
+    }
+    return now - start >= (uint64_t) duration_ns;
+}
+
+void pool_observe(rbpool_t *pool, unsigned int occupancy)
+{
+    if (pool->config.min_threads == pool->config.max_threads) {
+        return;
+    }
+
+    int active = atomic_load_explicit(&pool->active, memory_order_relaxed);
+    int grow = held_for(&pool->high_since, occupancy >= pool->config.high_water, pool->config.scale_after_ns) &&
+               active < pool->config.max_threads;
+    int shrink = held_for(&pool->low_since, occupancy <= pool->config.low_water, pool->config.scale_after_ns) &&
+                 active > pool->config.min_threads;
+    if (!grow && !shrink) {
+        return;
+    }
+
+    // one step at a time, each step needs the condition to hold for a whole period again
+    pthread_mutex_lock(&pool->mutex);
+    active = atomic_load_explicit(&pool->active, memory_order_relaxed);
+    if (grow && active < pool->config.max_threads &&
+        !atomic_load_explicit(&pool->stopping, memory_order_relaxed)) {
+        if (active == pool->started && start_worker(pool) != SUCCESS) {
+            pthread_mutex_unlock(&pool->mutex);
+            return;
+        }
+        atomic_store_explicit(&pool->active, active + 1, memory_order_release);
+        atomic_store_explicit(&pool->high_since, 0, memory_order_relaxed);
+        atomic_fetch_add_explicit(&pool->grown, 1, memory_order_relaxed);
+        ringbuffer_signal_wake(&pool->unparked);
+    } else if (shrink && active > pool->config.min_threads) {
+        // the last worker parks the next time it checks
+        atomic_store_explicit(&pool->active, active - 1, memory_order_release);
+        atomic_store_explicit(&pool->low_since, 0, memory_order_relaxed);
+        atomic_fetch_add_explicit(&pool->shrunk, 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int pool_active(rbpool_t *pool)
+{
+    return atomic_load_explicit(&pool->active, memory_order_relaxed);
+}
+
+int pool_stop(rbpool_t *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    atomic_store_explicit(&pool->stopping, 1, memory_order_relaxed);
+    int started = pool->started;
+    pthread_mutex_unlock(&pool->mutex);
+    ringbuffer_signal_wake(&pool->unparked);
+    return started;
+}
+
+void pool_destroy(rbpool_t *pool)
+{
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    pool->threads = NULL;
+}
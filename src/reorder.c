@@ -0,0 +1,189 @@
+#define _GNU_SOURCE
+#include "../include/reorder.h"
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define SLOT_EMPTY 0
+#define SLOT_RECORD 1
+#define SLOT_NO_RECORD 2    /* skipped by its producer, nothing to deliver */
+
+int reorder_init(rbreorder_t *window, size_t window_size, size_t max_len, int policy,
+                 long gap_timeout_ns, rbreorder_sink_t sink, void *sink_arg)
+{
+    size_t size = 1;
+    while (size < window_size) {
+        size <<= 1;
+    }
+    window->slots = calloc(size, sizeof(rbreorder_slot_t));
+    window->data = malloc(size * max_len);
+    if (window->slots == NULL || window->data == NULL) {
+        free(window->slots);
+        free(window->data);
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+
+    pthread_mutex_init(&window->mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&window->advanced, &attr);
+    pthread_condattr_destroy(&attr);
+
+    window->base = 0;
+    window->end = 0;
+    window->pending = 0;
+    window->mask = size - 1;
+    window->max_len = max_len;
+    window->releasing = 0;
+    window->policy = policy;
+    window->gap_timeout_ns = gap_timeout_ns;
+    window->gap_since = 0;
+    window->sink = sink;
+    window->sink_arg = sink_arg;
+    window->released = 0;
+    window->skipped = 0;
+    window->late = 0;
+    return SUCCESS;
+}
+
+static int gap_expired(rbreorder_t *window)
+{
+    return window->policy == RBUF_REORDER_SKIP_AFTER && window->gap_since != 0 &&
+           ringbuffer_now_ns() - window->gap_since >= (uint64_t) window->gap_timeout_ns;
+}
+
+/* deliver the run at base, first skipping missing ids below skip_to. the caller holds the mutex,
+ * which is dropped around the sink calls. only one thread delivers at a time */
+static void release(rbreorder_t *window, uint64_t skip_to)
+{
+    if (window->releasing) {
+        return;
+    }
+    window->releasing = 1;
+    uint64_t start = window->base;
+
+    for (;;) {
+        rbreorder_slot_t *slot = &window->slots[window->base & window->mask];
+        if (slot->state == SLOT_EMPTY) {
+            if (window->base >= skip_to) {
+                break;
+            }
+            // nothing is held before skip_to once pending is 0, so the rest is skipped at once
+            uint64_t skip = window->pending == 0 ? skip_to - window->base : 1;
+            window->skipped += skip;
+            window->base += skip;
+            continue;
+        }
+        if (slot->state == SLOT_RECORD) {
+            const uint8_t *data = window->data + (window->base & window->mask) * window->max_len;
+            pthread_mutex_unlock(&window->mutex);
+            window->sink(window->sink_arg, window->base, data, slot->len);
+            pthread_mutex_lock(&window->mutex);
+            window->released++;
+        }
+        slot->state = SLOT_EMPTY;
+        window->pending--;
+        window->base++;
+    }
+
+    // a gap starts when records wait behind an empty base, its clock restarts when base moves
+    if (window->base != start || window->pending == 0) {
+        window->gap_since = 0;
+    }
+    if (window->pending > 0 && window->gap_since == 0) {
+        window->gap_since = ringbuffer_now_ns();
+    }
+    window->releasing = 0;
+    if (window->base != start) {
+        pthread_cond_broadcast(&window->advanced);
+    }
+}
+
+/* sleep until base moves, or until the gap times out */
+static void wait_advance(rbreorder_t *window)
+{
+    if (window->policy != RBUF_REORDER_SKIP_AFTER) {
+        pthread_cond_wait(&window->advanced, &window->mutex);
+        return;
+    }
+    uint64_t since = window->gap_since != 0 ? window->gap_since : ringbuffer_now_ns();
+    uint64_t deadline_ns = since + (uint64_t) window->gap_timeout_ns;
+    struct timespec deadline = {.tv_sec = deadline_ns / 1000000000ull, .tv_nsec = deadline_ns % 1000000000ull};
+    pthread_cond_timedwait(&window->advanced, &window->mutex, &deadline);
+}
+
+static int put(rbreorder_t *window, uint64_t id, const void *data, size_t len, int state)
+{
+    assert(len <= window->max_len);
+    pthread_mutex_lock(&window->mutex);
+
+    while (id >= window->base && id - window->base > window->mask) {
+        if (window->policy == RBUF_REORDER_SKIP_FULL && !window->releasing) {
+            // make room by giving up on whatever is missing below the window id needs
+            release(window, id - window->mask);
+        } else if (gap_expired(window) && !window->releasing) {
+            release(window, window->end);
+        } else {
+            wait_advance(window);
+        }
+    }
+    if (id < window->base) {
+        window->late++;
+        pthread_mutex_unlock(&window->mutex);
+        return REORDER_LATE;
+    }
+
+    rbreorder_slot_t *slot = &window->slots[id & window->mask];
+    assert(slot->state == SLOT_EMPTY);
+    if (state == SLOT_RECORD) {
+        memcpy(window->data + (id & window->mask) * window->max_len, data, len);
+    }
+    slot->len = len;
+    slot->state = state;
+    window->pending++;
+    if (id >= window->end) {
+        window->end = id + 1;
+    }
+
+    release(window, gap_expired(window) ? window->end : 0);
+    pthread_mutex_unlock(&window->mutex);
+    return SUCCESS;
+}
+
+int reorder_insert(rbreorder_t *window, uint64_t id, const void *data, size_t len)
+{
+    return put(window, id, data, len, SLOT_RECORD);
+}
+
+int reorder_skip(rbreorder_t *window, uint64_t id)
+{
+    return put(window, id, NULL, 0, SLOT_NO_RECORD);
+}
+
+void reorder_poll(rbreorder_t *window)
+{
+    pthread_mutex_lock(&window->mutex);
+    if (gap_expired(window)) {
+        release(window, window->end);
+    }
+    pthread_mutex_unlock(&window->mutex);
+}
+
+void reorder_flush(rbreorder_t *window)
+{
+    pthread_mutex_lock(&window->mutex);
+    while (window->releasing) {
+        pthread_cond_wait(&window->advanced, &window->mutex);
+    }
+    release(window, window->end);
+    pthread_mutex_unlock(&window->mutex);
+}
+
+void reorder_destroy(rbreorder_t *window)
+{
+    pthread_mutex_destroy(&window->mutex);
+    pthread_cond_destroy(&window->advanced);
+    free(window->slots);
+    free(window->data);
+}
@@ -1,167 +1,1724 @@
+#define _GNU_SOURCE
 #include "../include/ringbuf.h"
-#include <stdio.h>
+#include "../include/trace.h"
+#include "../include/slotring.h"
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <limits.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#endif
+
+/* RBUF_FRAME_FIXED: every record starts with a 64 bit header, the message length in the low half,
+ * bytes of unused reservation after the message in the high half */
+#define HEADER_SIZE sizeof(uint64_t)
+#define HEADER_LEN_MASK 0xffffffffu
+#define HEADER_CANCELLED HEADER_LEN_MASK  /* reservation given back, skipped by readers */
+
+/* RBUF_FRAME_VARINT: the header is a varint of message_len * 4 + kind. Its width is fixed when the
+ * record is reserved, a shorter commit is written as a non-minimal varint of the same width */
+#define VARINT_MAX_SIZE 10
+#define KIND_PLAIN 0            /* record ends right after the message */
+#define KIND_PADDED 1           /* a varint after the message tells how many unused bytes follow it (itself included) */
+#define KIND_CANCELLED 2        /* the "message length" counts bytes to skip */
+
+/* RBUF_MPMC: every record starts with a commit word, its frame follows. Records start on 8 bytes, so the
+ * low bits of a position are free and the word holds the record's own position with its state.
+ * The position tells a record of this lap from anything an older lap left, and a released record is
+ * cleared before its space is reused, so a word that isn't one of these is a record still being written */
+#define COMMIT_SIZE sizeof(uint64_t)
+#define COMMIT_WRITTEN 1        /* committed, write_tail can be moved over it */
+#define COMMIT_RELEASED 2       /* consumed, read_tail can be moved over it */
+#define COMMIT_CLEARING 3       /* a thread clears it and moves read_tail over it */
+
+/* a decoded record */
+typedef struct {
+    size_t header_len;
+    size_t message_len;
+    size_t record_len;
+    int cancelled;
+} frame_t;
 
 void ringbuffer_init(rbctx_t *context, void *buffer_location, size_t buffer_size)
+{
+    ringbuffer_init_flags(context, buffer_location, buffer_size, RBUF_LOCKED);
+}
+
+/* the process local part of a context: where the ring is and how it is used */
+static void init_view(rbctx_t *context, void *buffer_location, size_t buffer_size, int flags)
 {
     pthread_mutex_init(&(context->mutex_read), NULL);
     pthread_mutex_init(&(context->mutex_write), NULL);
-    pthread_cond_init(&(context->signal_read), NULL);
-    pthread_cond_init(&(context->signal_write), NULL);
 
     context->begin = buffer_location;
-    context->end = buffer_location + buffer_size;
-    context->read = context->begin;
-    context->write = context->begin;
+    // records start on cache lines or, for the commit words of RBUF_MPMC, on 8 bytes.
+    // then the ring has to start on such a boundary and hold whole units
+    size_t alignment = flags & RBUF_FRAME_ALIGNED ? RBUF_CACHE_LINE : (flags & RBUF_MPMC) ? COMMIT_SIZE : 1;
+    if (alignment > 1) {
+        uintptr_t misalignment = (uintptr_t) context->begin % alignment;
+        if (misalignment != 0) {
+            context->begin += alignment - misalignment;
+            buffer_size = buffer_size > alignment - misalignment ? buffer_size - (alignment - misalignment) : 0;
+        }
+        buffer_size -= buffer_size % alignment;
+    }
+    context->end = context->begin + buffer_size;
+    context->size = buffer_size;
+    if (flags & RBUF_MIRRORED) {
+        // the mirror makes the memory readable past the ring's end, so no copy ever has to split
+        context->end += buffer_size;
+    }
+    context->flags = flags;
+    context->slots = NULL;
+    context->notify_read = NULL;
+    context->event_fds[RBUF_EVENT_READABLE] = -1;
+    context->event_fds[RBUF_EVENT_WRITABLE] = -1;
+    atomic_init(&context->writer_full, 0);
+    context->mapping = NULL;
+    context->mapping_len = 0;
+    memset(&context->stats_write, 0, sizeof(context->stats_write));
+    memset(&context->stats_read, 0, sizeof(context->stats_read));
+    memset(&context->stats_base, 0, sizeof(context->stats_base));
 }
 
-void write_to_buffer(rbctx_t *context, void *message, size_t message_len)
+static void init_signal(rbsignal_t *signal, int process_shared)
 {
-    size_t space_till_end = context->end - context->write;
+    atomic_init(&signal->seq, 0);
+    atomic_init(&signal->waiters, 0);
+    signal->process_shared = process_shared;
+}
 
-    if(space_till_end < message_len) {
-        size_t first_chunk_len = space_till_end;
-        size_t second_chunk_len = message_len - first_chunk_len;
+static void init_state(rbstate_t *state, int process_shared)
+{
+    atomic_init(&state->write_head.pos, 0);
+    atomic_init(&state->write_tail.pos, 0);
+    atomic_init(&state->read_head.pos, 0);
+    atomic_init(&state->read_tail.pos, 0);
+    atomic_init(&state->missed.pos, 0);
+    init_signal(&state->signal_read, process_shared);
+    init_signal(&state->signal_write, process_shared);
+}
+
+/* zero len bytes of ring memory starting at position */
+static void clear_buffer(rbctx_t *context, uint64_t position, size_t len)
+{
+    uint8_t *start = context->begin + position % context->size;
+    size_t space_till_end = context->begin + context->size - start;
+
+    if (space_till_end < len) {
+        memset(start, 0, space_till_end);
+        memset(context->begin, 0, len - space_till_end);
+    } else {
+        memset(start, 0, len);
+    }
+}
+
+/* RBUF_MPMC: free memory has to be zero, a commit word in it must not look like a finished record */
+static inline int clears_free_memory(rbctx_t *context)
+{
+    return (context->flags & (RBUF_MPMC | RBUF_SLOTS)) == RBUF_MPMC;
+}
+
+void ringbuffer_init_flags(rbctx_t *context, void *buffer_location, size_t buffer_size, int flags)
+{
+    ringbuffer_init_resume(context, buffer_location, buffer_size, flags, 0, 0);
+}
+
+void ringbuffer_init_resume(rbctx_t *context, void *buffer_location, size_t buffer_size, int flags,
+                            uint64_t released, uint64_t committed)
+{
+    // dropping records moves the read side, which SPSC readers don't expect
+    assert(!(flags & RBUF_OVERWRITE) || !(flags & (RBUF_SPSC | RBUF_SLOTS)));
+    init_view(context, buffer_location, buffer_size, flags);
+    context->state = &context->local_state;
+    init_state(context->state, 0);
+    assert(committed - released <= context->size);
+
+    atomic_store_explicit(&context->state->write_head.pos, committed, memory_order_relaxed);
+    atomic_store_explicit(&context->state->write_tail.pos, committed, memory_order_relaxed);
+    atomic_store_explicit(&context->state->read_head.pos, released, memory_order_relaxed);
+    atomic_store_explicit(&context->state->read_tail.pos, released, memory_order_relaxed);
+    // memory the ring mapped itself is zero already
+    if (clears_free_memory(context) && !(flags & (RBUF_OWNED | RBUF_MIRRORED)) && context->size > 0) {
+        clear_buffer(context, committed, context->size - (size_t) (committed - released));
+    }
+}
+
+void ringbuffer_init_slotring(rbctx_t *context, slotring_t *slots)
+{
+    // the byte counters stay unused, every operation goes to the slot ring
+    ringbuffer_init_flags(context, slots->slots, (slots->mask + 1) * slots->stride, RBUF_MPMC | RBUF_SLOTS);
+    context->slots = slots;
+}
+
+#ifdef __linux__
+static void *map_anonymous(size_t length, int extra_flags)
+{
+    void *memory = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+#endif
+
+int ringbuffer_create(rbctx_t *context, size_t buffer_size, int flags)
+{
+#ifdef __linux__
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    size_t length = 0;
+    uint8_t *memory = NULL;
+
+    if (flags & RBUF_HUGE_PAGES) {
+        // explicit huge pages need a configured pool (vm.nr_hugepages), often there is none
+        length = (buffer_size + RBUF_HUGE_PAGE_SIZE - 1) / RBUF_HUGE_PAGE_SIZE * RBUF_HUGE_PAGE_SIZE;
+        memory = map_anonymous(length, MAP_HUGETLB);
+    }
+    if (memory == NULL) {
+        length = (buffer_size + page_size - 1) / page_size * page_size;
+        memory = map_anonymous(length, 0);
+        if (memory == NULL) {
+            return RINGBUFFER_ALLOC_FAILED;
+        }
+        if (flags & RBUF_HUGE_PAGES) {
+            madvise(memory, length, MADV_HUGEPAGE); // best effort, THP may be disabled
+        }
+    }
+
+    if (flags & RBUF_MLOCK) {
+        // locking faults every page in as well
+        if (mlock(memory, length) != 0) {
+            munmap(memory, length);
+            return RINGBUFFER_ALLOC_FAILED;
+        }
+    } else if (flags & RBUF_PREFAULT) {
+#ifdef MADV_POPULATE_WRITE
+        if (madvise(memory, length, MADV_POPULATE_WRITE) != 0)
+#endif
+        {
+            // older kernels: touch one byte per page
+            for (size_t offset = 0; offset < length; offset += page_size) {
+                ((volatile uint8_t *) memory)[offset] = 0;
+            }
+        }
+    }
+
+    ringbuffer_init_flags(context, memory, buffer_size, flags | RBUF_OWNED);
+    context->mapping = memory;
+    context->mapping_len = length;
+    return SUCCESS;
+#else
+    // no mmap, plain aligned memory without the page options
+    void *memory = aligned_alloc(RBUF_CACHE_LINE, (buffer_size + RBUF_CACHE_LINE - 1) / RBUF_CACHE_LINE * RBUF_CACHE_LINE);
+    if (memory == NULL) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    ringbuffer_init_flags(context, memory, buffer_size, flags | RBUF_OWNED);
+    context->mapping = memory;
+    return SUCCESS;
+#endif
+}
+
+void ringbuffer_free(rbctx_t *context)
+{
+    ringbuffer_destroy(context);
+    if (!(context->flags & RBUF_OWNED)) {
+        return;
+    }
+#ifdef __linux__
+    munmap(context->mapping, context->mapping_len);
+#else
+    free(context->mapping);
+#endif
+    context->mapping = NULL;
+}
+
+int ringbuffer_create_mirrored(rbctx_t *context, size_t buffer_size, int flags)
+{
+#ifdef __linux__
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    size_t size = (buffer_size + page_size - 1) / page_size * page_size;
+
+    int fd = memfd_create("ringbuffer", MFD_CLOEXEC);
+    if (fd < 0) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+
+    // reserve an address range for both copies, then map the file over each half
+    uint8_t *base = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    if (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, 2 * size);
+        close(fd);
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    close(fd);
+
+    ringbuffer_init_flags(context, base, size, flags | RBUF_MIRRORED);
+    return SUCCESS;
+#else
+    (void) context;
+    (void) buffer_size;
+    (void) flags;
+    return RINGBUFFER_ALLOC_FAILED;
+#endif
+}
+
+#ifdef __linux__
+/* map a shared ring of the given total size from fd */
+static rbshm_header_t *map_shared(int fd, size_t mapping_size)
+{
+    void *mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return mapping == MAP_FAILED ? NULL : mapping;
+}
+#endif
+
+int ringbuffer_shm_create(rbctx_t *context, const char *name, size_t buffer_size, int flags)
+{
+#ifdef __linux__
+    // the counters are the only thing shared, so only the modes without mutexes can be used
+    assert(flags & (RBUF_MPMC | RBUF_SPSC));
+    assert(!(flags & (RBUF_MIRRORED | RBUF_SLOTS)));
+    assert(!(flags & RBUF_OVERWRITE) || (flags & RBUF_MPMC));
+
+    size_t data_offset = (sizeof(rbshm_header_t) + RBUF_CACHE_LINE - 1) / RBUF_CACHE_LINE * RBUF_CACHE_LINE;
+    if (flags & RBUF_FRAME_ALIGNED) {
+        buffer_size -= buffer_size % RBUF_CACHE_LINE;
+    }
+    int fd = name != NULL ? shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600) : memfd_create("ringbuffer", MFD_CLOEXEC);
+    if (fd < 0) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    if (ftruncate(fd, data_offset + buffer_size) != 0) {
+        close(fd);
+        if (name != NULL) {
+            shm_unlink(name);
+        }
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    rbshm_header_t *header = map_shared(fd, data_offset + buffer_size);
+    if (header == NULL) {
+        if (name != NULL) {
+            shm_unlink(name);
+        }
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+
+    init_view(context, (uint8_t *) header + data_offset, buffer_size, flags | RBUF_SHARED);
+    context->state = &header->state;
+    init_state(context->state, 1);
+
+    header->version = RBUF_SHM_VERSION;
+    header->flags = (uint32_t) flags;
+    header->capacity = context->size;
+    header->data_offset = data_offset;
+    // the magic goes last, a ring is only attachable once it is complete
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, RBUF_SHM_MAGIC, sizeof(header->magic));
+    return SUCCESS;
+#else
+    (void) context;
+    (void) name;
+    (void) buffer_size;
+    (void) flags;
+    return RINGBUFFER_ALLOC_FAILED;
+#endif
+}
+
+int ringbuffer_shm_attach(rbctx_t *context, const char *name)
+{
+#ifdef __linux__
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(rbshm_header_t)) {
+        close(fd);
+        return RINGBUFFER_INCOMPATIBLE;
+    }
+    rbshm_header_t *header = map_shared(fd, st.st_size);
+    if (header == NULL) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    if (memcmp(header->magic, RBUF_SHM_MAGIC, sizeof(header->magic)) != 0 || header->version != RBUF_SHM_VERSION ||
+        header->data_offset < sizeof(rbshm_header_t) || header->data_offset + header->capacity > (size_t) st.st_size) {
+        munmap(header, st.st_size);
+        return RINGBUFFER_INCOMPATIBLE;
+    }
+
+    // the capacity is already aligned if it has to be, so init_view keeps it
+    init_view(context, (uint8_t *) header + header->data_offset, header->capacity, (int) header->flags | RBUF_SHARED);
+    context->state = &header->state;
+    return SUCCESS;
+#else
+    (void) context;
+    (void) name;
+    return RINGBUFFER_ALLOC_FAILED;
+#endif
+}
 
-        memcpy(context->write, message, first_chunk_len);
-        memcpy(context->begin, (uint8_t *)message + first_chunk_len, second_chunk_len);
+void ringbuffer_shm_unlink(const char *name)
+{
+#ifdef __linux__
+    shm_unlink(name);
+#else
+    (void) name;
+#endif
+}
 
-        context->write = context->begin + second_chunk_len;
+/* add n to a statistics counter. owned: only one thread at a time counts on it */
+static inline void count_stat(_Atomic uint64_t *counter, uint64_t n, int owned)
+{
+    if (owned) {
+        atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
     } else {
-        memcpy(context->write, message, message_len);
-        context->write += message_len;
+        atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+    }
+}
+
+/* count messages of one side. the locked mode calls this before unlocking the side */
+static inline void count_messages(rbctx_t *context, rbcounters_t *counters, uint64_t messages, uint64_t bytes,
+                                  uint64_t splits)
+{
+    int owned = !(context->flags & RBUF_MPMC);
+    count_stat(&counters->messages, messages, owned);
+    count_stat(&counters->bytes, bytes, owned);
+    if (splits > 0) {
+        count_stat(&counters->splits, splits, owned);
     }
+}
+
+/* raise the high-water mark to used bytes */
+static inline void count_occupancy(rbctx_t *context, uint64_t used)
+{
+    uint64_t high_water = atomic_load_explicit(&context->stats_write.high_water, memory_order_relaxed);
+    while (used > high_water &&
+           !atomic_compare_exchange_weak_explicit(&context->stats_write.high_water, &high_water, used,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+/* whether len bytes starting at position wrap around the end of the ring */
+static inline int wraps(rbctx_t *context, uint64_t position, size_t len)
+{
+    return (size_t) (context->end - (context->begin + position % context->size)) < len;
+}
 
-    if(context->write == context->end) {
-        context->write = context->begin;
+void write_to_buffer(rbctx_t *context, uint64_t position, const void *message, size_t message_len)
+{
+    uint8_t *write = context->begin + position % context->size;
+    size_t space_till_end = context->end - write;
+
+    if(space_till_end < message_len) {
+        size_t first_chunk_len = space_till_end;
+        size_t second_chunk_len = message_len - first_chunk_len;
+
+        memcpy(write, message, first_chunk_len);
+        memcpy(context->begin, (const uint8_t *)message + first_chunk_len, second_chunk_len);
+    } else {
+        memcpy(write, message, message_len);
     }
 }
 
-void read_from_buffer(rbctx_t *context, void *buffer, size_t message_len) {
-    if (context->read + message_len > context->end) {
+void read_from_buffer(rbctx_t *context, uint64_t position, void *buffer, size_t message_len) {
+    uint8_t *read = context->begin + position % context->size;
+
+    if (read + message_len > context->end) {
         // need to read by parts,
-        size_t first_chunk_len = context->end - context->read;
+        size_t first_chunk_len = context->end - read;
         size_t second_chunk_len = message_len - first_chunk_len;
 
-        memcpy(buffer, context->read, first_chunk_len );
+        memcpy(buffer, read, first_chunk_len );
         memcpy((uint8_t *)buffer + first_chunk_len, context->begin, second_chunk_len);
-        context->read = context->begin + second_chunk_len;
     } else {
-        memcpy(buffer, context->read, message_len);
-        context->read += message_len;
+        memcpy(buffer, read, message_len);
+    }
+}
+
+static inline size_t varint_size(uint64_t value)
+{
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+/* encode value into exactly width bytes, the width has to be at least varint_size(value) */
+static void varint_encode(uint64_t value, uint8_t *out, size_t width)
+{
+    for (size_t i = 0; i < width; i++) {
+        out[i] = (value & 0x7f) | (i + 1 < width ? 0x80 : 0);
+        value >>= 7;
+    }
+}
+
+/* decode a varint from ring memory. it is read byte by byte, the bytes after it may belong
+ * to a record a writer is filling right now */
+static size_t read_varint(rbctx_t *context, uint64_t position, uint64_t *value)
+{
+    size_t i = 0;
+    uint8_t byte;
+    *value = 0;
+    do {
+        read_from_buffer(context, position + i, &byte, 1);
+        *value |= (uint64_t) (byte & 0x7f) << (7 * i);
+        i++;
+    } while ((byte & 0x80) && i < VARINT_MAX_SIZE);
+    return i;
+}
+
+static inline size_t align_record(rbctx_t *context, size_t record_len)
+{
+    if (context->flags & RBUF_FRAME_ALIGNED) {
+        return (record_len + RBUF_CACHE_LINE - 1) & ~(size_t) (RBUF_CACHE_LINE - 1);
+    }
+    if (context->flags & RBUF_MPMC) {
+        return (record_len + COMMIT_SIZE - 1) & ~(size_t) (COMMIT_SIZE - 1);
+    }
+    return record_len;
+}
+
+/* bytes in front of the frame header, the commit word of RBUF_MPMC */
+static inline size_t commit_size(rbctx_t *context)
+{
+    return context->flags & RBUF_MPMC ? COMMIT_SIZE : 0;
+}
+
+/* bytes a record for message_len takes in the ring, and how many of them are header, commit word included */
+static size_t frame_size(rbctx_t *context, size_t message_len, size_t *header_len)
+{
+    size_t commit = commit_size(context);
+    if (!(context->flags & RBUF_FRAME_VARINT)) {
+        *header_len = commit + HEADER_SIZE;
+        return align_record(context, commit + HEADER_SIZE + message_len);
+    }
+
+    // the header has to hold any kind with any length up to the whole record
+    size_t width = 1, record_len;
+    for (;;) {
+        record_len = align_record(context, commit + width + message_len);
+        size_t needed = varint_size((uint64_t) (record_len - commit) * 4 + KIND_CANCELLED);
+        if (needed <= width) {
+            break;
+        }
+        width = needed;
+    }
+    *header_len = commit + width;
+    return record_len;
+}
+
+static void read_frame(rbctx_t *context, uint64_t position, frame_t *frame)
+{
+    size_t commit = commit_size(context);
+    if (!(context->flags & RBUF_FRAME_VARINT)) {
+        uint64_t header;
+        read_from_buffer(context, position + commit, &header, HEADER_SIZE);
+        frame->header_len = commit + HEADER_SIZE;
+        frame->message_len = header & HEADER_LEN_MASK;
+        frame->cancelled = frame->message_len == HEADER_CANCELLED;
+        if (frame->cancelled) {
+            frame->message_len = 0;
+        }
+        frame->record_len = commit + HEADER_SIZE + frame->message_len + (header >> 32);
+        return;
+    }
+
+    uint64_t value, padding = 0;
+    frame->header_len = commit + read_varint(context, position + commit, &value);
+    frame->message_len = value >> 2;
+    frame->cancelled = (value & 3) == KIND_CANCELLED;
+    if ((value & 3) == KIND_PADDED) {
+        read_varint(context, position + frame->header_len + frame->message_len, &padding);
+    }
+    frame->record_len = frame->header_len + frame->message_len + padding;
+    if (frame->cancelled) {
+        frame->message_len = 0;
+    }
+}
+
+/* write the header of a reserved record, and the padding length if the message doesn't fill it.
+ * the commit word of RBUF_MPMC is left alone, publish_write sets it */
+static void write_frame(rbctx_t *context, uint64_t position, size_t header_len, size_t record_len,
+                        size_t message_len, int cancelled)
+{
+    size_t padding = record_len - header_len - message_len;
+    size_t commit = commit_size(context);
+
+    if (!(context->flags & RBUF_FRAME_VARINT)) {
+        uint64_t header = (cancelled ? HEADER_CANCELLED : (uint64_t) message_len) | ((uint64_t) padding << 32);
+        write_to_buffer(context, position + commit, &header, HEADER_SIZE);
+        return;
+    }
+
+    uint8_t bytes[VARINT_MAX_SIZE];
+    uint64_t value;
+    if (cancelled) {
+        value = (uint64_t) (record_len - header_len) * 4 + KIND_CANCELLED;
+    } else if (padding > 0) {
+        // the padding holds its own length, a varint of n is never longer than n bytes
+        value = (uint64_t) message_len * 4 + KIND_PADDED;
+        size_t padding_width = varint_size(padding);
+        varint_encode(padding, bytes, padding_width);
+        write_to_buffer(context, position + header_len + message_len, bytes, padding_width);
+    } else {
+        value = (uint64_t) message_len * 4 + KIND_PLAIN;
     }
+    varint_encode(value, bytes, header_len - commit);
+    write_to_buffer(context, position + commit, bytes, header_len - commit);
+}
+
+/* point the span at message_len bytes of ring memory starting at position */
+static void fill_span(rbctx_t *context, rbspan_t *span, uint64_t position, size_t message_len)
+{
+    uint8_t *start = context->begin + position % context->size;
+    size_t space_till_end = context->end - start;
 
-    if(context->read == context->end) {
-        context->read = context->begin;
+    span->data[0] = start;
+    if (space_till_end < message_len) {
+        span->len[0] = space_till_end;
+        span->data[1] = context->begin;
+        span->len[1] = message_len - space_till_end;
+    } else {
+        span->len[0] = message_len;
+        span->data[1] = NULL;
+        span->len[1] = 0;
     }
 }
 
 size_t get_available_size(rbctx_t *context) {
-    size_t available_size = context->read - context->write -1;
+    if (context->flags & RBUF_SLOTS) {
+        uint64_t dequeue = atomic_load_explicit(&context->slots->dequeue_pos.pos, memory_order_acquire);
+        uint64_t enqueue = atomic_load_explicit(&context->slots->enqueue_pos.pos, memory_order_relaxed);
+        return (size_t) (context->slots->mask + 1 - (enqueue - dequeue)) * context->slots->slot_size;
+    }
+    // read_tail is loaded first, so write_head can never be behind it. it can be more than a ring ahead
+    // if readers gave space back and writers took it again between the loads, then load again
+    uint64_t read_tail, write_head;
+    do {
+        read_tail = atomic_load_explicit(&context->state->read_tail.pos, memory_order_acquire);
+        write_head = atomic_load_explicit(&context->state->write_head.pos, memory_order_relaxed);
+    } while (write_head - read_tail > context->size);
+
+    return context->size - (size_t)(write_head - read_tail);
+}
+
+size_t ringbuffer_available(rbctx_t *context)
+{
+    return get_available_size(context);
+}
 
-    if(context->read  <= context->write) {
-        available_size = context->read - context->write + context->end - context->begin;
+/* bytes in use, counted the way the high-water mark counts them */
+static size_t used_size(rbctx_t *context)
+{
+    if (context->flags & RBUF_SLOTS) {
+        return (context->slots->mask + 1) * context->slots->slot_size - get_available_size(context);
     }
+    return context->size - get_available_size(context);
+}
 
-    return available_size;
+unsigned int ringbuffer_occupancy(rbctx_t *context)
+{
+    size_t capacity = context->flags & RBUF_SLOTS ? (context->slots->mask + 1) * context->slots->slot_size : context->size;
+    return capacity > 0 ? (unsigned int) (used_size(context) * 100 / capacity) : 0;
 }
-int ringbuffer_write(rbctx_t *context, void *message, size_t message_len)
+
+void ringbuffer_get_stats(rbctx_t *context, rbstats_t *stats)
+{
+    const rbstats_t *base = &context->stats_base;
+    rbcounters_t *in = &context->stats_write, *out = &context->stats_read;
+
+    stats->messages_in = atomic_load_explicit(&in->messages, memory_order_relaxed) - base->messages_in;
+    stats->bytes_in = atomic_load_explicit(&in->bytes, memory_order_relaxed) - base->bytes_in;
+    stats->messages_out = atomic_load_explicit(&out->messages, memory_order_relaxed) - base->messages_out;
+    stats->bytes_out = atomic_load_explicit(&out->bytes, memory_order_relaxed) - base->bytes_out;
+    stats->full = atomic_load_explicit(&in->refused, memory_order_relaxed) - base->full;
+    stats->empty = atomic_load_explicit(&out->refused, memory_order_relaxed) - base->empty;
+    stats->write_wait_ns = atomic_load_explicit(&in->wait_ns, memory_order_relaxed) - base->write_wait_ns;
+    stats->read_wait_ns = atomic_load_explicit(&out->wait_ns, memory_order_relaxed) - base->read_wait_ns;
+    stats->write_splits = atomic_load_explicit(&in->splits, memory_order_relaxed) - base->write_splits;
+    stats->read_splits = atomic_load_explicit(&out->splits, memory_order_relaxed) - base->read_splits;
+    stats->evicted = atomic_load_explicit(&in->evicted, memory_order_relaxed) - base->evicted;
+    stats->occupancy = used_size(context);
+    stats->high_water = atomic_load_explicit(&in->high_water, memory_order_relaxed);
+    if (stats->high_water < stats->occupancy) {
+        stats->high_water = stats->occupancy;
+    }
+}
+
+void ringbuffer_reset_stats(rbctx_t *context)
+{
+    // the counters only ever grow and belong to their side, a window is their difference to a base
+    rbstats_t now;
+    atomic_store_explicit(&context->stats_write.high_water, 0, memory_order_relaxed);
+    memset(&context->stats_base, 0, sizeof(context->stats_base));
+    ringbuffer_get_stats(context, &now);
+    context->stats_base = now;
+    count_occupancy(context, now.occupancy);
+}
+
+uint64_t ringbuffer_missed(rbctx_t *context)
 {
-    pthread_mutex_lock(&(context->mutex_write));
+    return atomic_exchange_explicit(&context->state->missed.pos, 0, memory_order_relaxed);
+}
 
-    printf("Write: Begin\n");
-    struct timespec timeout;
-    clock_gettime(CLOCK_REALTIME, &timeout);
-    timeout.tv_sec = 0;
-    timeout.tv_nsec = 100000000; // 0.1 second timeout
+/* RBUF_MPMC: the commit word of the record at position */
+static inline _Atomic uint64_t *commit_word(rbctx_t *context, uint64_t position)
+{
+    return (_Atomic uint64_t *) (context->begin + position % context->size);
+}
 
-    size_t available_size = get_available_size(context);
-    printf("Write: available_size %lu\n", available_size);
+/* RBUF_MPMC: move write_tail over the committed records it points to, returns where it was if it moved.
+ * nobody waits for the record at write_tail: its writer finds write_tail there after marking it, or the
+ * thread that moves write_tail up to it finds it marked. the seq_cst accesses make sure one of them does.
+ * a stale write_tail may see records of a later lap, their position doesn't match and the CAS fails */
+static int advance_written(rbctx_t *context, uint64_t *moved_from)
+{
+    rbstate_t *state = context->state;
+    uint64_t tail = atomic_load_explicit(&state->write_tail.pos, memory_order_seq_cst);
+    int moved = 0;
+    frame_t frame;
 
-    if (available_size < message_len + sizeof(size_t)) {
-        printf("Write: Full, wait for write signal, send read signal, available (%lu), msg (%lu)\n", available_size, message_len);
-        int wait_result = pthread_cond_timedwait(&(context->signal_write), &(context->mutex_write), &timeout);
-        if(wait_result == ETIMEDOUT) {
-            printf("Write: Full, wait timeout, continue\n");
-        }else {
-            printf("Write: Full, signal received, continue\n");
+    for (;;) {
+        uint64_t head = atomic_load_explicit(&state->write_head.pos, memory_order_acquire);
+        uint64_t end = tail;
+        // a whole run at once, a batch marks its first record last and becomes visible in one step
+        while (end != head && atomic_load_explicit(commit_word(context, end), memory_order_seq_cst) == (end | COMMIT_WRITTEN)) {
+            read_frame(context, end, &frame);
+            if (frame.record_len == 0 || frame.record_len > head - end) {
+                break;
+            }
+            end += frame.record_len;
+        }
+        if (end == tail) {
+            return moved;
+        }
+        if (atomic_compare_exchange_strong_explicit(&state->write_tail.pos, &tail, end,
+                                                    memory_order_seq_cst, memory_order_seq_cst)) {
+            if (!moved) {
+                *moved_from = tail;
+                moved = 1;
+            }
+            tail = end;
         }
-        pthread_mutex_unlock(&(context->mutex_write));
-        return RINGBUFFER_FULL;
     }
+}
 
-    write_to_buffer(context, &message_len, sizeof(size_t));
-    write_to_buffer(context, message, message_len);
-
-    printf("Write: finished, available size : %lu\n", get_available_size(context));
-    pthread_mutex_unlock(&(context->mutex_write));
-    pthread_cond_signal(&(context->signal_write));
-    // pthread_cond_signal(&(context->signal_read));
-    // pthread_cond_signal(&(context->signal_read));
+/* RBUF_MPMC: clear the released records read_tail points to and move read_tail over them, returns if it moved.
+ * the thread that turns a commit word from released to clearing owns the record, nobody else can move
+ * read_tail past it. like advance_written, a release finds read_tail at its record or the thread moving
+ * read_tail there finds the release */
+static int reclaim_released(rbctx_t *context)
+{
+    rbstate_t *state = context->state;
+    uint64_t tail = atomic_load_explicit(&state->read_tail.pos, memory_order_seq_cst);
+    int moved = 0;
+    frame_t frame;
 
-    return SUCCESS;
+    for (;;) {
+        uint64_t released = tail | COMMIT_RELEASED;
+        // a stale tail points into a later lap, look before writing there
+        if (atomic_load_explicit(commit_word(context, tail), memory_order_relaxed) != released ||
+            !atomic_compare_exchange_strong_explicit(commit_word(context, tail), &released, tail | COMMIT_CLEARING,
+                                                     memory_order_seq_cst, memory_order_relaxed)) {
+            return moved;
+        }
+        // the next lap's records start from zero memory, its commit words can't be taken for finished ones
+        read_frame(context, tail, &frame);
+        clear_buffer(context, tail + COMMIT_SIZE, frame.record_len - COMMIT_SIZE);
+        atomic_store_explicit(commit_word(context, tail), 0, memory_order_relaxed);
+        tail += frame.record_len;
+        atomic_store_explicit(&state->read_tail.pos, tail, memory_order_seq_cst);
+        moved = 1;
+    }
 }
 
-int ringbuffer_read(rbctx_t *context, void *buffer, size_t *buffer_len)
+/* RBUF_MPMC: mark the claimed records in [position, end) as consumed and give back what can be given back.
+ * each one's length is read before it is marked, a marked record may be cleared right away */
+static int release_records(rbctx_t *context, uint64_t position, uint64_t end)
 {
-    pthread_mutex_lock(&(context->mutex_read));
+    frame_t frame;
 
-    printf("Read: begin\n");
-    struct timespec timeout;
-    clock_gettime(CLOCK_REALTIME, &timeout);
-    timeout.tv_sec = 0;
-    timeout.tv_nsec = 100000000; // 0.1 second timeout
+    while (position != end) {
+        read_frame(context, position, &frame);
+        atomic_store_explicit(commit_word(context, position), position | COMMIT_RELEASED, memory_order_seq_cst);
+        position += frame.record_len;
+    }
+    return reclaim_released(context);
+}
 
+/* RBUF_OVERWRITE: drop the oldest committed record, claiming it the way a reader would.
+ * a record a reader is still busy with can't be dropped, nor anything behind it, as the
+ * space is only given back in order. rather than wait for that reader, give up */
+static int evict_oldest(rbctx_t *context)
+{
+    rbstate_t *state = context->state;
+    frame_t frame;
 
-    size_t message_len;
+    for (;;) {
+        uint64_t head = atomic_load_explicit(&state->read_head.pos, memory_order_acquire);
+        if (atomic_load_explicit(&state->read_tail.pos, memory_order_acquire) != head ||
+            atomic_load_explicit(&state->write_tail.pos, memory_order_acquire) == head) {
+            return RINGBUFFER_FULL;
+        }
 
-    if (context->write == context->read) {
-        // pthread_cond_signal(&(context->signal_write));
-        int wait_result = pthread_cond_timedwait(&(context->signal_read), &(context->mutex_read), &timeout);
-        if (wait_result == ETIMEDOUT) {
-            printf("Read: Empty, wait timeout, continue\n");
+        read_frame(context, head, &frame);
+        if (context->flags & RBUF_MPMC) {
+            // claimed with nobody in front of us, so its space comes back right away
+            if (!atomic_compare_exchange_weak_explicit(&state->read_head.pos, &head, head + frame.record_len,
+                                                       memory_order_relaxed, memory_order_relaxed)) {
+                continue;
+            }
+            release_records(context, head, head + frame.record_len);
         } else {
-            printf("Read: Empty, signal received, continue\n");
+            // the locked mode's caller holds mutex_read
+            atomic_store_explicit(&state->read_head.pos, head + frame.record_len, memory_order_relaxed);
+            atomic_store_explicit(&state->read_tail.pos, head + frame.record_len, memory_order_release);
         }
 
-        pthread_mutex_unlock(&(context->mutex_read));
-        pthread_cond_signal(&(context->signal_read));
-        return RINGBUFFER_EMPTY;
+        TRACE(TRACE_INFO, TRACE_WRITE_EVICT, head, frame.record_len);
+        if (!frame.cancelled) {
+            count_stat(&context->stats_write.evicted, 1, 0);
+            atomic_fetch_add_explicit(&state->missed.pos, 1, memory_order_relaxed);
+        }
+        return SUCCESS;
     }
+}
 
-    read_from_buffer(context, &message_len, sizeof(size_t));
-    *buffer_len = message_len;
+static int reserve_mpmc(rbctx_t *context, size_t record_len, uint64_t *position)
+{
+    uint64_t head, read_tail;
+
+    for (;;) {
+        read_tail = atomic_load_explicit(&context->state->read_tail.pos, memory_order_acquire);
+        head = atomic_load_explicit(&context->state->write_head.pos, memory_order_relaxed);
+        if (head - read_tail > context->size) {
+            // between the loads, readers gave space back and writers took it again
+            continue;
+        }
+        if (context->size - (size_t)(head - read_tail) < record_len) {
+            if ((context->flags & RBUF_OVERWRITE) && record_len <= context->size && evict_oldest(context) == SUCCESS) {
+                continue;
+            }
+            return RINGBUFFER_FULL;
+        }
+        if (atomic_compare_exchange_weak_explicit(&context->state->write_head.pos, &head, head + record_len,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    count_occupancy(context, head + record_len - read_tail);
+    *position = head;
+    return SUCCESS;
+}
+
+static void wake_writers(rbctx_t *context);
+
+/* claim the oldest record, skipping cancelled reservations.
+ * the header is only trustworthy if nobody claimed the record meanwhile, the CAS checks that */
+static int claim_mpmc(rbctx_t *context, size_t max_len, uint64_t *position, frame_t *frame)
+{
+    uint64_t head;
+
+    for (;;) {
+        head = atomic_load_explicit(&context->state->read_head.pos, memory_order_relaxed);
+        uint64_t write_tail = atomic_load_explicit(&context->state->write_tail.pos, memory_order_acquire);
+        if (head == write_tail) {
+            return RINGBUFFER_EMPTY;
+        }
+
+        read_frame(context, head, frame);
+        if (!frame->cancelled && frame->message_len > max_len) {
+            if (atomic_load_explicit(&context->state->read_head.pos, memory_order_acquire) != head) {
+                continue;
+            }
+            return OUTPUT_BUFFER_TOO_SMALL;
+        }
+
+        if (!atomic_compare_exchange_weak_explicit(&context->state->read_head.pos, &head, head + frame->record_len,
+                                                   memory_order_relaxed, memory_order_relaxed)) {
+            continue;
+        }
+        if (frame->cancelled) {
+            if (release_records(context, head, head + frame->record_len)) {
+                wake_writers(context);
+            }
+            continue;
+        }
+
+        *position = head;
+        return SUCCESS;
+    }
+}
+
+/* locked counterpart of claim_mpmc, the caller holds mutex_read */
+static int claim_locked(rbctx_t *context, size_t max_len, uint64_t *position, frame_t *frame)
+{
+    uint64_t head = atomic_load_explicit(&context->state->read_head.pos, memory_order_relaxed);
+
+    for (;;) {
+        if (atomic_load_explicit(&context->state->write_tail.pos, memory_order_acquire) == head) {
+            return RINGBUFFER_EMPTY;
+        }
 
-    if (message_len > *buffer_len) {
-        printf("READ: OUTPUT_BUFFER_TOO_SMALL, buffer_len(%lu), message_len(%lu)\n", *buffer_len, message_len);
-        context->read -= sizeof(size_t);
-        if(context->read < context->begin) {
-            context->read += context->end - context->begin;
+        read_frame(context, head, frame);
+        if (!frame->cancelled) {
+            break;
         }
-        pthread_mutex_unlock(&(context->mutex_read));
-        pthread_cond_signal(&(context->signal_read));
+        head += frame->record_len;
+        atomic_store_explicit(&context->state->read_head.pos, head, memory_order_relaxed);
+        atomic_store_explicit(&context->state->read_tail.pos, head, memory_order_release);
+    }
+
+    if (frame->message_len > max_len) {
         return OUTPUT_BUFFER_TOO_SMALL;
     }
 
-    read_from_buffer(context, buffer, message_len);
+    *position = head;
+    return SUCCESS;
+}
+
+/* the locked mode's mutexes, RBUF_SPSC rings have one thread per side and run the same code without them */
+static inline void lock_side(rbctx_t *context, pthread_mutex_t *mutex)
+{
+    if (!(context->flags & RBUF_SPSC)) {
+        pthread_mutex_lock(mutex);
+    }
+}
+
+static inline void unlock_side(rbctx_t *context, pthread_mutex_t *mutex)
+{
+    if (!(context->flags & RBUF_SPSC)) {
+        pthread_mutex_unlock(mutex);
+    }
+}
+
+/* takes mutex_write, which stays locked on success until publish_write */
+static int reserve_locked(rbctx_t *context, size_t record_len, uint64_t *position)
+{
+    lock_side(context, &context->mutex_write);
+
+    size_t available = get_available_size(context);
+    if (available < record_len && (context->flags & RBUF_OVERWRITE) && record_len <= context->size &&
+        pthread_mutex_trylock(&context->mutex_read) == 0) {
+        // a reader in the middle of a record holds mutex_read, then nothing can be dropped
+        while (available < record_len && evict_oldest(context) == SUCCESS) {
+            available = get_available_size(context);
+        }
+        pthread_mutex_unlock(&context->mutex_read);
+    }
+    if (available < record_len) {
+        unlock_side(context, &context->mutex_write);
+        return RINGBUFFER_FULL;
+    }
+    count_occupancy(context, context->size - available + record_len);
 
-    printf("Read: finished, available size: %lu \n", get_available_size(context));
-    // pthread_cond_signal(&(context->signal_read));
-    pthread_mutex_unlock(&(context->mutex_read));
-    pthread_cond_signal(&(context->signal_read));
-    // pthread_cond_signal(&(context->signal_write));
+    *position = atomic_load_explicit(&context->state->write_head.pos, memory_order_relaxed);
+    atomic_store_explicit(&context->state->write_head.pos, *position + record_len, memory_order_relaxed);
     return SUCCESS;
 }
 
-void ringbuffer_destroy(rbctx_t *context)
+static inline void signal_event(rbctx_t *context, int event)
 {
-    pthread_mutex_destroy(&(context->mutex_read));
-    pthread_mutex_destroy(&(context->mutex_write));
-    pthread_cond_destroy(&(context->signal_read));
-    pthread_cond_destroy(&(context->signal_write));
+#ifdef __linux__
+    uint64_t one = 1;
+    if (write(context->event_fds[event], &one, sizeof(one)) < 0) {
+        // the counter is already huge, the fd is readable anyway
+    }
+#else
+    (void) context;
+    (void) event;
+#endif
+}
+
+/* a writer found the ring full: with a writable event fd, ask consumers to signal it once they free space.
+ * returns if the reservation should be tried again, space freed before the request was seen didn't signal */
+static int want_writable(rbctx_t *context)
+{
+    if (context->event_fds[RBUF_EVENT_WRITABLE] < 0) {
+        return 0;
+    }
+    atomic_store_explicit(&context->writer_full, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    return 1;
+}
+
+static int try_reserve_records(rbctx_t *context, size_t record_len, uint64_t *position)
+{
+    if (context->flags & RBUF_MPMC) {
+        return reserve_mpmc(context, record_len, position);
+    }
+    return reserve_locked(context, record_len, position);
+}
+
+static int reserve_records(rbctx_t *context, size_t record_len, uint64_t *position)
+{
+    int status = try_reserve_records(context, record_len, position);
+    if (status == RINGBUFFER_FULL && want_writable(context)) {
+        status = try_reserve_records(context, record_len, position);
+    }
+
+    if (status == SUCCESS) {
+        TRACE(TRACE_DEBUG, TRACE_WRITE_RESERVE, get_available_size(context), record_len);
+    } else {
+        TRACE(TRACE_INFO, TRACE_WRITE_FULL, get_available_size(context), record_len);
+        count_stat(&context->stats_write.refused, 1, 0);
+    }
+    return status;
+}
+
+static void wake_all(rbsignal_t *signal)
+{
+    atomic_fetch_add_explicit(&signal->seq, 1, memory_order_release);
+#ifdef __linux__
+    syscall(SYS_futex, &signal->seq, signal->process_shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+/* readers only sleep on an empty ring, so only the empty -> not empty transition wakes them.
+ * if a reader already took the record at position, it is awake anyway */
+static void wake_readers(rbctx_t *context, uint64_t position)
+{
+    rbindex_t *read_head = context->flags & RBUF_SLOTS ? &context->slots->dequeue_pos : &context->state->read_head;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&read_head->pos, memory_order_relaxed) != position) {
+        return;
+    }
+    if (atomic_load_explicit(&context->state->signal_read.waiters, memory_order_relaxed) > 0) {
+        wake_all(&context->state->signal_read);
+    }
+    if (context->notify_read != NULL && atomic_load_explicit(&context->notify_read->waiters, memory_order_relaxed) > 0) {
+        wake_all(context->notify_read);
+    }
+    if (context->event_fds[RBUF_EVENT_READABLE] >= 0) {
+        signal_event(context, RBUF_EVENT_READABLE);
+    }
+}
+
+/* writers only sleep while their record doesn't fit, any freed space may be enough */
+static void wake_writers(rbctx_t *context)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&context->state->signal_write.waiters, memory_order_relaxed) > 0) {
+        wake_all(&context->state->signal_write);
+    }
+    if (context->event_fds[RBUF_EVENT_WRITABLE] >= 0 &&
+        atomic_load_explicit(&context->writer_full, memory_order_relaxed) &&
+        atomic_exchange_explicit(&context->writer_full, 0, memory_order_relaxed)) {
+        signal_event(context, RBUF_EVENT_WRITABLE);
+    }
+}
+
+/* make reserved bytes [position, position + record_len) visible to readers.
+ * RBUF_MPMC: the records after the first are marked already, the first one is marked here */
+static void publish_write(rbctx_t *context, uint64_t position, size_t record_len)
+{
+    if (context->flags & RBUF_MPMC) {
+        atomic_store_explicit(commit_word(context, position), position | COMMIT_WRITTEN, memory_order_seq_cst);
+        TRACE(TRACE_DEBUG, TRACE_WRITE_COMMIT, position, record_len);
+        // a record behind one that is still being written becomes visible when that one is committed
+        uint64_t visible_from;
+        if (advance_written(context, &visible_from)) {
+            wake_readers(context, visible_from);
+        }
+        return;
+    }
+    atomic_store_explicit(&context->state->write_tail.pos, position + record_len, memory_order_release);
+    unlock_side(context, &context->mutex_write);
+    TRACE(TRACE_DEBUG, TRACE_WRITE_COMMIT, position, record_len);
+    wake_readers(context, position);
+}
+
+/* RBUF_SLOTS: hand the slot at ticket to readers */
+static void publish_slot(rbctx_t *context, uint64_t ticket, size_t message_len)
+{
+    slotring_commit(context->slots, ticket, message_len);
+    TRACE(TRACE_DEBUG, TRACE_WRITE_COMMIT, ticket, 1);
+    wake_readers(context, ticket);
+}
+
+static int reserve_slots(rbctx_t *context, size_t count, uint64_t *ticket)
+{
+    int status = slotring_reserve(context->slots, count, ticket);
+    if (status == RINGBUFFER_FULL && want_writable(context)) {
+        status = slotring_reserve(context->slots, count, ticket);
+    }
+    if (status != SUCCESS) {
+        TRACE(TRACE_INFO, TRACE_WRITE_FULL, get_available_size(context), count);
+        count_stat(&context->stats_write.refused, 1, 0);
+        return RINGBUFFER_FULL;
+    }
+    TRACE(TRACE_DEBUG, TRACE_WRITE_RESERVE, get_available_size(context), count);
+    count_occupancy(context, used_size(context));
+    return SUCCESS;
+}
+
+/* RBUF_SLOTS: a span is one slot, its position is the slot's ticket */
+static void fill_slot_span(rbctx_t *context, rbspan_t *span, uint64_t ticket, size_t message_len)
+{
+    span->data[0] = slotring_slot(context->slots, ticket)->data;
+    span->len[0] = message_len;
+    span->data[1] = NULL;
+    span->len[1] = 0;
+    span->position = ticket;
+    span->header_len = 0;
+    span->record_len = 1;
+}
+
+int ringbuffer_reserve(rbctx_t *context, size_t message_len, rbspan_t *span)
+{
+    size_t header_len;
+    size_t record_len = frame_size(context, message_len, &header_len);
+    uint64_t position;
+
+    if (context->flags & RBUF_SLOTS) {
+        assert(message_len <= context->slots->slot_size);
+        if (reserve_slots(context, 1, &position) != SUCCESS) {
+            return RINGBUFFER_FULL;
+        }
+        fill_slot_span(context, span, position, message_len);
+        return SUCCESS;
+    }
+
+    assert(message_len < HEADER_CANCELLED);
+    if (reserve_records(context, record_len, &position) != SUCCESS) {
+        return RINGBUFFER_FULL;
+    }
+
+    span->position = position;
+    span->header_len = header_len;
+    span->record_len = record_len;
+    fill_span(context, span, position + header_len, message_len);
+    return SUCCESS;
+}
+
+void ringbuffer_commit(rbctx_t *context, rbspan_t *span, size_t message_len)
+{
+    assert(message_len <= span->len[0] + span->len[1]);
+
+    if (context->flags & RBUF_SLOTS) {
+        count_messages(context, &context->stats_write, 1, message_len, 0);
+        publish_slot(context, span->position, message_len);
+        return;
+    }
+    write_frame(context, span->position, span->header_len, span->record_len, message_len, 0);
+    count_messages(context, &context->stats_write, 1, message_len, message_len > span->len[0]);
+    publish_write(context, span->position, span->record_len);
+}
+
+void ringbuffer_cancel(rbctx_t *context, rbspan_t *span)
+{
+    if (context->flags & RBUF_SLOTS) {
+        publish_slot(context, span->position, SLOTRING_CANCELLED);
+        return;
+    }
+    write_frame(context, span->position, span->header_len, span->record_len, 0, 1);
+    publish_write(context, span->position, span->record_len);
+}
+
+static int peek_record(rbctx_t *context, rbspan_t *span, size_t max_len, size_t *message_len)
+{
+    uint64_t position;
+    frame_t frame;
+    int status;
+
+    if (context->flags & RBUF_SLOTS) {
+        status = slotring_peek(context->slots, max_len, &position, &frame.message_len);
+        if (status == SUCCESS) {
+            TRACE(TRACE_DEBUG, TRACE_READ_CLAIM, position, frame.message_len);
+            *message_len = frame.message_len;
+            fill_slot_span(context, span, position, frame.message_len);
+            return SUCCESS;
+        }
+    } else if (context->flags & RBUF_MPMC) {
+        status = claim_mpmc(context, max_len, &position, &frame);
+    } else {
+        lock_side(context, &context->mutex_read);
+        status = claim_locked(context, max_len, &position, &frame);
+        if (status != SUCCESS) {
+            unlock_side(context, &context->mutex_read);
+        }
+    }
+
+    if (status == RINGBUFFER_EMPTY) {
+        TRACE(TRACE_DEBUG, TRACE_READ_EMPTY, atomic_load_explicit(&context->state->read_head.pos, memory_order_relaxed), 0);
+        count_stat(&context->stats_read.refused, 1, 0);
+        return status;
+    }
+    *message_len = frame.message_len;
+    if (status == OUTPUT_BUFFER_TOO_SMALL) {
+        TRACE(TRACE_INFO, TRACE_READ_TOO_SMALL, max_len, *message_len);
+        return status;
+    }
+    TRACE(TRACE_DEBUG, TRACE_READ_CLAIM, position, *message_len);
+
+    span->position = position;
+    span->header_len = frame.header_len;
+    span->record_len = frame.record_len;
+    fill_span(context, span, position + frame.header_len, *message_len);
+    return SUCCESS;
+}
+
+int ringbuffer_peek(rbctx_t *context, rbspan_t *span)
+{
+    size_t message_len;
+    return peek_record(context, span, SIZE_MAX, &message_len);
+}
+
+int ringbuffer_peek_max(rbctx_t *context, rbspan_t *span, size_t max_len, size_t *message_len)
+{
+    return peek_record(context, span, max_len, message_len);
+}
+
+/* give claimed bytes [position, position + record_len) back to writers */
+static void publish_read(rbctx_t *context, uint64_t position, size_t record_len)
+{
+    uint64_t next = position + record_len;
+
+    if (context->flags & RBUF_MPMC) {
+        TRACE(TRACE_DEBUG, TRACE_READ_RELEASE, position, record_len);
+        // space behind a record still being read comes back when that one is consumed
+        if (release_records(context, position, next)) {
+            wake_writers(context);
+        }
+        return;
+    }
+    atomic_store_explicit(&context->state->read_head.pos, next, memory_order_relaxed);
+    atomic_store_explicit(&context->state->read_tail.pos, next, memory_order_release);
+    unlock_side(context, &context->mutex_read);
+    TRACE(TRACE_DEBUG, TRACE_READ_RELEASE, position, record_len);
+    wake_writers(context);
+}
+
+void ringbuffer_consume(rbctx_t *context, rbspan_t *span)
+{
+    count_messages(context, &context->stats_read, 1, span->len[0] + span->len[1], span->len[1] > 0);
+    if (context->flags & RBUF_SLOTS) {
+        slotring_consume(context->slots, span->position);
+        TRACE(TRACE_DEBUG, TRACE_READ_RELEASE, span->position, span->record_len);
+        wake_writers(context);
+        return;
+    }
+    publish_read(context, span->position, span->record_len);
+}
+
+void ringbuffer_span_slice(const rbspan_t *span, size_t offset, rbspan_t *slice)
+{
+    *slice = *span;
+    if (offset < span->len[0]) {
+        slice->data[0] += offset;
+        slice->len[0] -= offset;
+        return;
+    }
+
+    offset -= span->len[0];
+    assert(offset <= span->len[1]);
+    slice->data[0] = span->data[1] + offset;
+    slice->len[0] = span->len[1] - offset;
+    slice->data[1] = NULL;
+    slice->len[1] = 0;
+}
+
+size_t ringbuffer_span_copy_in(rbspan_t *span, size_t offset, const void *data, size_t data_len)
+{
+    const uint8_t *src = data;
+    size_t copied = 0;
+
+    for (int i = 0; i < 2 && copied < data_len; i++) {
+        if (offset >= span->len[i]) {
+            offset -= span->len[i];
+            continue;
+        }
+        size_t chunk = span->len[i] - offset;
+        if (chunk > data_len - copied) {
+            chunk = data_len - copied;
+        }
+        memcpy(span->data[i] + offset, src + copied, chunk);
+        copied += chunk;
+        offset = 0;
+    }
+    return copied;
+}
+
+size_t ringbuffer_span_copy_out(const rbspan_t *span, size_t offset, void *buffer, size_t buffer_len)
+{
+    uint8_t *dst = buffer;
+    size_t copied = 0;
+
+    for (int i = 0; i < 2 && copied < buffer_len; i++) {
+        if (offset >= span->len[i]) {
+            offset -= span->len[i];
+            continue;
+        }
+        size_t chunk = span->len[i] - offset;
+        if (chunk > buffer_len - copied) {
+            chunk = buffer_len - copied;
+        }
+        memcpy(dst + copied, span->data[i] + offset, chunk);
+        copied += chunk;
+        offset = 0;
+    }
+    return copied;
+}
+
+int ringbuffer_write(rbctx_t *context, void *message, size_t message_len)
+{
+    rbspan_t span;
+
+    int status = ringbuffer_reserve(context, message_len, &span);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    ringbuffer_span_copy_in(&span, 0, message, message_len);
+    ringbuffer_commit(context, &span, message_len);
+    return SUCCESS;
+}
+
+int ringbuffer_read(rbctx_t *context, void *buffer, size_t *buffer_len)
+{
+    rbspan_t span;
+    size_t message_len;
+
+    int status = peek_record(context, &span, *buffer_len, &message_len);
+    if (status == OUTPUT_BUFFER_TOO_SMALL) {
+        *buffer_len = message_len;
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    ringbuffer_span_copy_out(&span, 0, buffer, message_len);
+    *buffer_len = message_len;
+    ringbuffer_consume(context, &span);
+    return SUCCESS;
+}
+
+/* RBUF_SLOTS: the batch takes consecutive slots, reserved all at once */
+static int write_batch_slots(rbctx_t *context, const struct iovec *messages, size_t count)
+{
+    uint64_t ticket;
+
+    if (reserve_slots(context, count, &ticket) != SUCCESS) {
+        return RINGBUFFER_FULL;
+    }
+    // every slot has its own sequence number, readers stop at the first one not committed yet
+    size_t total_len = 0;
+    for (size_t i = 0; i < count; i++) {
+        assert(messages[i].iov_len <= context->slots->slot_size);
+        memcpy(slotring_slot(context->slots, ticket + i)->data, messages[i].iov_base, messages[i].iov_len);
+        slotring_commit(context->slots, ticket + i, messages[i].iov_len);
+        total_len += messages[i].iov_len;
+    }
+    count_messages(context, &context->stats_write, count, total_len, 0);
+    TRACE(TRACE_DEBUG, TRACE_WRITE_COMMIT, ticket, count);
+    wake_readers(context, ticket);
+    return SUCCESS;
+}
+
+/* RBUF_SLOTS: slots are claimed one by one, other readers may take slots in between */
+static int read_batch_slots(rbctx_t *context, void *buffer, size_t buffer_len,
+                            struct iovec *messages, size_t max_messages, size_t *count)
+{
+    uint8_t *out = buffer;
+    int status = RINGBUFFER_EMPTY;
+
+    while (*count < max_messages) {
+        rbspan_t span;
+        size_t message_len;
+        status = peek_record(context, &span, buffer_len - (out - (uint8_t *) buffer), &message_len);
+        if (status != SUCCESS) {
+            break;
+        }
+        memcpy(out, span.data[0], message_len);
+        ringbuffer_consume(context, &span);
+        messages[*count].iov_base = out;
+        messages[*count].iov_len = message_len;
+        (*count)++;
+        out += message_len;
+    }
+    return *count > 0 ? SUCCESS : status;
+}
+
+int ringbuffer_write_batch(rbctx_t *context, const struct iovec *messages, size_t count)
+{
+    if (context->flags & RBUF_SLOTS) {
+        return count == 0 ? SUCCESS : write_batch_slots(context, messages, count);
+    }
+
+    size_t total_len = 0, header_len;
+    for (size_t i = 0; i < count; i++) {
+        assert(messages[i].iov_len < HEADER_CANCELLED);
+        total_len += frame_size(context, messages[i].iov_len, &header_len);
+    }
+    if (count == 0) {
+        return SUCCESS;
+    }
+
+    // one reservation and one publish for the whole batch, so it becomes visible at once
+    uint64_t position;
+    if (reserve_records(context, total_len, &position) != SUCCESS) {
+        return RINGBUFFER_FULL;
+    }
+
+    uint64_t write = position;
+    size_t message_bytes = 0, splits = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t record_len = frame_size(context, messages[i].iov_len, &header_len);
+        write_frame(context, write, header_len, record_len, messages[i].iov_len, 0);
+        write_to_buffer(context, write + header_len, messages[i].iov_base, messages[i].iov_len);
+        if ((context->flags & RBUF_MPMC) && write != position) {
+            // the first record is marked last, by publish_write, then the run is complete when it is
+            atomic_store_explicit(commit_word(context, write), write | COMMIT_WRITTEN, memory_order_release);
+        }
+        message_bytes += messages[i].iov_len;
+        splits += wraps(context, write + header_len, messages[i].iov_len);
+        write += record_len;
+    }
+
+    count_messages(context, &context->stats_write, count, message_bytes, splits);
+    publish_write(context, position, total_len);
+    return SUCCESS;
+}
+
+int ringbuffer_read_batch(rbctx_t *context, void *buffer, size_t buffer_len,
+                          struct iovec *messages, size_t max_messages, size_t *count)
+{
+    int mpmc = context->flags & RBUF_MPMC;
+    int status;
+    uint64_t head, next;
+    frame_t frame;
+
+    *count = 0;
+    if (context->flags & RBUF_SLOTS) {
+        return read_batch_slots(context, buffer, buffer_len, messages, max_messages, count);
+    }
+    if (!mpmc) {
+        lock_side(context, &context->mutex_read);
+    }
+
+    for (;;) {
+        head = atomic_load_explicit(&context->state->read_head.pos, memory_order_relaxed);
+        uint64_t write_tail = atomic_load_explicit(&context->state->write_tail.pos, memory_order_acquire);
+        if (head == write_tail) {
+            status = RINGBUFFER_EMPTY;
+            break;
+        }
+
+        // take whole records while they fit, cancelled reservations are taken along and dropped
+        size_t used = 0, taken = 0;
+        next = head;
+        while (next != write_tail && taken < max_messages) {
+            read_frame(context, next, &frame);
+            if (!frame.cancelled) {
+                if (used + frame.message_len > buffer_len) {
+                    break;
+                }
+                used += frame.message_len;
+                taken++;
+            }
+            next += frame.record_len;
+        }
+
+        if (next == head) {
+            if (mpmc && atomic_load_explicit(&context->state->read_head.pos, memory_order_acquire) != head) {
+                continue;
+            }
+            status = OUTPUT_BUFFER_TOO_SMALL;
+            break;
+        }
+        if (mpmc && !atomic_compare_exchange_weak_explicit(&context->state->read_head.pos, &head, next,
+                                                           memory_order_relaxed, memory_order_relaxed)) {
+            continue;
+        }
+
+        uint8_t *out = buffer;
+        size_t splits = 0;
+        for (uint64_t read = head; read != next; read += frame.record_len) {
+            read_frame(context, read, &frame);
+            if (frame.cancelled) {
+                continue;
+            }
+            read_from_buffer(context, read + frame.header_len, out, frame.message_len);
+            splits += wraps(context, read + frame.header_len, frame.message_len);
+            messages[*count].iov_base = out;
+            messages[*count].iov_len = frame.message_len;
+            (*count)++;
+            out += frame.message_len;
+        }
+
+        // publish_read unlocks mutex_read for the locked mode
+        count_messages(context, &context->stats_read, *count, out - (uint8_t *) buffer, splits);
+        publish_read(context, head, next - head);
+        if (*count == 0) {
+            count_stat(&context->stats_read.refused, 1, 0);
+            return RINGBUFFER_EMPTY;
+        }
+        return SUCCESS;
+    }
+
+    if (!mpmc) {
+        unlock_side(context, &context->mutex_read);
+    }
+    if (status == RINGBUFFER_EMPTY) {
+        count_stat(&context->stats_read.refused, 1, 0);
+    }
+    return status;
+}
+
+/* whether a reader would find something right now, cancelled records included */
+static int has_records(rbctx_t *context)
+{
+    if (context->flags & RBUF_SLOTS) {
+        uint64_t dequeue = atomic_load_explicit(&context->slots->dequeue_pos.pos, memory_order_relaxed);
+        return atomic_load_explicit(&slotring_slot(context->slots, dequeue)->seq, memory_order_acquire) == dequeue + 1;
+    }
+    uint64_t read_head = atomic_load_explicit(&context->state->read_head.pos, memory_order_relaxed);
+    return atomic_load_explicit(&context->state->write_tail.pos, memory_order_acquire) != read_head;
+}
+
+int ringbuffer_events_enable(rbctx_t *context)
+{
+#ifdef __linux__
+    int readable = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int writable = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (readable < 0 || writable < 0) {
+        if (readable >= 0) {
+            close(readable);
+        }
+        if (writable >= 0) {
+            close(writable);
+        }
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    context->event_fds[RBUF_EVENT_READABLE] = readable;
+    context->event_fds[RBUF_EVENT_WRITABLE] = writable;
+
+    // start out with the current state, afterwards only transitions are signaled
+    if (get_available_size(context) > 0) {
+        signal_event(context, RBUF_EVENT_WRITABLE);
+    }
+    if (has_records(context)) {
+        signal_event(context, RBUF_EVENT_READABLE);
+    }
+    return SUCCESS;
+#else
+    (void) context;
+    return RINGBUFFER_ALLOC_FAILED;
+#endif
+}
+
+int ringbuffer_event_fd(rbctx_t *context, int event)
+{
+    return context->event_fds[event];
+}
+
+void ringbuffer_event_ack(rbctx_t *context, int event)
+{
+#ifdef __linux__
+    uint64_t count;
+    if (read(context->event_fds[event], &count, sizeof(count)) < 0) {
+        // EAGAIN: nothing to acknowledge
+    }
+#else
+    (void) context;
+    (void) event;
+#endif
+}
+
+void ringbuffer_deadline(struct timespec *deadline, long timeout_ns)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout_ns / 1000000000L;
+    deadline->tv_nsec += timeout_ns % 1000000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/* sleep until signal's seq moves away from seq or the deadline passes */
+static int sleep_on(rbsignal_t *signal, uint32_t seq, const struct timespec *deadline)
+{
+#ifdef __linux__
+    // FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC timeout, NULL blocks forever
+    int op = signal->process_shared ? FUTEX_WAIT_BITSET : FUTEX_WAIT_BITSET_PRIVATE;
+    if (syscall(SYS_futex, &signal->seq, op, seq, deadline, NULL, FUTEX_BITSET_MATCH_ANY) == -1 && errno == ETIMEDOUT) {
+        return ETIMEDOUT;
+    }
+    return 0;
+#else
+    // no futex, poll the sequence with short naps
+    struct timespec nap = {0, 50000}, now;
+    while (atomic_load_explicit(&signal->seq, memory_order_acquire) == seq) {
+        nanosleep(&nap, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (deadline != NULL && (now.tv_sec > deadline->tv_sec ||
+                                 (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec))) {
+            return ETIMEDOUT;
+        }
+    }
+    return 0;
+#endif
+}
+
+static uint64_t elapsed_ns(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) ((now.tv_sec - start->tv_sec) * 1000000000L + (now.tv_nsec - start->tv_nsec));
+}
+
+/* ringbuffer_signal_wait, adding the time asleep to wait_ns unless it is NULL */
+static int signal_wait(rbsignal_t *signal, int again_status, const struct timespec *deadline,
+                       int (*op)(void *arg), void *arg, _Atomic uint64_t *wait_ns)
+{
+    int status = op(arg);
+    if (status != again_status) {
+        return status;
+    }
+
+    // register before checking again, so a publish after that check sees us and wakes us up
+    atomic_fetch_add_explicit(&signal->waiters, 1, memory_order_seq_cst);
+    for (;;) {
+        uint32_t seq = atomic_load_explicit(&signal->seq, memory_order_acquire);
+        atomic_thread_fence(memory_order_seq_cst);
+        status = op(arg);
+        if (status != again_status) {
+            break;
+        }
+        TRACE(TRACE_INFO, TRACE_WAIT_SLEEP, again_status, seq);
+        struct timespec start;
+        if (wait_ns != NULL) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+        }
+        int timed_out = sleep_on(signal, seq, deadline) == ETIMEDOUT;
+        if (wait_ns != NULL) {
+            count_stat(wait_ns, elapsed_ns(&start), 0);
+        }
+        TRACE(TRACE_INFO, TRACE_WAIT_WAKE, again_status, atomic_load_explicit(&signal->seq, memory_order_relaxed));
+        if (timed_out) {
+            status = op(arg);
+            break;
+        }
+    }
+    atomic_fetch_sub_explicit(&signal->waiters, 1, memory_order_relaxed);
+    return status;
+}
+
+int ringbuffer_signal_wait(rbsignal_t *signal, int again_status, const struct timespec *deadline,
+                           int (*op)(void *arg), void *arg)
+{
+    return signal_wait(signal, again_status, deadline, op, arg, NULL);
+}
+
+void ringbuffer_signal_wake(rbsignal_t *signal)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&signal->waiters, memory_order_relaxed) > 0) {
+        wake_all(signal);
+    }
+}
+
+typedef struct {
+    rbctx_t *context;
+    void *data;
+    size_t len;
+    size_t *len_ptr;
+    rbspan_t *span;
+} wait_args_t;
+
+static int try_write(void *arg)
+{
+    wait_args_t *args = arg;
+    return ringbuffer_write(args->context, args->data, args->len);
+}
+
+static int try_read(void *arg)
+{
+    wait_args_t *args = arg;
+    return ringbuffer_read(args->context, args->data, args->len_ptr);
+}
+
+static int try_reserve(void *arg)
+{
+    wait_args_t *args = arg;
+    return ringbuffer_reserve(args->context, args->len, args->span);
+}
+
+static int try_peek(void *arg)
+{
+    wait_args_t *args = arg;
+    return ringbuffer_peek(args->context, args->span);
+}
+
+int ringbuffer_write_wait(rbctx_t *context, void *message, size_t message_len, const struct timespec *deadline)
+{
+    wait_args_t args = {.context = context, .data = message, .len = message_len};
+    return signal_wait(&context->state->signal_write, RINGBUFFER_FULL, deadline, try_write, &args,
+                       &context->stats_write.wait_ns);
+}
+
+int ringbuffer_read_wait(rbctx_t *context, void *buffer, size_t *buffer_len, const struct timespec *deadline)
+{
+    wait_args_t args = {.context = context, .data = buffer, .len_ptr = buffer_len};
+    return signal_wait(&context->state->signal_read, RINGBUFFER_EMPTY, deadline, try_read, &args,
+                       &context->stats_read.wait_ns);
+}
+
+int ringbuffer_reserve_wait(rbctx_t *context, size_t message_len, rbspan_t *span, const struct timespec *deadline)
+{
+    wait_args_t args = {.context = context, .len = message_len, .span = span};
+    return signal_wait(&context->state->signal_write, RINGBUFFER_FULL, deadline, try_reserve, &args,
+                       &context->stats_write.wait_ns);
+}
+
+int ringbuffer_peek_wait(rbctx_t *context, rbspan_t *span, const struct timespec *deadline)
+{
+    wait_args_t args = {.context = context, .span = span};
+    return signal_wait(&context->state->signal_read, RINGBUFFER_EMPTY, deadline, try_peek, &args,
+                       &context->stats_read.wait_ns);
+}
+
+void ringbuffer_destroy(rbctx_t *context)
+{
+    pthread_mutex_destroy(&(context->mutex_read));
+    pthread_mutex_destroy(&(context->mutex_write));
+
+    if (context->flags & RBUF_MIRRORED) {
+        munmap(context->begin, 2 * context->size);
+    }
+    for (int event = RBUF_EVENT_READABLE; event <= RBUF_EVENT_WRITABLE; event++) {
+        if (context->event_fds[event] >= 0) {
+            close(context->event_fds[event]);
+            context->event_fds[event] = -1;
+        }
+    }
+    if (context->flags & RBUF_SHARED) {
+        rbshm_header_t *header = (rbshm_header_t *) ((uint8_t *) context->state - offsetof(rbshm_header_t, state));
+        munmap(header, header->data_offset + header->capacity);
+    }
 }
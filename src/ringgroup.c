@@ -0,0 +1,110 @@
+#include "../include/ringgroup.h"
+#include <stdint.h>
+
+void ringbuffer_group_init(rbgroup_t *group, rbshard_t *shards, size_t shard_count)
+{
+    group->shards = shards;
+    group->shard_count = shard_count;
+    atomic_init(&group->cursor.pos, 0);
+    atomic_init(&group->signal_read.seq, 0);
+    atomic_init(&group->signal_read.waiters, 0);
+    group->signal_read.process_shared = 0;
+
+    for (size_t i = 0; i < shard_count; i++) {
+        atomic_init(&shards[i].claimed, 0);
+        shards[i].ring.notify_read = &group->signal_read;
+    }
+}
+
+rbctx_t *ringbuffer_group_shard(rbgroup_t *group, size_t index)
+{
+    assert(index < group->shard_count);
+    return &group->shards[index].ring;
+}
+
+int ringbuffer_group_peek(rbgroup_t *group, rbspan_t *span, size_t *shard)
+{
+    // every call starts one shard further, so a busy producer can't starve the others
+    uint64_t start = atomic_fetch_add_explicit(&group->cursor.pos, 1, memory_order_relaxed);
+
+    for (size_t i = 0; i < group->shard_count; i++) {
+        size_t index = (start + i) % group->shard_count;
+        rbshard_t *candidate = &group->shards[index];
+
+        int expected = 0;
+        if (atomic_load_explicit(&candidate->claimed, memory_order_relaxed) != 0 ||
+            !atomic_compare_exchange_strong_explicit(&candidate->claimed, &expected, 1,
+                                                     memory_order_acquire, memory_order_relaxed)) {
+            continue;
+        }
+        if (ringbuffer_peek(&candidate->ring, span) == SUCCESS) {
+            *shard = index;
+            return SUCCESS;
+        }
+        atomic_store_explicit(&candidate->claimed, 0, memory_order_release);
+    }
+    return RINGBUFFER_EMPTY;
+}
+
+typedef struct {
+    rbgroup_t *group;
+    rbspan_t *span;
+    size_t *shard;
+} peek_args_t;
+
+static int try_peek(void *arg)
+{
+    peek_args_t *args = arg;
+    return ringbuffer_group_peek(args->group, args->span, args->shard);
+}
+
+int ringbuffer_group_peek_wait(rbgroup_t *group, rbspan_t *span, size_t *shard, const struct timespec *deadline)
+{
+    peek_args_t args = {group, span, shard};
+    return ringbuffer_signal_wait(&group->signal_read, RINGBUFFER_EMPTY, deadline, try_peek, &args);
+}
+
+void ringbuffer_group_consume(rbgroup_t *group, size_t shard, rbspan_t *span)
+{
+    rbshard_t *claimed = &group->shards[shard];
+
+    ringbuffer_consume(&claimed->ring, span);
+    atomic_store_explicit(&claimed->claimed, 0, memory_order_release);
+
+    // a consumer may have gone to sleep after skipping this shard while we held it
+    ringbuffer_signal_wake(&group->signal_read);
+}
+
+int ringbuffer_group_consume_next(rbgroup_t *group, size_t shard, rbspan_t *span)
+{
+    rbshard_t *claimed = &group->shards[shard];
+
+    ringbuffer_consume(&claimed->ring, span);
+    if (ringbuffer_peek(&claimed->ring, span) == SUCCESS) {
+        return SUCCESS;
+    }
+    atomic_store_explicit(&claimed->claimed, 0, memory_order_release);
+    ringbuffer_signal_wake(&group->signal_read);
+    return RINGBUFFER_EMPTY;
+}
+
+unsigned int ringbuffer_group_occupancy(rbgroup_t *group)
+{
+    unsigned int fullest = 0;
+    for (size_t i = 0; i < group->shard_count; i++) {
+        unsigned int occupancy = ringbuffer_occupancy(&group->shards[i].ring);
+        if (occupancy > fullest) {
+            fullest = occupancy;
+        }
+    }
+    return fullest;
+}
+
+void ringbuffer_group_destroy(rbgroup_t *group)
+{
+    for (size_t i = 0; i < group->shard_count; i++) {
+        group->shards[i].ring.notify_read = NULL;
+    }
+    group->shards = NULL;
+    group->shard_count = 0;
+}
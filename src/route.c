@@ -0,0 +1,116 @@
+#define _GNU_SOURCE
+#include "../include/route.h"
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* counting sort of the routes by port, keeping the order of a port's routes */
+static rbroute_table_t *compile_table(const rbroute_t *routes, size_t count)
+{
+    rbroute_table_t *table = calloc(1, sizeof(rbroute_table_t));
+    if (table == NULL) {
+        return NULL;
+    }
+    table->sinks = malloc((count > 0 ? count : 1) * sizeof(uint32_t));
+    if (table->sinks == NULL) {
+        free(table);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        table->first[routes[i].port + 1]++;
+    }
+    for (size_t port = 0; port < RBUF_ROUTE_PORTS; port++) {
+        table->first[port + 1] += table->first[port];
+    }
+    uint32_t *next = malloc(RBUF_ROUTE_PORTS * sizeof(uint32_t));
+    if (next == NULL) {
+        free(table->sinks);
+        free(table);
+        return NULL;
+    }
+    memcpy(next, table->first, RBUF_ROUTE_PORTS * sizeof(uint32_t));
+    for (size_t i = 0; i < count; i++) {
+        table->sinks[next[routes[i].port]++] = routes[i].sink;
+    }
+    free(next);
+    return table;
+}
+
+static void free_table(rbroute_table_t *table)
+{
+    if (table != NULL) {
+        free(table->sinks);
+        free(table);
+    }
+}
+
+int route_init(rbrouter_t *router)
+{
+    rbroute_table_t *table = compile_table(NULL, 0);
+    if (table == NULL) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    atomic_init(&router->table, table);
+    atomic_init(&router->phase, 0);
+    atomic_init(&router->readers[0], 0);
+    atomic_init(&router->readers[1], 0);
+    pthread_mutex_init(&router->writer, NULL);
+    return SUCCESS;
+}
+
+/* wait until every lookup counted in readers[phase] is done. lookups are short, but one
+ * preempted in the middle needs the cpu, so after a few tries the writer sleeps */
+static void drain(rbrouter_t *router, uint32_t phase)
+{
+    for (int tries = 0; atomic_load_explicit(&router->readers[phase & 1], memory_order_seq_cst) != 0; tries++) {
+        if (tries < 100) {
+            sched_yield();
+        } else {
+            struct timespec pause = {.tv_sec = 0, .tv_nsec = 50000};
+            nanosleep(&pause, NULL);
+        }
+    }
+}
+
+int route_set(rbrouter_t *router, const rbroute_t *routes, size_t count)
+{
+    rbroute_table_t *table = compile_table(routes, count);
+    if (table == NULL) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+
+    pthread_mutex_lock(&router->writer);
+    rbroute_table_t *old = atomic_exchange_explicit(&router->table, table, memory_order_seq_cst);
+    // a lookup may have read the phase before a flip and counted itself after the drain that
+    // followed it, so the old table is free only after both counts drained once since the swap
+    for (int round = 0; round < 2; round++) {
+        uint32_t phase = atomic_fetch_add_explicit(&router->phase, 1, memory_order_seq_cst);
+        drain(router, phase);
+    }
+    pthread_mutex_unlock(&router->writer);
+
+    free_table(old);
+    return SUCCESS;
+}
+
+size_t route_lookup(rbrouter_t *router, uint16_t port, uint32_t *sinks, size_t max_sinks)
+{
+    uint32_t phase = atomic_load_explicit(&router->phase, memory_order_relaxed) & 1;
+    atomic_fetch_add_explicit(&router->readers[phase], 1, memory_order_seq_cst);
+    rbroute_table_t *table = atomic_load_explicit(&router->table, memory_order_seq_cst);
+
+    size_t first = table->first[port], count = table->first[port + 1] - first;
+    memcpy(sinks, table->sinks + first, (count < max_sinks ? count : max_sinks) * sizeof(uint32_t));
+
+    atomic_fetch_sub_explicit(&router->readers[phase], 1, memory_order_release);
+    return count;
+}
+
+void route_destroy(rbrouter_t *router)
+{
+    free_table(atomic_load_explicit(&router->table, memory_order_relaxed));
+    atomic_store_explicit(&router->table, NULL, memory_order_relaxed);
+    pthread_mutex_destroy(&router->writer);
+}
@@ -0,0 +1,671 @@
+#include "../include/rules.h"
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+/* a content rule */
+typedef struct {
+    unsigned char *bytes;
+    size_t len;
+    int subsequence;
+} pattern_t;
+
+/* what compiling needs besides the result */
+typedef struct {
+    pattern_t *patterns;
+    size_t pattern_count;
+    size_t line;
+    char *error;
+    size_t error_len;
+} compiler_t;
+
+static int fail(compiler_t *compiler, const char *format, ...)
+{
+    if (compiler->error != NULL && compiler->error_len > 0) {
+        int prefix = compiler->line > 0 ? snprintf(compiler->error, compiler->error_len, "line %zu: ", compiler->line) : 0;
+        if (prefix >= 0 && (size_t) prefix < compiler->error_len) {
+            va_list args;
+            va_start(args, format);
+            vsnprintf(compiler->error + prefix, compiler->error_len - prefix, format, args);
+            va_end(args);
+        }
+    }
+    return RULES_INVALID;
+}
+
+/******************************************************************
+ * port rules
+ ******************************************************************/
+
+static void set_bit(uint8_t *bits, size_t bit)
+{
+    bits[bit >> 3] |= (uint8_t) (1u << (bit & 7));
+}
+
+static int test_bit(const uint8_t *bits, size_t bit)
+{
+    return (bits[bit >> 3] >> (bit & 7)) & 1;
+}
+
+/* N or N-M, nothing after it */
+static int parse_range(compiler_t *compiler, const char *arg, size_t max_port, size_t *low, size_t *high)
+{
+    char *end;
+    if (*arg < '0' || *arg > '9') {
+        return fail(compiler, "expected a port, got \"%s\"", arg);
+    }
+    *low = strtoul(arg, &end, 10);
+    *high = *low;
+    if (*end == '-') {
+        if (end[1] < '0' || end[1] > '9') {
+            return fail(compiler, "expected a port after '-'");
+        }
+        *high = strtoul(end + 1, &end, 10);
+    }
+    if (*end != '\0') {
+        return fail(compiler, "unexpected \"%s\" after the port", end);
+    }
+    if (*low > *high || *high > max_port) {
+        return fail(compiler, "ports have to be in 0-%zu, low to high", max_port);
+    }
+    return SUCCESS;
+}
+
+static int compile_port_rule(compiler_t *compiler, rbrules_t *rules, const char *kind, const char *arg)
+{
+    size_t max = rules->max_port, low, high;
+
+    if (strcmp(kind, "same") == 0) {
+        if (*arg != '\0') {
+            return fail(compiler, "\"port same\" takes no port");
+        }
+        rules->drop_same = 1;
+        return SUCCESS;
+    }
+    if (strcmp(kind, "sum") == 0) {
+        if (parse_range(compiler, arg, 2 * max, &low, &high) != SUCCESS) {
+            return RULES_INVALID;
+        }
+        for (size_t sum = low; sum <= high; sum++) {
+            set_bit(rules->dropped_sums, sum);
+        }
+        return SUCCESS;
+    }
+
+    int from_side = strcmp(kind, "from") == 0 || strcmp(kind, "either") == 0;
+    int to_side = strcmp(kind, "to") == 0 || strcmp(kind, "either") == 0;
+    if (!from_side && !to_side) {
+        return fail(compiler, "unknown port rule \"%s\"", kind);
+    }
+    if (parse_range(compiler, arg, max, &low, &high) != SUCCESS) {
+        return RULES_INVALID;
+    }
+    for (size_t port = low; port <= high; port++) {
+        if (from_side) {
+            set_bit(rules->dropped_from, port);
+        }
+        if (to_side) {
+            set_bit(rules->dropped_to, port);
+        }
+    }
+    return SUCCESS;
+}
+
+int rules_ports_allowed(const rbrules_t *rules, size_t from, size_t to)
+{
+    if (from > rules->max_port || to > rules->max_port) {
+        return 0;
+    }
+    return !((rules->drop_same && from == to) || test_bit(rules->dropped_from, from) ||
+             test_bit(rules->dropped_to, to) || test_bit(rules->dropped_sums, from + to));
+}
+
+/******************************************************************
+ * parsing
+ ******************************************************************/
+
+/* unescapes TEXT into a new pattern */
+static int add_pattern(compiler_t *compiler, const char *text, size_t len, int subsequence)
+{
+    unsigned char *bytes = malloc(len > 0 ? len : 1);
+    pattern_t *patterns = realloc(compiler->patterns, (compiler->pattern_count + 1) * sizeof(pattern_t));
+    if (bytes == NULL || patterns == NULL) {
+        free(bytes);
+        if (patterns != NULL) {
+            compiler->patterns = patterns;
+        }
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    compiler->patterns = patterns;
+
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] != '\\') {
+            bytes[n++] = (unsigned char) text[i];
+        } else if (i + 1 < len && text[i + 1] == '\\') {
+            bytes[n++] = '\\';
+            i++;
+        } else if (i + 3 < len && text[i + 1] == 'x' && isxdigit((unsigned char) text[i + 2]) &&
+                   isxdigit((unsigned char) text[i + 3])) {
+            char hex[3] = {text[i + 2], text[i + 3], '\0'};
+            bytes[n++] = (unsigned char) strtoul(hex, NULL, 16);
+            i += 3;
+        } else {
+            free(bytes);
+            return fail(compiler, "unknown escape, use \\xHH or \\\\");
+        }
+    }
+    if (n == 0 || n > RBUF_RULES_MAX_PATTERN) {
+        free(bytes);
+        return fail(compiler, "patterns have to be 1 to %d bytes", RBUF_RULES_MAX_PATTERN);
+    }
+    compiler->patterns[compiler->pattern_count++] = (pattern_t) {bytes, n, subsequence};
+    return SUCCESS;
+}
+
+static int parse_line(compiler_t *compiler, rbrules_t *rules, const char *line, size_t len)
+{
+    while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == '\n')) {
+        len--;
+    }
+    size_t start = 0;
+    while (start < len && (line[start] == ' ' || line[start] == '\t')) {
+        start++;
+    }
+    if (start == len || line[start] == '#') {
+        return SUCCESS;
+    }
+
+    // the keyword, then the rest of the line as it is
+    const char *keyword = line + start;
+    size_t keyword_len = 0;
+    while (start + keyword_len < len && keyword[keyword_len] != ' ' && keyword[keyword_len] != '\t') {
+        keyword_len++;
+    }
+    const char *rest = keyword + keyword_len;
+    size_t rest_len = len - start - keyword_len;
+    if (rest_len > 0) {
+        rest++;
+        rest_len--;
+    }
+
+    if (keyword_len == 9 && strncmp(keyword, "substring", 9) == 0) {
+        rules->content_rules++;
+        return add_pattern(compiler, rest, rest_len, 0);
+    }
+    if (keyword_len == 11 && strncmp(keyword, "subsequence", 11) == 0) {
+        rules->content_rules++;
+        return add_pattern(compiler, rest, rest_len, 1);
+    }
+    if (keyword_len == 4 && strncmp(keyword, "port", 4) == 0) {
+        char kind[16], arg[64];
+        char buffer[128];
+        if (rest_len >= sizeof(buffer)) {
+            return fail(compiler, "port rule too long");
+        }
+        memcpy(buffer, rest, rest_len);
+        buffer[rest_len] = '\0';
+        arg[0] = '\0';
+        char extra;
+        int fields = sscanf(buffer, "%15s %63s %c", kind, arg, &extra);
+        if (fields < 1 || fields > 2) {
+            return fail(compiler, "expected \"port KIND [PORTS]\"");
+        }
+        rules->port_rules++;
+        return compile_port_rule(compiler, rules, kind, arg);
+    }
+    return fail(compiler, "unknown rule \"%.*s\"", (int) keyword_len, keyword);
+}
+
+/******************************************************************
+ * content automaton
+ ******************************************************************/
+
+/* Aho-Corasick over the substrings, as a complete DFA over bytes */
+typedef struct {
+    int32_t (*go)[256];
+    uint8_t *out;           /* a substring ends here, or at a suffix of here */
+    size_t count;
+    size_t capacity;
+} trie_t;
+
+static int32_t trie_add_node(trie_t *trie)
+{
+    if (trie->count == trie->capacity) {
+        size_t capacity = trie->capacity ? 2 * trie->capacity : 64;
+        int32_t (*go)[256] = realloc(trie->go, capacity * sizeof(*go));
+        if (go == NULL) {
+            return -1;
+        }
+        trie->go = go;
+        uint8_t *out = realloc(trie->out, capacity);
+        if (out == NULL) {
+            return -1;
+        }
+        trie->out = out;
+        trie->capacity = capacity;
+    }
+    memset(trie->go[trie->count], 0xff, sizeof(trie->go[0]));
+    trie->out[trie->count] = 0;
+    return (int32_t) trie->count++;
+}
+
+static int build_trie(compiler_t *compiler, trie_t *trie)
+{
+    if (trie_add_node(trie) < 0) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    for (size_t p = 0; p < compiler->pattern_count; p++) {
+        pattern_t *pattern = &compiler->patterns[p];
+        if (pattern->subsequence) {
+            continue;
+        }
+        int32_t node = 0;
+        for (size_t i = 0; i < pattern->len; i++) {
+            if (trie->go[node][pattern->bytes[i]] < 0) {
+                int32_t child = trie_add_node(trie);
+                if (child < 0) {
+                    return RINGBUFFER_ALLOC_FAILED;
+                }
+                trie->go[node][pattern->bytes[i]] = child;
+            }
+            node = trie->go[node][pattern->bytes[i]];
+        }
+        trie->out[node] = 1;
+    }
+
+    // breadth first, so a node's failure link is complete before the node
+    int32_t *fail_link = malloc(trie->count * sizeof(int32_t));
+    int32_t *queue = malloc(trie->count * sizeof(int32_t));
+    if (fail_link == NULL || queue == NULL) {
+        free(fail_link);
+        free(queue);
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    size_t head = 0, tail = 0;
+    fail_link[0] = 0;
+    queue[tail++] = 0;
+    while (head < tail) {
+        int32_t node = queue[head++];
+        trie->out[node] |= trie->out[fail_link[node]];
+        for (int b = 0; b < 256; b++) {
+            int32_t child = trie->go[node][b];
+            int32_t fallback = node == 0 ? 0 : trie->go[fail_link[node]][b];
+            if (child < 0) {
+                trie->go[node][b] = fallback;
+            } else {
+                fail_link[child] = fallback;
+                queue[tail++] = child;
+            }
+        }
+    }
+    free(fail_link);
+    free(queue);
+    return SUCCESS;
+}
+
+/* product states are looked up by their key: the trie node, then the progress of every subsequence */
+typedef struct {
+    uint8_t *keys;
+    size_t key_len;
+    size_t capacity;        /* states there are keys for, grows like rules->next */
+    uint32_t *slots;        /* open addressing, state + 1, 0 for empty, at most half of them used */
+    size_t mask;
+} state_index_t;
+
+static uint64_t hash_key(const uint8_t *key, size_t len)
+{
+    uint64_t hash = 1469598103934665603ull;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ key[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/* make room for capacity states, the slots are rebuilt for the state_count there are */
+static int grow_index(state_index_t *index, size_t capacity, size_t state_count)
+{
+    uint8_t *keys = realloc(index->keys, capacity * index->key_len);
+    if (keys == NULL) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    index->keys = keys;
+    uint32_t *slots = calloc(2 * capacity, sizeof(uint32_t));
+    if (slots == NULL) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    free(index->slots);
+    index->slots = slots;
+    index->mask = 2 * capacity - 1;
+    index->capacity = capacity;
+
+    for (size_t state = 0; state < state_count; state++) {
+        size_t slot = hash_key(keys + state * index->key_len, index->key_len) & index->mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & index->mask;
+        }
+        slots[slot] = (uint32_t) state + 1;
+    }
+    return SUCCESS;
+}
+
+/* the state of a key, a new one if it has none.
+ * returns -1 past RBUF_RULES_MAX_STATES, -2 if the index could not grow */
+static int64_t intern_state(state_index_t *index, rbrules_t *rules, const uint8_t *key)
+{
+    size_t slot = hash_key(key, index->key_len) & index->mask;
+    while (index->slots[slot] != 0) {
+        uint32_t state = index->slots[slot] - 1;
+        if (memcmp(index->keys + state * index->key_len, key, index->key_len) == 0) {
+            return state;
+        }
+        slot = (slot + 1) & index->mask;
+    }
+    if (rules->state_count == RBUF_RULES_MAX_STATES) {
+        return -1;
+    }
+    if (rules->state_count == index->capacity) {
+        size_t capacity = 2 * index->capacity > RBUF_RULES_MAX_STATES ? RBUF_RULES_MAX_STATES : 2 * index->capacity;
+        if (grow_index(index, capacity, rules->state_count) != SUCCESS) {
+            return -2;
+        }
+        slot = hash_key(key, index->key_len) & index->mask;
+        while (index->slots[slot] != 0) {
+            slot = (slot + 1) & index->mask;
+        }
+    }
+    uint32_t state = (uint32_t) rules->state_count++;
+    memcpy(index->keys + state * index->key_len, key, index->key_len);
+    index->slots[slot] = state + 1;
+    return state;
+}
+
+static int build_automaton(compiler_t *compiler, rbrules_t *rules)
+{
+    // a class of its own for every byte in a pattern, the others share class 0
+    memset(rules->classes, 0, sizeof(rules->classes));
+    int representative[257];
+    int shared = -1;
+    rules->class_count = 1;
+    for (size_t p = 0; p < compiler->pattern_count; p++) {
+        for (size_t i = 0; i < compiler->patterns[p].len; i++) {
+            unsigned char b = compiler->patterns[p].bytes[i];
+            if (rules->classes[b] == 0) {
+                representative[rules->class_count] = b;
+                rules->classes[b] = (uint16_t) rules->class_count++;
+            }
+        }
+    }
+    for (int b = 0; b < 256 && shared < 0; b++) {
+        if (rules->classes[b] == 0) {
+            shared = b;
+        }
+    }
+    representative[0] = shared;     // -1 if every byte has a class of its own
+
+    trie_t trie = {0};
+    int status = build_trie(compiler, &trie);
+    size_t subsequences = 0;
+    for (size_t p = 0; p < compiler->pattern_count; p++) {
+        subsequences += compiler->patterns[p].subsequence;
+    }
+    pattern_t **subsequence = malloc((subsequences + 1) * sizeof(*subsequence));
+    if (subsequence != NULL) {
+        for (size_t p = 0, s = 0; p < compiler->pattern_count; p++) {
+            if (compiler->patterns[p].subsequence) {
+                subsequence[s++] = &compiler->patterns[p];
+            }
+        }
+    }
+
+    state_index_t index = {0};
+    index.key_len = sizeof(uint32_t) + subsequences * sizeof(uint16_t);
+    uint8_t *key = calloc(1, index.key_len);
+    size_t capacity = 64;
+    rules->next = malloc(capacity * rules->class_count * sizeof(uint32_t));
+    if (status == SUCCESS && (subsequence == NULL || key == NULL || rules->next == NULL ||
+                              grow_index(&index, capacity, 0) != SUCCESS)) {
+        status = RINGBUFFER_ALLOC_FAILED;
+    }
+
+    if (status == SUCCESS) {
+        // start: trie root, no progress. match: a key no byte leads to
+        rules->state_count = 0;
+        intern_state(&index, rules, key);
+        memset(key, 0xff, index.key_len);
+        intern_state(&index, rules, key);
+    }
+
+    // breadth first over the reachable states, every class of each
+    for (size_t state = 0; status == SUCCESS && state < rules->state_count; state++) {
+        if (state == capacity) {
+            capacity = 2 * capacity > RBUF_RULES_MAX_STATES ? RBUF_RULES_MAX_STATES : 2 * capacity;
+            uint32_t *next = realloc(rules->next, capacity * rules->class_count * sizeof(uint32_t));
+            if (next == NULL) {
+                status = RINGBUFFER_ALLOC_FAILED;
+                break;
+            }
+            rules->next = next;
+        }
+        uint32_t *row = rules->next + state * rules->class_count;
+        if (state == RBUF_RULES_MATCH) {
+            for (size_t c = 0; c < rules->class_count; c++) {
+                row[c] = RBUF_RULES_MATCH;
+            }
+            continue;
+        }
+
+        for (size_t c = 0; c < rules->class_count; c++) {
+            if (representative[c] < 0) {
+                row[c] = (uint32_t) state;     // a class without bytes
+                continue;
+            }
+            unsigned char b = (unsigned char) representative[c];
+            const uint8_t *from = index.keys + state * index.key_len;
+            int32_t node;
+            memcpy(&node, from, sizeof(node));
+            node = trie.go[node][b];
+            int matched = trie.out[node];
+            memcpy(key, &node, sizeof(node));
+            for (size_t s = 0; s < subsequences && !matched; s++) {
+                uint16_t progress;
+                memcpy(&progress, from + sizeof(uint32_t) + s * sizeof(uint16_t), sizeof(progress));
+                if (subsequence[s]->bytes[progress] == b) {
+                    progress++;
+                }
+                matched = progress == subsequence[s]->len;
+                memcpy(key + sizeof(uint32_t) + s * sizeof(uint16_t), &progress, sizeof(progress));
+            }
+            if (matched) {
+                row[c] = RBUF_RULES_MATCH;
+                continue;
+            }
+            int64_t next = intern_state(&index, rules, key);
+            if (next == -2) {
+                status = RINGBUFFER_ALLOC_FAILED;
+                break;
+            }
+            if (next < 0) {
+                compiler->line = 0;
+                status = fail(compiler, "the content rules need more than %d automaton states", RBUF_RULES_MAX_STATES);
+                break;
+            }
+            row[c] = (uint32_t) next;
+        }
+    }
+
+    free(trie.go);
+    free(trie.out);
+    free(subsequence);
+    free(index.keys);
+    free(index.slots);
+    free(key);
+    return status;
+}
+
+/* states only a few bytes leave are skipped through with ringbuffer_scan_find */
+static int find_exits(rbrules_t *rules)
+{
+    rules->exit_count = calloc(rules->state_count, sizeof(uint8_t));
+    rules->exits = calloc(rules->state_count, sizeof(*rules->exits));
+    if (rules->exit_count == NULL || rules->exits == NULL) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    for (size_t state = 0; state < rules->state_count; state++) {
+        const uint32_t *row = rules->next + state * rules->class_count;
+        size_t count = 0;
+        for (int b = 0; b < 256 && count <= RBUF_SCAN_MAX_FIND; b++) {
+            if (row[rules->classes[b]] != state) {
+                if (count < RBUF_SCAN_MAX_FIND) {
+                    rules->exits[state][count] = (uint8_t) b;
+                }
+                count++;
+            }
+        }
+        rules->exit_count[state] = count <= RBUF_SCAN_MAX_FIND ? (uint8_t) count : 0;
+    }
+    return SUCCESS;
+}
+
+/******************************************************************
+ * interface
+ ******************************************************************/
+
+int rules_compile(rbrules_t *rules, const char *text, size_t max_port, char *error, size_t error_len)
+{
+    memset(rules, 0, sizeof(*rules));
+    rules->max_port = max_port;
+    rules->dropped_from = calloc(max_port / 8 + 1, 1);
+    rules->dropped_to = calloc(max_port / 8 + 1, 1);
+    rules->dropped_sums = calloc(2 * max_port / 8 + 1, 1);
+    if (rules->dropped_from == NULL || rules->dropped_to == NULL || rules->dropped_sums == NULL) {
+        rules_destroy(rules);
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+
+    compiler_t compiler = {.error = error, .error_len = error_len};
+    if (error != NULL && error_len > 0) {
+        error[0] = '\0';
+    }
+    int status = SUCCESS;
+    for (const char *line = text; status == SUCCESS && *line != '\0';) {
+        const char *end = strchr(line, '\n');
+        size_t len = end != NULL ? (size_t) (end - line) : strlen(line);
+        compiler.line++;
+        status = parse_line(&compiler, rules, line, len);
+        line += end != NULL ? len + 1 : len;
+    }
+
+    if (status == SUCCESS) {
+        status = build_automaton(&compiler, rules);
+    }
+    if (status == SUCCESS) {
+        status = find_exits(rules);
+    }
+    for (size_t p = 0; p < compiler.pattern_count; p++) {
+        free(compiler.patterns[p].bytes);
+    }
+    free(compiler.patterns);
+    if (status != SUCCESS) {
+        rules_destroy(rules);
+    }
+    return status;
+}
+
+int rules_load(rbrules_t *rules, const char *path, size_t max_port, char *error, size_t error_len)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        compiler_t compiler = {.error = error, .error_len = error_len};
+        return fail(&compiler, "cannot open %s", path);
+    }
+    size_t len = 0, capacity = 4096;
+    char *text = malloc(capacity);
+    while (text != NULL) {
+        len += fread(text + len, 1, capacity - len - 1, file);
+        if (len < capacity - 1) {
+            break;
+        }
+        capacity *= 2;
+        char *grown = realloc(text, capacity);
+        if (grown == NULL) {
+            free(text);
+        }
+        text = grown;
+    }
+    int read_failed = ferror(file);
+    fclose(file);
+    if (text == NULL) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    if (read_failed) {
+        free(text);
+        compiler_t compiler = {.error = error, .error_len = error_len};
+        return fail(&compiler, "cannot read %s", path);
+    }
+    text[len] = '\0';
+
+    int status = rules_compile(rules, text, max_port, error, error_len);
+    free(text);
+    return status;
+}
+
+uint32_t rules_scan(const rbrules_t *rules, uint32_t state, const unsigned char *data, size_t len)
+{
+    if (rules->content_rules == 0) {
+        return state;
+    }
+    size_t i = 0;
+    while (i < len && state != RBUF_RULES_MATCH) {
+        uint8_t exits = rules->exit_count[state];
+        if (exits == 1) {
+            // libc's memchr is vectorized as well, and cheaper to call for one byte
+            const unsigned char *hit = memchr(data + i, rules->exits[state][0], len - i);
+            if (hit == NULL) {
+                break;
+            }
+            i = (size_t) (hit - data);
+        } else if (exits > 0) {
+            i += ringbuffer_scan_find(data + i, len - i, rules->exits[state], exits);
+            if (i == len) {
+                break;
+            }
+        }
+        state = rules->next[state * rules->class_count + rules->classes[data[i++]]];
+    }
+    return state;
+}
+
+int rules_stream(const rbrules_t *rules, uint32_t *state, const unsigned char *data, size_t len)
+{
+    *state = rules_scan(rules, *state, data, len);
+    if (*state == RBUF_RULES_MATCH) {
+        *state = RBUF_RULES_START;
+        return 0;
+    }
+    return 1;
+}
+
+int rules_allowed(const rbrules_t *rules, size_t from, size_t to, const unsigned char *payload, size_t len)
+{
+    return rules_ports_allowed(rules, from, to) &&
+           rules_scan(rules, RBUF_RULES_START, payload, len) != RBUF_RULES_MATCH;
+}
+
+void rules_destroy(rbrules_t *rules)
+{
+    free(rules->dropped_from);
+    free(rules->dropped_to);
+    free(rules->dropped_sums);
+    free(rules->next);
+    free(rules->exit_count);
+    free(rules->exits);
+    rules->dropped_from = NULL;
+    rules->dropped_to = NULL;
+    rules->dropped_sums = NULL;
+    rules->next = NULL;
+    rules->exit_count = NULL;
+    rules->exits = NULL;
+}
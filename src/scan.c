@@ -0,0 +1,216 @@
+#include "../include/scan.h"
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+typedef size_t (*scan_fn)(const unsigned char *, size_t, const char *, size_t, size_t);
+typedef size_t (*find_fn)(const unsigned char *, size_t, const unsigned char *, size_t);
+
+static size_t scan_scalar(const unsigned char *data, size_t len, const char *pattern,
+                          size_t pattern_len, size_t matched)
+{
+    for (size_t i = 0; i < len && matched < pattern_len; i++) {
+        if (data[i] == (unsigned char) pattern[matched]) {
+            matched++;
+        }
+    }
+    return matched;
+}
+
+static size_t find_scalar(const unsigned char *data, size_t len, const unsigned char *bytes, size_t byte_count)
+{
+    for (size_t i = 0; i < len; i++) {
+        for (size_t j = 0; j < byte_count; j++) {
+            if (data[i] == bytes[j]) {
+                return i;
+            }
+        }
+    }
+    return len;
+}
+
+#ifdef SCAN_X86
+/* each wanted character is looked for a vector at a time, a hit continues right after it.
+ * the bytes left over at the end go through the scalar loop */
+static size_t scan_sse2(const unsigned char *data, size_t len, const char *pattern,
+                        size_t pattern_len, size_t matched)
+{
+    size_t i = 0;
+    while (matched < pattern_len && len - i >= 16) {
+        __m128i wanted = _mm_set1_epi8(pattern[matched]);
+        unsigned int hits = 0;
+        while (len - i >= 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i *) (data + i));
+            hits = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, wanted));
+            if (hits != 0) {
+                break;
+            }
+            i += 16;
+        }
+        if (hits == 0) {
+            break;
+        }
+        i += (size_t) __builtin_ctz(hits) + 1;
+        matched++;
+    }
+    return scan_scalar(data + i, len - i, pattern, pattern_len, matched);
+}
+
+static size_t find_sse2(const unsigned char *data, size_t len, const unsigned char *bytes, size_t byte_count)
+{
+    assert(byte_count >= 1 && byte_count <= RBUF_SCAN_MAX_FIND);
+    __m128i wanted[RBUF_SCAN_MAX_FIND];
+    for (size_t j = 0; j < byte_count; j++) {
+        wanted[j] = _mm_set1_epi8((char) bytes[j]);
+    }
+    size_t i = 0;
+    for (; len - i >= 16; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i hit = _mm_cmpeq_epi8(chunk, wanted[0]);
+        for (size_t j = 1; j < byte_count; j++) {
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(chunk, wanted[j]));
+        }
+        unsigned int hits = (unsigned int) _mm_movemask_epi8(hit);
+        if (hits != 0) {
+            return i + (size_t) __builtin_ctz(hits);
+        }
+    }
+    return i + find_scalar(data + i, len - i, bytes, byte_count);
+}
+
+__attribute__((target("avx2")))
+static size_t find_avx2(const unsigned char *data, size_t len, const unsigned char *bytes, size_t byte_count)
+{
+    assert(byte_count >= 1 && byte_count <= RBUF_SCAN_MAX_FIND);
+    __m256i wanted[RBUF_SCAN_MAX_FIND];
+    for (size_t j = 0; j < byte_count; j++) {
+        wanted[j] = _mm256_set1_epi8((char) bytes[j]);
+    }
+    size_t i = 0;
+    for (; len - i >= 32; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (data + i));
+        __m256i hit = _mm256_cmpeq_epi8(chunk, wanted[0]);
+        for (size_t j = 1; j < byte_count; j++) {
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(chunk, wanted[j]));
+        }
+        unsigned int hits = (unsigned int) _mm256_movemask_epi8(hit);
+        if (hits != 0) {
+            return i + (size_t) __builtin_ctz(hits);
+        }
+    }
+    return i + find_sse2(data + i, len - i, bytes, byte_count);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const unsigned char *data, size_t len, const char *pattern,
+                        size_t pattern_len, size_t matched)
+{
+    size_t i = 0;
+    while (matched < pattern_len && len - i >= 32) {
+        __m256i wanted = _mm256_set1_epi8(pattern[matched]);
+        unsigned int hits = 0;
+        while (len - i >= 32) {
+            __m256i chunk = _mm256_loadu_si256((const __m256i *) (data + i));
+            hits = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, wanted));
+            if (hits != 0) {
+                break;
+            }
+            i += 32;
+        }
+        if (hits == 0) {
+            break;
+        }
+        i += (size_t) __builtin_ctz(hits) + 1;
+        matched++;
+    }
+    // less than 32 bytes left, the sse2 loop still takes 16 of them at once
+    return scan_sse2(data + i, len - i, pattern, pattern_len, matched);
+}
+#endif
+
+int ringbuffer_scan_supported(int impl)
+{
+    switch (impl) {
+        case RBUF_SCAN_SCALAR:
+            return 1;
+#ifdef SCAN_X86
+        case RBUF_SCAN_SSE2:
+            return 1;
+        case RBUF_SCAN_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") != 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+static scan_fn scan_function(int impl)
+{
+    switch (impl) {
+#ifdef SCAN_X86
+        case RBUF_SCAN_SSE2:
+            return scan_sse2;
+        case RBUF_SCAN_AVX2:
+            return scan_avx2;
+#endif
+        default:
+            return scan_scalar;
+    }
+}
+
+static find_fn find_function(int impl)
+{
+    switch (impl) {
+#ifdef SCAN_X86
+        case RBUF_SCAN_SSE2:
+            return find_sse2;
+        case RBUF_SCAN_AVX2:
+            return find_avx2;
+#endif
+        default:
+            return find_scalar;
+    }
+}
+
+/* chosen on the first scan, -1 until then */
+static _Atomic int best_impl = -1;
+
+int ringbuffer_scan_impl(void)
+{
+    int impl = atomic_load_explicit(&best_impl, memory_order_relaxed);
+    if (impl < 0) {
+        impl = ringbuffer_scan_supported(RBUF_SCAN_AVX2) ? RBUF_SCAN_AVX2 :
+               ringbuffer_scan_supported(RBUF_SCAN_SSE2) ? RBUF_SCAN_SSE2 : RBUF_SCAN_SCALAR;
+        atomic_store_explicit(&best_impl, impl, memory_order_relaxed);
+    }
+    return impl;
+}
+
+size_t ringbuffer_scan_subsequence(const unsigned char *data, size_t len, const char *pattern,
+                                   size_t pattern_len, size_t matched)
+{
+    return scan_function(ringbuffer_scan_impl())(data, len, pattern, pattern_len, matched);
+}
+
+size_t ringbuffer_scan_subsequence_with(int impl, const unsigned char *data, size_t len, const char *pattern,
+                                        size_t pattern_len, size_t matched)
+{
+    return scan_function(impl)(data, len, pattern, pattern_len, matched);
+}
+
+size_t ringbuffer_scan_find(const unsigned char *data, size_t len, const unsigned char *bytes, size_t byte_count)
+{
+    return find_function(ringbuffer_scan_impl())(data, len, bytes, byte_count);
+}
+
+size_t ringbuffer_scan_find_with(int impl, const unsigned char *data, size_t len, const unsigned char *bytes,
+                                 size_t byte_count)
+{
+    return find_function(impl)(data, len, bytes, byte_count);
+}
@@ -0,0 +1,161 @@
+#include "../include/slotring.h"
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include <sched.h>
+
+#define SLOT_ALIGNMENT sizeof(uint64_t)
+
+size_t slotring_memory_size(size_t slot_count, size_t slot_size)
+{
+    // the message starts right after the length, not at the padded end of slot_t
+    size_t stride = (offsetof(slot_t, data) + slot_size + SLOT_ALIGNMENT - 1) & ~(SLOT_ALIGNMENT - 1);
+    return slot_count * stride;
+}
+
+int slotring_init(slotring_t *ring, void *buffer_location, size_t buffer_size, size_t slot_size)
+{
+#ifdef SLOTRING_SLOT_SIZE
+    assert(slot_size == SLOTRING_SLOT_SIZE);
+#endif
+    assert(slot_size <= SLOTRING_MAX_SLOT_SIZE);
+    assert((uintptr_t) buffer_location % SLOT_ALIGNMENT == 0);
+
+    ring->slots = buffer_location;
+    ring->slot_size = slot_size;
+    ring->stride = slotring_memory_size(1, slot_size);
+#ifdef SLOTRING_SLOT_SIZE
+    assert(ring->stride == SLOTRING_STRIDE);
+#endif
+
+    size_t slot_count = buffer_size / ring->stride;
+    if (slot_count == 0) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    while (slot_count & (slot_count - 1)) {
+        slot_count &= slot_count - 1;
+    }
+    ring->mask = slot_count - 1;
+
+    for (uint64_t i = 0; i < slot_count; i++) {
+        atomic_init(&slotring_slot(ring, i)->seq, i);
+    }
+    atomic_init(&ring->enqueue_pos.pos, 0);
+    atomic_init(&ring->dequeue_pos.pos, 0);
+    return SUCCESS;
+}
+
+int slotring_reserve(slotring_t *ring, size_t count, uint64_t *ticket)
+{
+    uint64_t pos = atomic_load_explicit(&ring->enqueue_pos.pos, memory_order_relaxed);
+
+    if (count == 0 || count > ring->mask + 1) {
+        return RINGBUFFER_FULL;
+    }
+    for (;;) {
+        // slots are freed out of order, every one of them has to be free for this lap
+        size_t free = 0;
+        int64_t dif = 0;
+        while (free < count) {
+            uint64_t seq = atomic_load_explicit(&slotring_slot(ring, pos + free)->seq, memory_order_acquire);
+            dif = (int64_t) (seq - (pos + free));
+            if (dif != 0) {
+                break;
+            }
+            free++;
+        }
+
+        if (free == count) {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueue_pos.pos, &pos, pos + count,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *ticket = pos;
+                return SUCCESS;
+            }
+        } else if (dif < 0 && atomic_load_explicit(&ring->enqueue_pos.pos, memory_order_relaxed) == pos) {
+            // the slot still holds a message from the previous lap
+            return RINGBUFFER_FULL;
+        } else {
+            pos = atomic_load_explicit(&ring->enqueue_pos.pos, memory_order_relaxed);
+        }
+    }
+}
+
+void slotring_commit(slotring_t *ring, uint64_t ticket, size_t message_len)
+{
+    slot_t *slot = slotring_slot(ring, ticket);
+    slot->len = (slotring_len_t) message_len;
+    atomic_store_explicit(&slot->seq, ticket + 1, memory_order_release);
+}
+
+int slotring_peek(slotring_t *ring, size_t max_len, uint64_t *ticket, size_t *message_len)
+{
+    uint64_t pos = atomic_load_explicit(&ring->dequeue_pos.pos, memory_order_relaxed);
+
+    for (;;) {
+        slot_t *slot = slotring_slot(ring, pos);
+        uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int64_t dif = (int64_t) (seq - (pos + 1));
+
+        if (dif == 0) {
+            // the acquire on seq makes len valid
+            slotring_len_t len = slot->len;
+            if (len != SLOTRING_CANCELLED && len > max_len) {
+                *message_len = len;
+                return OUTPUT_BUFFER_TOO_SMALL;
+            }
+            if (atomic_compare_exchange_weak_explicit(&ring->dequeue_pos.pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                if (len == SLOTRING_CANCELLED) {
+                    slotring_consume(ring, pos);
+                    pos++;
+                    continue;
+                }
+                *ticket = pos;
+                *message_len = len;
+                return SUCCESS;
+            }
+        } else if (dif < 0) {
+            return RINGBUFFER_EMPTY;
+        } else {
+            pos = atomic_load_explicit(&ring->dequeue_pos.pos, memory_order_relaxed);
+        }
+    }
+}
+
+void slotring_consume(slotring_t *ring, uint64_t ticket)
+{
+    // free for the producer one lap later
+    atomic_store_explicit(&slotring_slot(ring, ticket)->seq, ticket + ring->mask + 1, memory_order_release);
+}
+
+int slotring_write(slotring_t *ring, const void *message, size_t message_len)
+{
+    uint64_t ticket;
+
+    assert(message_len <= ring->slot_size);
+    if (slotring_reserve(ring, 1, &ticket) != SUCCESS) {
+        return RINGBUFFER_FULL;
+    }
+    memcpy(slotring_slot(ring, ticket)->data, message, message_len);
+    slotring_commit(ring, ticket, message_len);
+    return SUCCESS;
+}
+
+int slotring_read(slotring_t *ring, void *buffer, size_t *buffer_len)
+{
+    uint64_t ticket;
+    size_t message_len;
+
+    int status = slotring_peek(ring, *buffer_len, &ticket, &message_len);
+    if (status == OUTPUT_BUFFER_TOO_SMALL) {
+        *buffer_len = message_len;
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    memcpy(buffer, slotring_slot(ring, ticket)->data, message_len);
+    *buffer_len = message_len;
+    slotring_consume(ring, ticket);
+    return SUCCESS;
+}
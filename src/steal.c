@@ -0,0 +1,128 @@
+#include "../include/steal.h"
+#include <stdint.h>
+
+int steal_init(rbsteal_t *exec, int workers, size_t deque_size, rbsignal_t *notify)
+{
+    size_t size = 1;
+    while (size < deque_size) {
+        size <<= 1;
+    }
+    size_t deques_size = (workers * sizeof(rbdeque_t) + RBUF_CACHE_LINE - 1) / RBUF_CACHE_LINE * RBUF_CACHE_LINE;
+    exec->deques = aligned_alloc(RBUF_CACHE_LINE, deques_size);
+    if (exec->deques == NULL) {
+        return RINGBUFFER_ALLOC_FAILED;
+    }
+    for (int i = 0; i < workers; i++) {
+        rbdeque_t *deque = &exec->deques[i];
+        deque->tasks = calloc(size, sizeof(*deque->tasks));
+        if (deque->tasks == NULL) {
+            while (i-- > 0) {
+                free(exec->deques[i].tasks);
+            }
+            free(exec->deques);
+            return RINGBUFFER_ALLOC_FAILED;
+        }
+        atomic_init(&deque->top, 0);
+        atomic_init(&deque->bottom, 0);
+        atomic_init(&deque->stolen, 0);
+        deque->mask = (int64_t) size - 1;
+    }
+    exec->workers = workers;
+    atomic_init(&exec->victim, 0);
+    exec->notify = notify;
+    return SUCCESS;
+}
+
+int steal_push(rbsteal_t *exec, int worker, void *task)
+{
+    rbdeque_t *deque = &exec->deques[worker];
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (bottom - top > deque->mask) {
+        return RINGBUFFER_FULL;
+    }
+    atomic_store_explicit(&deque->tasks[bottom & deque->mask], task, memory_order_relaxed);
+    // publishes the task, and whatever it points to, to the thieves
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+
+    if (exec->notify != NULL) {
+        ringbuffer_signal_wake(exec->notify);
+    }
+    return SUCCESS;
+}
+
+void *steal_pop(rbsteal_t *exec, int worker)
+{
+    rbdeque_t *deque = &exec->deques[worker];
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    // thieves either see the smaller bottom, or we see their top
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+    void *task = atomic_load_explicit(&deque->tasks[bottom & deque->mask], memory_order_relaxed);
+    if (top == bottom) {
+        // the last task, a thief may be taking it as well
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                     memory_order_seq_cst, memory_order_relaxed)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+/* the oldest task of one deque, NULL if it is empty. retries when another thief was faster */
+static void *steal_from(rbdeque_t *deque)
+{
+    for (;;) {
+        int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+        atomic_thread_fence(memory_order_seq_cst);
+        int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+        if (top >= bottom) {
+            return NULL;
+        }
+        void *task = atomic_load_explicit(&deque->tasks[top & deque->mask], memory_order_relaxed);
+        if (atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                    memory_order_seq_cst, memory_order_relaxed)) {
+            atomic_fetch_add_explicit(&deque->stolen, 1, memory_order_relaxed);
+            return task;
+        }
+    }
+}
+
+void *steal_oldest(rbsteal_t *exec, int thief)
+{
+    // thieves spread over the victims instead of all emptying the first busy deque
+    uint32_t start = atomic_fetch_add_explicit(&exec->victim, 1, memory_order_relaxed);
+    for (int i = 0; i < exec->workers; i++) {
+        int victim = (int) ((start + i) % exec->workers);
+        if (victim == thief) {
+            continue;
+        }
+        void *task = steal_from(&exec->deques[victim]);
+        if (task != NULL) {
+            return task;
+        }
+    }
+    return NULL;
+}
+
+void *steal_take(rbsteal_t *exec, int worker)
+{
+    void *task = steal_pop(exec, worker);
+    return task != NULL ? task : steal_oldest(exec, worker);
+}
+
+void steal_destroy(rbsteal_t *exec)
+{
+    for (int i = 0; i < exec->workers; i++) {
+        free(exec->deques[i].tasks);
+    }
+    free(exec->deques);
+    exec->deques = NULL;
+}
@@ -0,0 +1,118 @@
+#include "../include/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct trace_ring {
+    struct trace_ring *next;
+    uint32_t thread;
+    _Atomic uint64_t count;     /* events ever recorded, only the owner thread writes */
+    trace_event_t events[TRACE_RING_EVENTS];
+} trace_ring_t;
+
+_Atomic int trace_level = TRACE_OFF;
+
+static _Atomic(trace_ring_t *) rings = NULL;
+static _Atomic uint32_t number_of_threads = 0;
+static _Thread_local trace_ring_t *local_ring = NULL;
+
+#define TRACE_NAME(id, name, arg0, arg1) name,
+static const char *event_names[] = { TRACE_EVENTS(TRACE_NAME) };
+#undef TRACE_NAME
+
+#define TRACE_ARGS(id, name, arg0, arg1) {arg0, arg1},
+static const char *event_arg_names[][2] = { TRACE_EVENTS(TRACE_ARGS) };
+#undef TRACE_ARGS
+
+void trace_set_level(int level)
+{
+    atomic_store_explicit(&trace_level, level, memory_order_relaxed);
+}
+
+const char *trace_configure_from_env(void)
+{
+    const char *level = getenv("RBUF_TRACE_LEVEL");
+    if (level != NULL) {
+        trace_set_level(atoi(level));
+    }
+    return getenv("RBUF_TRACE_FILE");
+}
+
+/* first event of a thread: allocate its ring and push it onto the global list */
+static trace_ring_t *register_thread(void)
+{
+    trace_ring_t *ring = calloc(1, sizeof(trace_ring_t));
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->thread = atomic_fetch_add_explicit(&number_of_threads, 1, memory_order_relaxed);
+    atomic_init(&ring->count, 0);
+
+    ring->next = atomic_load_explicit(&rings, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&rings, &ring->next, ring,
+                                                  memory_order_release, memory_order_relaxed)) {
+    }
+
+    local_ring = ring;
+    return ring;
+}
+
+void trace_record(uint32_t event, uint64_t arg0, uint64_t arg1)
+{
+    trace_ring_t *ring = local_ring;
+    if (ring == NULL && (ring = register_thread()) == NULL) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    uint64_t count = atomic_load_explicit(&ring->count, memory_order_relaxed);
+    trace_event_t *slot = &ring->events[count % TRACE_RING_EVENTS];
+    slot->timestamp_ns = (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+    slot->event = event;
+    slot->thread = ring->thread;
+    slot->arg0 = arg0;
+    slot->arg1 = arg1;
+    atomic_store_explicit(&ring->count, count + 1, memory_order_release);
+}
+
+int trace_dump(const char *path)
+{
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    trace_file_header_t header = {.version = TRACE_FILE_VERSION, .event_size = sizeof(trace_event_t)};
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC));
+    int failed = fwrite(&header, sizeof(header), 1, fp) != 1;
+
+    for (trace_ring_t *ring = atomic_load_explicit(&rings, memory_order_acquire); ring != NULL && !failed; ring = ring->next) {
+        uint64_t count = atomic_load_explicit(&ring->count, memory_order_acquire);
+        uint64_t first = count > TRACE_RING_EVENTS ? count - TRACE_RING_EVENTS : 0;
+
+        trace_file_thread_t thread = {.thread = ring->thread, .number_of_events = count - first};
+        failed |= fwrite(&thread, sizeof(thread), 1, fp) != 1;
+
+        // oldest first, in at most two runs because the ring wraps
+        size_t start = first % TRACE_RING_EVENTS;
+        size_t first_run = count - first < TRACE_RING_EVENTS - start ? count - first : TRACE_RING_EVENTS - start;
+        failed |= fwrite(&ring->events[start], sizeof(trace_event_t), first_run, fp) != first_run;
+        failed |= fwrite(&ring->events[0], sizeof(trace_event_t), count - first - first_run, fp) != count - first - first_run;
+    }
+
+    failed |= fclose(fp) != 0;
+    return failed ? -1 : 0;
+}
+
+const char *trace_event_name(uint32_t event)
+{
+    return event < TRACE_NUMBER_OF_EVENTS ? event_names[event] : NULL;
+}
+
+const char *trace_event_arg_name(uint32_t event, int arg)
+{
+    return event < TRACE_NUMBER_OF_EVENTS && (arg == 0 || arg == 1) ? event_arg_names[event][arg] : NULL;
+}
@@ -0,0 +1,103 @@
+#include "../include/ringbuf.h"
+#include <stdio.h>
+#include <pthread.h>
+#include <string.h>
+
+#define NUMBER_OF_MESSAGES 20000
+#define RBUF_SIZE 64  // bytes, writer and reader block on each other constantly
+#define TIMEOUT_NS 50000000L  // 50 ms
+
+typedef struct {
+    rbctx_t *rb;
+    int result;
+} args_t;
+
+long elapsed_ns(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000000L + (now.tv_nsec - start->tv_nsec);
+}
+
+void *reader(void *arg)
+{
+    rbctx_t *rb = ((args_t *)arg)->rb;
+
+    /* single producer, single consumer: messages arrive in order */
+    for (int i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        int msg;
+        size_t read = sizeof(msg);
+        if (ringbuffer_read_wait(rb, &msg, &read, NULL) != SUCCESS || read != sizeof(msg) || msg != i) {
+            printf("Error: expected message %d\n", i);
+            ((args_t *)arg)->result = 1;
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+int check_mode(int flags)
+{
+    char* rbuf = malloc(RBUF_SIZE);
+    rbctx_t *ringbuffer_context = malloc(sizeof(rbctx_t));
+    if (rbuf == NULL || ringbuffer_context == NULL) {
+        printf("Error: malloc failed\n");
+        exit(1);
+    }
+    ringbuffer_init_flags(ringbuffer_context, rbuf, RBUF_SIZE, flags);
+
+    /* the deadline is honored on an empty ring */
+    struct timespec start, deadline;
+    char buf[RBUF_SIZE];
+    size_t buf_len = sizeof(buf);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ringbuffer_deadline(&deadline, TIMEOUT_NS);
+    if (ringbuffer_read_wait(ringbuffer_context, buf, &buf_len, &deadline) != RINGBUFFER_EMPTY) {
+        printf("Error: read on an empty ring should time out\n");
+        return 1;
+    }
+    if (elapsed_ns(&start) < TIMEOUT_NS) {
+        printf("Error: read returned before its deadline\n");
+        return 1;
+    }
+
+    /* ... and on a full one */
+    while (ringbuffer_write(ringbuffer_context, buf, 8) == SUCCESS) {
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ringbuffer_deadline(&deadline, TIMEOUT_NS);
+    if (ringbuffer_write_wait(ringbuffer_context, buf, 8, &deadline) != RINGBUFFER_FULL || elapsed_ns(&start) < TIMEOUT_NS) {
+        printf("Error: write on a full ring should time out at its deadline\n");
+        return 1;
+    }
+    while (ringbuffer_read(ringbuffer_context, buf, &buf_len) == SUCCESS) {
+        buf_len = sizeof(buf);
+    }
+
+    /* writer and reader sleep on each other without any polling */
+    args_t r_args = {ringbuffer_context, 0};
+    pthread_t r_id;
+    pthread_create(&r_id, NULL, reader, &r_args);
+    for (int i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        if (ringbuffer_write_wait(ringbuffer_context, &i, sizeof(i), NULL) != SUCCESS) {
+            printf("Error: blocking write failed\n");
+            return 1;
+        }
+    }
+    pthread_join(r_id, NULL);
+
+    ringbuffer_destroy(ringbuffer_context);
+    free(rbuf);
+    free(ringbuffer_context);
+    return r_args.result;
+}
+
+int main()
+{
+    if (check_mode(RBUF_LOCKED) != 0 || check_mode(RBUF_MPMC) != 0 || check_mode(RBUF_SPSC) != 0) {
+        exit(1);
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "../include/ringbuf.h"
+#include "../include/elastic.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <string.h>
+
+#define INITIAL_SIZE 256  // bytes
+#define MAX_SIZE 4096  // bytes
+#define NUMBER_OF_WRITERS 4
+#define MESSAGES_PER_WRITER 20000
+
+#define CHECK(cond, msg) do { if (!(cond)) { printf("Error: %s\n", msg); exit(1); } } while (0)
+
+typedef struct {
+    int writer;
+    int sequence;
+} message_t;
+
+rbelastic_t elastic;
+
+/* without delays, the ring grows on the first backpressure and shrinks when it is idle */
+void check_grow_and_shrink(int flags)
+{
+    rbelastic_config_t config = {.initial_size = INITIAL_SIZE, .max_size = MAX_SIZE};
+    CHECK(ringbuffer_elastic_create(&elastic, &config, flags) == SUCCESS, "cannot create elastic ring");
+
+    int written = 0;
+    while (ringbuffer_elastic_write(&elastic, &written, sizeof(written)) == SUCCESS) {
+        written++;
+    }
+    CHECK(ringbuffer_elastic_capacity(&elastic) == MAX_SIZE, "ring didn't grow to its cap");
+    CHECK(written >= MAX_SIZE / 16, "ring full too early");  // records take at most 16 bytes
+
+    /* records keep their order across every migration */
+    for (int i = 0; i < written; i++) {
+        int msg;
+        size_t read = sizeof(msg);
+        CHECK(ringbuffer_elastic_read(&elastic, &msg, &read) == SUCCESS && msg == i, "message lost or reordered");
+    }
+    for (int i = 0; i < 10 && ringbuffer_elastic_capacity(&elastic) > INITIAL_SIZE; i++) {
+        int msg;
+        size_t read = sizeof(msg);
+        CHECK(ringbuffer_elastic_read(&elastic, &msg, &read) == RINGBUFFER_EMPTY, "read from an empty ring");
+    }
+    CHECK(ringbuffer_elastic_capacity(&elastic) == INITIAL_SIZE, "idle ring didn't shrink");
+    CHECK(elastic.grown == 4 && elastic.shrunk == 4, "unexpected number of migrations");
+
+    ringbuffer_elastic_free(&elastic);
+}
+
+void *writer(void *arg)
+{
+    int id = (int)(intptr_t) arg;
+    for (int i = 0; i < MESSAGES_PER_WRITER; i++) {
+        message_t msg = {id, i};
+        ringbuffer_elastic_write_wait(&elastic, &msg, sizeof(msg), NULL);
+    }
+    return NULL;
+}
+
+/* a slow reader lets the ring fill up, so it grows while writers and the reader run */
+void check_concurrent(int flags)
+{
+    rbelastic_config_t config = {.initial_size = INITIAL_SIZE, .max_size = MAX_SIZE,
+                                 .grow_after_ns = 1000000L, .shrink_after_ns = 1000000L};
+    CHECK(ringbuffer_elastic_create(&elastic, &config, flags) == SUCCESS, "cannot create elastic ring");
+
+    pthread_t w_ids[NUMBER_OF_WRITERS];
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        pthread_create(&w_ids[i], NULL, writer, (void *)(intptr_t) i);
+    }
+
+    int next[NUMBER_OF_WRITERS] = {0};
+    for (int i = 0; i < NUMBER_OF_WRITERS * MESSAGES_PER_WRITER; i++) {
+        message_t msg;
+        size_t read = sizeof(msg);
+        if (i < 2000) {
+            usleep(10);
+        }
+        CHECK(ringbuffer_elastic_read_wait(&elastic, &msg, &read, NULL) == SUCCESS, "read failed");
+        CHECK(msg.writer >= 0 && msg.writer < NUMBER_OF_WRITERS && msg.sequence == next[msg.writer],
+              "message lost or reordered");
+        next[msg.writer]++;
+    }
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        pthread_join(w_ids[i], NULL);
+    }
+    CHECK(elastic.grown > 0, "ring never grew under backpressure");
+
+    ringbuffer_elastic_free(&elastic);
+}
+
+int main()
+{
+    check_grow_and_shrink(RBUF_LOCKED);
+    check_grow_and_shrink(RBUF_MPMC | RBUF_FRAME_VARINT);
+    check_concurrent(RBUF_MPMC);
+    check_concurrent(RBUF_LOCKED | RBUF_FRAME_VARINT);
+
+    printf("Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "../include/ringbuf.h"
+#include "../include/slotring.h"
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/epoll.h>
+
+#define NUMBER_OF_MESSAGES 20000
+#define RBUF_SIZE 128  // bytes
+
+#define CHECK(cond, msg) do { if (!(cond)) { printf("Error: %s\n", msg); return 1; } } while (0)
+
+int pending(rbctx_t *rb, int event)
+{
+    struct pollfd pfd = {ringbuffer_event_fd(rb, event), POLLIN, 0};
+    return poll(&pfd, 1, 0) == 1;
+}
+
+/* events follow the state transitions */
+int check_transitions(rbctx_t *rb)
+{
+    char buf[RBUF_SIZE];
+    size_t buf_len;
+
+    CHECK(ringbuffer_events_enable(rb) == SUCCESS, "cannot create event fds");
+    CHECK(pending(rb, RBUF_EVENT_WRITABLE) && !pending(rb, RBUF_EVENT_READABLE), "wrong initial events");
+    ringbuffer_event_ack(rb, RBUF_EVENT_WRITABLE);
+
+    ringbuffer_write(rb, "a", 1);
+    CHECK(pending(rb, RBUF_EVENT_READABLE), "no readable event after the first write");
+    ringbuffer_event_ack(rb, RBUF_EVENT_READABLE);
+    ringbuffer_write(rb, "b", 1);
+    CHECK(!pending(rb, RBUF_EVENT_READABLE), "readable event without a transition");
+
+    while (ringbuffer_write(rb, "c", 1) == SUCCESS) {
+    }
+    CHECK(!pending(rb, RBUF_EVENT_WRITABLE), "writable event on a full ring");
+    buf_len = sizeof(buf);
+    ringbuffer_read(rb, buf, &buf_len);
+    CHECK(pending(rb, RBUF_EVENT_WRITABLE), "no writable event after a read from a full ring");
+    ringbuffer_event_ack(rb, RBUF_EVENT_WRITABLE);
+
+    buf_len = sizeof(buf);
+    while (ringbuffer_read(rb, buf, &buf_len) == SUCCESS) {
+        buf_len = sizeof(buf);
+    }
+    CHECK(!pending(rb, RBUF_EVENT_WRITABLE), "writable event without a full ring");
+    return 0;
+}
+
+void *writer(void *arg)
+{
+    rbctx_t *rb = arg;
+    int epfd = epoll_create1(0);
+    struct epoll_event ev = {.events = EPOLLIN}, out;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, ringbuffer_event_fd(rb, RBUF_EVENT_WRITABLE), &ev);
+
+    for (int i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        while (ringbuffer_write(rb, &i, sizeof(i)) != SUCCESS) {
+            epoll_wait(epfd, &out, 1, -1);
+            ringbuffer_event_ack(rb, RBUF_EVENT_WRITABLE);
+        }
+    }
+    close(epfd);
+    return NULL;
+}
+
+/* a producer thread and an event loop consumer, neither polls the ring */
+int check_event_loop(rbctx_t *rb)
+{
+    pthread_t w_id;
+    pthread_create(&w_id, NULL, writer, rb);
+
+    int epfd = epoll_create1(0);
+    struct epoll_event ev = {.events = EPOLLIN}, out;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, ringbuffer_event_fd(rb, RBUF_EVENT_READABLE), &ev);
+
+    int expected = 0;
+    while (expected < NUMBER_OF_MESSAGES) {
+        CHECK(epoll_wait(epfd, &out, 1, 5000) == 1, "no readable event");
+        ringbuffer_event_ack(rb, RBUF_EVENT_READABLE);
+
+        int msg;
+        size_t read = sizeof(msg);
+        while (ringbuffer_read(rb, &msg, &read) == SUCCESS) {
+            CHECK(read == sizeof(msg) && msg == expected, "wrong message");
+            expected++;
+            read = sizeof(msg);
+        }
+    }
+    pthread_join(w_id, NULL);
+    close(epfd);
+    return 0;
+}
+
+int check_mode(int flags)
+{
+    char* rbuf = malloc(RBUF_SIZE);
+    rbctx_t *ringbuffer_context = malloc(sizeof(rbctx_t));
+    if (rbuf == NULL || ringbuffer_context == NULL) {
+        printf("Error: malloc failed\n");
+        exit(1);
+    }
+
+    ringbuffer_init_flags(ringbuffer_context, rbuf, RBUF_SIZE, flags);
+    int result = check_transitions(ringbuffer_context);
+    ringbuffer_destroy(ringbuffer_context);
+
+    ringbuffer_init_flags(ringbuffer_context, rbuf, RBUF_SIZE, flags);
+    ringbuffer_events_enable(ringbuffer_context);
+    result |= check_event_loop(ringbuffer_context);
+    ringbuffer_destroy(ringbuffer_context);
+
+    free(rbuf);
+    free(ringbuffer_context);
+    return result;
+}
+
+int check_slots(void)
+{
+    slotring_t slots;
+    rbctx_t rb;
+    size_t memory_size = slotring_memory_size(4, sizeof(int));
+    uint64_t *memory = malloc(memory_size);
+    if (memory == NULL) {
+        printf("Error: malloc failed\n");
+        exit(1);
+    }
+
+    slotring_init(&slots, memory, memory_size, sizeof(int));
+    ringbuffer_init_slotring(&rb, &slots);
+    ringbuffer_events_enable(&rb);
+    int result = check_event_loop(&rb);
+    ringbuffer_destroy(&rb);
+
+    free(memory);
+    return result;
+}
+
+int main()
+{
+    if (check_mode(RBUF_LOCKED) != 0 || check_mode(RBUF_MPMC) != 0 || check_mode(RBUF_SPSC | RBUF_FRAME_VARINT) != 0 ||
+        check_slots() != 0) {
+        exit(1);
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
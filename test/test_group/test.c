@@ -0,0 +1,145 @@
+#include "../include/ringbuf.h"
+#include "../include/ringgroup.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <string.h>
+
+#define NUMBER_OF_WRITERS 6
+#define NUMBER_OF_READERS 4
+#define MESSAGES_PER_WRITER 10000
+#define SHARD_SIZE 128  // bytes
+#define TIMEOUT_NS 1000000L  // 1 ms
+
+typedef struct {
+    int writer;
+    int sequence;
+} message_t;
+
+rbgroup_t group;
+_Atomic int READ_COUNT = 0;
+int NEXT_SEQUENCE[NUMBER_OF_WRITERS];   // only touched while the writer's shard is claimed
+_Atomic int ERRORS = 0;
+
+void *writer(void *arg)
+{
+    int id = (int)(intptr_t) arg;
+    rbctx_t *rb = ringbuffer_group_shard(&group, id);
+
+    for (int i = 0; i < MESSAGES_PER_WRITER; i++) {
+        message_t msg = {id, i};
+        ringbuffer_write_wait(rb, &msg, sizeof(msg), NULL);
+    }
+    return NULL;
+}
+
+void *reader(void *arg)
+{
+    (void) arg;
+    rbspan_t span;
+    size_t shard;
+    struct timespec deadline;
+
+    while (READ_COUNT < NUMBER_OF_WRITERS * MESSAGES_PER_WRITER) {
+        ringbuffer_deadline(&deadline, TIMEOUT_NS);
+        if (ringbuffer_group_peek_wait(&group, &span, &shard, &deadline) != SUCCESS) {
+            continue;
+        }
+
+        /* every writer's messages come in order, from its own shard */
+        message_t msg;
+        ringbuffer_span_copy_out(&span, 0, &msg, sizeof(msg));
+        if (msg.writer != (int) shard || msg.sequence != NEXT_SEQUENCE[shard]) {
+            printf("Error: writer %d sent %d, expected writer %zu message %d\n",
+                   msg.writer, msg.sequence, shard, NEXT_SEQUENCE[shard]);
+            ERRORS++;
+        }
+        NEXT_SEQUENCE[shard] = msg.sequence + 1;
+        READ_COUNT++;
+        ringbuffer_group_consume(&group, shard, &span);
+    }
+    return NULL;
+}
+
+int main()
+{
+    rbshard_t shards[NUMBER_OF_WRITERS];
+    char *rbuf = malloc(NUMBER_OF_WRITERS * SHARD_SIZE);
+    if (rbuf == NULL) {
+        printf("Error: malloc failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        ringbuffer_init_flags(&shards[i].ring, rbuf + i * SHARD_SIZE, SHARD_SIZE, RBUF_SPSC | RBUF_FRAME_VARINT);
+    }
+    ringbuffer_group_init(&group, shards, NUMBER_OF_WRITERS);
+
+    /* an empty group times out */
+    rbspan_t span;
+    size_t shard;
+    struct timespec deadline;
+    ringbuffer_deadline(&deadline, TIMEOUT_NS);
+    if (ringbuffer_group_peek_wait(&group, &span, &shard, &deadline) != RINGBUFFER_EMPTY) {
+        printf("Error: peek on an empty group should time out\n");
+        exit(1);
+    }
+
+    /* consumers take turns over the shards: one message in each shard, each is seen once */
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        message_t msg = {i, 0};
+        ringbuffer_write(ringbuffer_group_shard(&group, i), &msg, sizeof(msg));
+    }
+    int seen = 0;
+    while (ringbuffer_group_peek(&group, &span, &shard) == SUCCESS) {
+        seen |= 1 << shard;
+        ringbuffer_group_consume(&group, shard, &span);
+    }
+    if (seen != (1 << NUMBER_OF_WRITERS) - 1) {
+        printf("Error: not every shard was read\n");
+        exit(1);
+    }
+
+    /* a claimed shard is skipped by other consumers */
+    message_t msg = {0, 0};
+    ringbuffer_write(ringbuffer_group_shard(&group, 0), &msg, sizeof(msg));
+    ringbuffer_write(ringbuffer_group_shard(&group, 0), &msg, sizeof(msg));
+    rbspan_t other;
+    size_t other_shard;
+    if (ringbuffer_group_peek(&group, &span, &shard) != SUCCESS ||
+        ringbuffer_group_peek(&group, &other, &other_shard) != RINGBUFFER_EMPTY) {
+        printf("Error: a claimed shard was handed out twice\n");
+        exit(1);
+    }
+    ringbuffer_group_consume(&group, shard, &span);
+    ringbuffer_group_peek(&group, &span, &shard);
+    ringbuffer_group_consume(&group, shard, &span);
+
+    printf("creating %d writer and %d reader threads\n", NUMBER_OF_WRITERS, NUMBER_OF_READERS);
+    pthread_t w_ids[NUMBER_OF_WRITERS], r_ids[NUMBER_OF_READERS];
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        pthread_create(&w_ids[i], NULL, writer, (void *)(intptr_t) i);
+    }
+    for (int i = 0; i < NUMBER_OF_READERS; i++) {
+        pthread_create(&r_ids[i], NULL, reader, NULL);
+    }
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        pthread_join(w_ids[i], NULL);
+    }
+    for (int i = 0; i < NUMBER_OF_READERS; i++) {
+        pthread_join(r_ids[i], NULL);
+    }
+
+    if (ERRORS != 0 || READ_COUNT != NUMBER_OF_WRITERS * MESSAGES_PER_WRITER) {
+        printf("Error: the incorrect number of messages was read\n");
+        exit(1);
+    }
+
+    ringbuffer_group_destroy(&group);
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        ringbuffer_destroy(&shards[i].ring);
+    }
+    free(rbuf);
+
+    printf("Test passed!\n");
+    return 0;
+}
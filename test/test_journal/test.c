@@ -0,0 +1,267 @@
+#include "../include/journal.h"
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define JOURNAL_FILE "/tmp/test_journal.rbj"
+#define RBUF_SIZE 4096  // bytes
+#define MAX_MSG_SIZE 200
+#define CRASH_ROUNDS 20
+
+/* a message: its number, then bytes derived from it */
+static size_t fill_message(unsigned char *msg, uint64_t seq)
+{
+    size_t len = sizeof(seq) + seq * 7 % (MAX_MSG_SIZE - sizeof(seq));
+    memcpy(msg, &seq, sizeof(seq));
+    for (size_t i = sizeof(seq); i < len; i++) {
+        msg[i] = (unsigned char) (seq * 13 + i);
+    }
+    return len;
+}
+
+static int check_message(const unsigned char *msg, size_t len, uint64_t *seq)
+{
+    unsigned char expected[MAX_MSG_SIZE];
+    memcpy(seq, msg, sizeof(*seq));
+    return len != fill_message(expected, *seq) || memcmp(msg, expected, len) != 0;
+}
+
+/* read everything, the numbers have to be consecutive from first, returns the count or -1 */
+static long drain(rbjournal_t *journal, uint64_t *first, uint64_t *last)
+{
+    unsigned char buf[MAX_MSG_SIZE];
+    long count = 0;
+    size_t len = sizeof(buf);
+    uint64_t seq;
+    while (ringbuffer_journal_read(journal, buf, &len) == SUCCESS) {
+        if (check_message(buf, len, &seq) || (count > 0 && seq != *last + 1)) {
+            printf("Error: message %llu is torn or out of order\n", (unsigned long long) seq);
+            return -1;
+        }
+        if (count++ == 0) {
+            *first = seq;
+        }
+        *last = seq;
+        len = sizeof(buf);
+    }
+    return count;
+}
+
+int check_resume(int flags, const rbjournal_sync_t *sync)
+{
+    rbjournal_t journal;
+    unsigned char msg[MAX_MSG_SIZE], buf[MAX_MSG_SIZE];
+    unlink(JOURNAL_FILE);
+
+    /* a reopened journal goes on where the last one stopped, many times around the ring */
+    uint64_t written = 0, read = 0;
+    for (int round = 0; round < 20; round++) {
+        if (ringbuffer_journal_open(&journal, JOURNAL_FILE, RBUF_SIZE, flags, sync) != SUCCESS) {
+            printf("Error: could not open the journal (flags %#x)\n", flags);
+            return 1;
+        }
+        size_t len;
+        uint64_t seq;
+        for (int i = 0; i < round % 3 + 1; i++) {
+            len = sizeof(buf);
+            if (read < written && (ringbuffer_journal_read(&journal, buf, &len) != SUCCESS ||
+                                   check_message(buf, len, &seq) || seq != read++)) {
+                printf("Error: journal resumed at the wrong message (flags %#x)\n", flags);
+                return 1;
+            }
+        }
+        while (ringbuffer_journal_write(&journal, msg, fill_message(msg, written)) == SUCCESS) {
+            written++;
+        }
+        ringbuffer_journal_close(&journal);
+    }
+
+    /* the size and flags of an existing journal are its own */
+    if (ringbuffer_journal_open(&journal, JOURNAL_FILE, 16, RBUF_LOCKED, sync) != SUCCESS ||
+        journal.ring.size < RBUF_SIZE - RBUF_CACHE_LINE || journal.ring.flags != flags) {
+        printf("Error: reopened journal changed (flags %#x)\n", flags);
+        return 1;
+    }
+
+    /* a message too large for the buffer stays */
+    size_t len = 1;
+    if (ringbuffer_journal_read(&journal, buf, &len) != OUTPUT_BUFFER_TOO_SMALL || len != fill_message(msg, read)) {
+        printf("Error: too small buffer not reported (flags %#x)\n", flags);
+        return 1;
+    }
+    uint64_t first = 0, last = 0;
+    if (drain(&journal, &first, &last) != (long) (written - read) || first != read || last != written - 1) {
+        printf("Error: messages lost or duplicated (flags %#x)\n", flags);
+        return 1;
+    }
+    ringbuffer_journal_close(&journal);
+
+    ringbuffer_journal_open(&journal, JOURNAL_FILE, RBUF_SIZE, flags, sync);
+    if (ringbuffer_journal_read(&journal, buf, &len) != RINGBUFFER_EMPTY) {
+        printf("Error: consumed messages came back (flags %#x)\n", flags);
+        return 1;
+    }
+    ringbuffer_journal_close(&journal);
+    unlink(JOURNAL_FILE);
+    return 0;
+}
+
+/* what the child got back from the journal before it was killed */
+typedef struct {
+    _Atomic int64_t written;    /* last message whose write returned */
+    _Atomic int64_t read;       /* last message whose read returned */
+    _Atomic int ready;
+} progress_t;
+
+typedef struct {
+    rbjournal_t *journal;
+    progress_t *progress;
+} child_t;
+
+void *child_reader(void *arg)
+{
+    child_t *child = arg;
+    unsigned char buf[MAX_MSG_SIZE];
+    for (;;) {
+        size_t len = sizeof(buf);
+        uint64_t seq;
+        if (ringbuffer_journal_read(child->journal, buf, &len) == SUCCESS) {
+            if (check_message(buf, len, &seq)) {
+                _exit(1);
+            }
+            atomic_store(&child->progress->read, (int64_t) seq);
+        }
+    }
+    return NULL;
+}
+
+/* write and read until killed */
+static void run_child(const rbjournal_sync_t *sync, int flags, progress_t *progress, uint64_t first)
+{
+    rbjournal_t journal;
+    if (ringbuffer_journal_open(&journal, JOURNAL_FILE, RBUF_SIZE, flags, sync) != SUCCESS) {
+        _exit(1);
+    }
+    child_t child = {.journal = &journal, .progress = progress};
+    pthread_t reader;
+    pthread_create(&reader, NULL, child_reader, &child);
+    atomic_store(&progress->ready, 1);
+
+    unsigned char msg[MAX_MSG_SIZE];
+    for (uint64_t seq = first;;) {
+        size_t len = fill_message(msg, seq);
+        if (ringbuffer_journal_write(&journal, msg, len) == SUCCESS) {
+            atomic_store(&progress->written, (int64_t) seq);
+            seq++;
+        }
+    }
+}
+
+int check_crash(int flags, const rbjournal_sync_t *sync)
+{
+    progress_t *progress = mmap(NULL, sizeof(progress_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    unlink(JOURNAL_FILE);
+
+    uint64_t next = 0;
+    for (int round = 0; round < CRASH_ROUNDS; round++) {
+        atomic_store(&progress->written, (int64_t) next - 1);
+        atomic_store(&progress->read, (int64_t) next - 1);
+        atomic_store(&progress->ready, 0);
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_child(sync, flags, progress, next);
+        }
+        while (!atomic_load(&progress->ready)) {
+            usleep(100);
+        }
+        usleep(1000 + round * 500);
+        kill(pid, SIGKILL);
+        int wstatus;
+        waitpid(pid, &wstatus, 0);
+        if (!WIFSIGNALED(wstatus)) {
+            printf("Error: child failed (policy %d, flags %#x)\n", sync->policy, flags);
+            return 1;
+        }
+
+        /* what is left starts right after the last read, or the one being read, and
+         * ends with the last write, or the one being written. nothing repeats */
+        int64_t written = atomic_load(&progress->written), read = atomic_load(&progress->read);
+        rbjournal_t journal;
+        if (ringbuffer_journal_open(&journal, JOURNAL_FILE, RBUF_SIZE, flags, sync) != SUCCESS) {
+            printf("Error: could not reopen the journal (policy %d, flags %#x)\n", sync->policy, flags);
+            return 1;
+        }
+        uint64_t first = 0, last = 0;
+        long count = drain(&journal, &first, &last);
+        ringbuffer_journal_close(&journal);
+        if (count < 0) {
+            return 1;
+        }
+        int lost = count == 0 ? written > read + 1 : (int64_t) first > read + 2 || (int64_t) last < written;
+        if (sync->policy == RBUF_SYNC_INTERVAL) {
+            // the end since the last sync may be gone
+            lost = count > 0 && (int64_t) first > read + 2;
+        }
+        if ((count > 0 && ((int64_t) first <= read || (int64_t) last > written + 1)) || lost) {
+            printf("Error: after a crash %ld messages %llu..%llu are left, %lld read and %lld written "
+                   "(policy %d, flags %#x)\n", count, (unsigned long long) first, (unsigned long long) last,
+                   (long long) read, (long long) written, sync->policy, flags);
+            return 1;
+        }
+        next = (uint64_t) written + 2;
+    }
+
+    /* a crash in the middle of writing a message drops just that message */
+    pid_t pid = fork();
+    if (pid == 0) {
+        rbjournal_t journal;
+        unsigned char msg[MAX_MSG_SIZE];
+        ringbuffer_journal_open(&journal, JOURNAL_FILE, RBUF_SIZE, flags, sync);
+        for (uint64_t seq = 0; seq < 10; seq++) {
+            ringbuffer_journal_write(&journal, msg, fill_message(msg, seq));
+        }
+        ringbuffer_journal_sync(&journal);  // the interval hasn't passed yet
+        rbspan_t span;
+        ringbuffer_journal_reserve(&journal, fill_message(msg, 10), &span);
+        ringbuffer_span_copy_in(&span, 0, msg, 20);
+        raise(SIGKILL);
+    }
+    waitpid(pid, NULL, 0);
+    rbjournal_t journal;
+    ringbuffer_journal_open(&journal, JOURNAL_FILE, RBUF_SIZE, flags, sync);
+    uint64_t first = 0, last = 0;
+    long count = drain(&journal, &first, &last);
+    ringbuffer_journal_close(&journal);
+    if (count != 10 || first != 0 || last != 9) {
+        printf("Error: a half written message survived a crash (policy %d, flags %#x)\n", sync->policy, flags);
+        return 1;
+    }
+
+    munmap(progress, sizeof(progress_t));
+    unlink(JOURNAL_FILE);
+    return 0;
+}
+
+int main()
+{
+    rbjournal_sync_t syncs[] = {
+        {.policy = RBUF_SYNC_NONE},
+        {.policy = RBUF_SYNC_BATCH, .method = RBUF_SYNC_MSYNC},
+        {.policy = RBUF_SYNC_BATCH, .method = RBUF_SYNC_FDATASYNC},
+        {.policy = RBUF_SYNC_INTERVAL, .method = RBUF_SYNC_MSYNC, .interval_ns = 1000000},
+    };
+    int modes[] = {RBUF_LOCKED, RBUF_MPMC, RBUF_MPMC | RBUF_FRAME_VARINT, RBUF_LOCKED | RBUF_FRAME_ALIGNED};
+    for (size_t i = 0; i < sizeof(syncs) / sizeof(syncs[0]); i++) {
+        for (size_t j = 0; j < sizeof(modes) / sizeof(modes[0]); j++) {
+            if (check_resume(modes[j], &syncs[i]) || check_crash(modes[j], &syncs[i])) {
+                return 1;
+            }
+        }
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
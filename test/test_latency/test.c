@@ -0,0 +1,107 @@
+#include "../include/latency.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define NUMBER_OF_VALUES 100000
+#define NUMBER_OF_THREADS 4
+#define REPORT_FILE "/tmp/test_latency.txt"
+
+/* every value is reported at most 1/32 too high, never too low */
+static int close_enough(uint64_t reported, uint64_t exact)
+{
+    return reported >= exact && reported - exact <= exact / (1u << LATENCY_SUB_BITS);
+}
+
+void *recorder(void *arg)
+{
+    uint64_t offset = (uint64_t) (uintptr_t) arg;
+    for (uint64_t i = 1; i <= NUMBER_OF_VALUES; i++) {
+        latency_record(LATENCY_RING, i);
+        latency_record(LATENCY_TOTAL, offset + i);
+    }
+    return NULL;
+}
+
+int main()
+{
+    /* values 1..NUMBER_OF_VALUES, each percentile is known exactly */
+    latency_hist_t *hist = calloc(1, sizeof(latency_hist_t));
+    for (uint64_t i = 1; i <= NUMBER_OF_VALUES; i++) {
+        latency_hist_record(hist, i);
+    }
+    double fractions[] = {0.0, 0.5, 0.9, 0.99, 0.999, 1.0};
+    for (size_t i = 0; i < sizeof(fractions) / sizeof(fractions[0]); i++) {
+        uint64_t exact = fractions[i] == 0.0 ? 1 : (uint64_t) (fractions[i] * NUMBER_OF_VALUES);
+        uint64_t reported = latency_hist_percentile(hist, fractions[i]);
+        if (!close_enough(reported, exact)) {
+            printf("Error: p%g is %llu, expected about %llu\n", fractions[i] * 100,
+                   (unsigned long long) reported, (unsigned long long) exact);
+            return 1;
+        }
+    }
+    if (hist->count != NUMBER_OF_VALUES || hist->max != NUMBER_OF_VALUES) {
+        printf("Error: wrong count or max\n");
+        return 1;
+    }
+
+    /* huge values land in the last bucket instead of out of bounds */
+    latency_hist_record(hist, UINT64_MAX);
+    if (latency_hist_percentile(hist, 1.0) != UINT64_MAX) {
+        printf("Error: maximum lost\n");
+        return 1;
+    }
+    free(hist);
+
+    /* nothing is recorded while it is off */
+    latency_record(LATENCY_RING, 1);
+    latency_hist_t *stages = calloc(LATENCY_NUMBER_OF_STAGES, sizeof(latency_hist_t));
+    latency_merge(stages);
+    if (stages[LATENCY_RING].count != 0) {
+        printf("Error: recorded while off\n");
+        return 1;
+    }
+
+    /* per thread histograms merge into one */
+    latency_set_enabled(1);
+    pthread_t threads[NUMBER_OF_THREADS];
+    for (uintptr_t i = 0; i < NUMBER_OF_THREADS; i++) {
+        pthread_create(&threads[i], NULL, recorder, (void *) (i * NUMBER_OF_VALUES));
+    }
+    for (int i = 0; i < NUMBER_OF_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    latency_merge(stages);
+    uint64_t all = (uint64_t) NUMBER_OF_THREADS * NUMBER_OF_VALUES;
+    if (stages[LATENCY_RING].count != all || stages[LATENCY_TOTAL].count != all ||
+        stages[LATENCY_VALIDATE].count != 0 || stages[LATENCY_TOTAL].max != all ||
+        !close_enough(latency_hist_percentile(&stages[LATENCY_TOTAL], 0.5), all / 2) ||
+        !close_enough(latency_hist_percentile(&stages[LATENCY_RING], 0.5), NUMBER_OF_VALUES / 2)) {
+        printf("Error: merged histograms are wrong\n");
+        return 1;
+    }
+    free(stages);
+
+    /* a header and one line per stage */
+    FILE *fp = fopen(REPORT_FILE, "w+");
+    if (fp == NULL || latency_report(fp) != 0) {
+        printf("Error: no report\n");
+        return 1;
+    }
+    rewind(fp);
+    char line[256];
+    int lines = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        lines++;
+    }
+    fclose(fp);
+    remove(REPORT_FILE);
+    if (lines != 1 + LATENCY_NUMBER_OF_STAGES) {
+        printf("Error: report has %d lines\n", lines);
+        return 1;
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include "../include/ringbuf.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <string.h>
+
+#define NUMBER_OF_STRINGS 20000
+#define NUMBER_OF_WRITERS 4
+#define NUMBER_OF_READERS 4
+#define BUF_SIZE 50  // bytes
+#define RBUF_SIZE 500  // bytes
+
+_Atomic int READ_COUNT = 0;
+_Atomic int WRITERS_DONE = 0;
+
+typedef struct {
+    rbctx_t *rb;
+    char** strings;
+    int responsible_for_from;
+    int responsible_for_to;
+} args_t;
+
+typedef struct {
+    rbctx_t *rb;
+    char** write_result;
+} args_reader_t;
+
+void *writer(void *arg)
+{
+    rbctx_t *rb = ((args_t *)arg)->rb;
+    char** strings = ((args_t *)arg)->strings;
+    int from = ((args_t *)arg)->responsible_for_from;
+    int to = ((args_t *)arg)->responsible_for_to;
+
+    for (int i = from; i < to; i++) {
+        size_t str_len = strlen(strings[i]) + 1;
+        while (ringbuffer_write(rb, strings[i], str_len) != SUCCESS) {
+            sched_yield();
+        }
+    }
+
+    WRITERS_DONE++;
+    return NULL;
+}
+
+void *reader(void *arg)
+{
+    rbctx_t *rbctx = ((args_reader_t *)arg)->rb;
+    char** write_result = ((args_reader_t *)arg)->write_result;
+
+    unsigned char buf[BUF_SIZE];
+    size_t read = BUF_SIZE;
+    for (;;) {
+        int status = ringbuffer_read(rbctx, buf, &read);
+        if (status == RINGBUFFER_EMPTY) {
+            if (WRITERS_DONE == NUMBER_OF_WRITERS && READ_COUNT == NUMBER_OF_STRINGS) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        assert(status == SUCCESS);
+
+        /* every reader claims its own slot of the result array */
+        int idx = READ_COUNT++;
+        assert(idx >= 0 && idx < NUMBER_OF_STRINGS);
+        write_result[idx] = malloc(read);
+        memcpy(write_result[idx], buf, read);
+
+        /* reset read */
+        read = BUF_SIZE;
+    }
+    return NULL;
+}
+
+/* nobody waits for a stalled record: later ones commit and consume past it, and show up once it is done */
+int check_out_of_order()
+{
+    static uint64_t memory[RBUF_SIZE / sizeof(uint64_t)];
+    rbctx_t rb;
+    rbspan_t first, second, peeked;
+    size_t len;
+    char buf[BUF_SIZE];
+
+    /* memory that looks like finished records of this lap is cleared first */
+    for (size_t i = 0; i < RBUF_SIZE / sizeof(uint64_t); i++) {
+        memory[i] = (i * sizeof(uint64_t)) | (i % 3);
+    }
+    ringbuffer_init_flags(&rb, memory, RBUF_SIZE, RBUF_MPMC);
+    size_t free_size = ringbuffer_available(&rb);
+
+    if (ringbuffer_reserve(&rb, 5, &first) != SUCCESS || ringbuffer_reserve(&rb, 6, &second) != SUCCESS) {
+        printf("Error: reserve failed\n");
+        return 1;
+    }
+    ringbuffer_span_copy_in(&second, 0, "second", 6);
+    ringbuffer_commit(&rb, &second, 6);
+    if (ringbuffer_peek(&rb, &peeked) != RINGBUFFER_EMPTY) {
+        printf("Error: record visible before the one in front of it\n");
+        return 1;
+    }
+    ringbuffer_span_copy_in(&first, 0, "first", 5);
+    ringbuffer_commit(&rb, &first, 5);
+
+    /* both are visible now, the second one is consumed first */
+    if (ringbuffer_peek(&rb, &first) != SUCCESS || ringbuffer_peek(&rb, &second) != SUCCESS ||
+        first.len[0] != 5 || memcmp(first.data[0], "first", 5) != 0 ||
+        second.len[0] != 6 || memcmp(second.data[0], "second", 6) != 0) {
+        printf("Error: records read out of order\n");
+        return 1;
+    }
+    size_t used = free_size - ringbuffer_available(&rb);
+    ringbuffer_consume(&rb, &second);
+    if (free_size - ringbuffer_available(&rb) != used) {
+        printf("Error: space given back before the record in front of it\n");
+        return 1;
+    }
+    ringbuffer_consume(&rb, &first);
+    len = sizeof(buf);
+    if (ringbuffer_available(&rb) != free_size || ringbuffer_read(&rb, buf, &len) != RINGBUFFER_EMPTY) {
+        printf("Error: space not given back\n");
+        return 1;
+    }
+    ringbuffer_destroy(&rb);
+    return 0;
+}
+
+int compare_strings(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+int main()
+{
+    if (check_out_of_order()) {
+        exit(1);
+    }
+
+    /* array of random strings */
+    char* strings[NUMBER_OF_STRINGS];
+    for (int i = 0; i < NUMBER_OF_STRINGS; i++) {
+        int len = rand() % BUF_SIZE;
+        char* str = malloc(len + 1);
+        if (str == NULL) {
+            printf("Error: malloc failed\n");
+            exit(1);
+        }
+        for (int j = 0; j < len; j++) {
+            str[j] = 'a' + (rand() % 26);
+        }
+        str[len] = '\0';
+        strings[i] = str;
+    }
+
+    /* initialize MPMC ringbuffer */
+    char* rbuf = malloc(RBUF_SIZE);
+    rbctx_t *ringbuffer_context = malloc(sizeof(rbctx_t));
+    if (rbuf == NULL || ringbuffer_context == NULL) {
+        printf("Error: malloc failed\n");
+        exit(1);
+    }
+    ringbuffer_init_flags(ringbuffer_context, rbuf, RBUF_SIZE, RBUF_MPMC);
+
+    /* each writer is responsible for one slice of the strings */
+    printf("creating %d writer and %d reader threads\n", NUMBER_OF_WRITERS, NUMBER_OF_READERS);
+    args_t w_args[NUMBER_OF_WRITERS];
+    pthread_t w_ids[NUMBER_OF_WRITERS];
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        w_args[i] = (args_t) {ringbuffer_context, (char**) strings,
+                              i * NUMBER_OF_STRINGS / NUMBER_OF_WRITERS, (i + 1) * NUMBER_OF_STRINGS / NUMBER_OF_WRITERS};
+        pthread_create(&w_ids[i], NULL, writer, &w_args[i]);
+    }
+
+    char* result_strings[NUMBER_OF_STRINGS];
+    args_reader_t r_args = {ringbuffer_context, (char**) result_strings};
+    pthread_t r_ids[NUMBER_OF_READERS];
+    for (int i = 0; i < NUMBER_OF_READERS; i++) {
+        pthread_create(&r_ids[i], NULL, reader, &r_args);
+    }
+
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        pthread_join(w_ids[i], NULL);
+    }
+    for (int i = 0; i < NUMBER_OF_READERS; i++) {
+        pthread_join(r_ids[i], NULL);
+    }
+
+    /****************************************************************
+    * COMPARE RESULTS
+    * every string has to be read exactly once
+    * ***************************************************************/
+
+    printf("comparing results\n");
+    if (READ_COUNT != NUMBER_OF_STRINGS) {
+        printf("Error: the incorrect number of strings was read\n");
+        exit(1);
+    }
+
+    qsort(strings, NUMBER_OF_STRINGS, sizeof(char *), compare_strings);
+    qsort(result_strings, NUMBER_OF_STRINGS, sizeof(char *), compare_strings);
+    for (int i = 0; i < NUMBER_OF_STRINGS; i++) {
+        if (strcmp(strings[i], result_strings[i]) != 0) {
+            printf("Error: string not found in results\n");
+            printf("String: %s\n", strings[i]);
+            exit(1);
+        }
+    }
+
+    /* free resources */
+    ringbuffer_destroy(ringbuffer_context);
+    free(rbuf);
+    free(ringbuffer_context);
+
+    for (int i = 0; i < NUMBER_OF_STRINGS; i++) {
+        free(strings[i]);
+        free(result_strings[i]);
+    }
+
+    printf("Test passed!\n");
+
+    return 0;
+}
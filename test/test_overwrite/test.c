@@ -0,0 +1,226 @@
+#include "../include/ringbuf.h"
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#define RBUF_SIZE 512  // bytes
+#define MSG_SIZE 32
+#define NUMBER_OF_MESSAGES 100
+#define NUMBER_OF_WRITERS 2
+#define NUMBER_OF_READERS 2
+#define MESSAGES_PER_WRITER 20000
+#define MAX_MSG_SIZE 64
+
+/* a message: who wrote it, its number, then bytes derived from both */
+typedef struct {
+    uint32_t writer;
+    uint32_t seq;
+} msg_header_t;
+
+static void fill_message(unsigned char *msg, size_t len, uint32_t writer, uint32_t seq)
+{
+    msg_header_t header = {writer, seq};
+    memcpy(msg, &header, sizeof(header));
+    for (size_t i = sizeof(header); i < len; i++) {
+        msg[i] = (unsigned char) (writer * 31 + seq + i);
+    }
+}
+
+static int check_message(const unsigned char *msg, size_t len, msg_header_t *header)
+{
+    memcpy(header, msg, sizeof(*header));
+    for (size_t i = sizeof(*header); i < len; i++) {
+        if (msg[i] != (unsigned char) (header->writer * 31 + header->seq + i)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int check_drop_oldest(int flags)
+{
+    rbctx_t rb;
+    unsigned char memory[RBUF_SIZE], msg[RBUF_SIZE + 1], read_buf[MSG_SIZE];
+    ringbuffer_init_flags(&rb, memory, RBUF_SIZE, flags | RBUF_OVERWRITE);
+
+    /* nobody reads, every write still succeeds */
+    for (uint32_t i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        fill_message(msg, MSG_SIZE, 0, i);
+        if (ringbuffer_write(&rb, msg, MSG_SIZE) != SUCCESS) {
+            printf("Error: write %u failed on an overwriting ring (flags %#x)\n", i, flags);
+            return 1;
+        }
+    }
+
+    /* what is left are the newest messages, the rest was counted as missed */
+    uint64_t missed = ringbuffer_missed(&rb);
+    uint32_t expected = (uint32_t) missed;
+    size_t read_len = MSG_SIZE;
+    msg_header_t header;
+    while (ringbuffer_read(&rb, read_buf, &read_len) == SUCCESS) {
+        if (check_message(read_buf, read_len, &header) || header.seq != expected) {
+            printf("Error: expected message %u, got %u (flags %#x)\n", expected, header.seq, flags);
+            return 1;
+        }
+        expected++;
+        read_len = MSG_SIZE;
+    }
+    rbstats_t stats;
+    ringbuffer_get_stats(&rb, &stats);
+    if (expected != NUMBER_OF_MESSAGES || missed == 0 || stats.evicted != missed || ringbuffer_missed(&rb) != 0) {
+        printf("Error: %llu missed, %llu evicted, read up to %u (flags %#x)\n",
+               (unsigned long long) missed, (unsigned long long) stats.evicted, expected, flags);
+        return 1;
+    }
+
+    /* a record being read is never dropped, the write gives up instead */
+    for (uint32_t i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        fill_message(msg, MSG_SIZE, 0, i);
+        ringbuffer_write(&rb, msg, MSG_SIZE);
+    }
+    rbspan_t span;
+    if (ringbuffer_peek(&rb, &span) != SUCCESS) {
+        printf("Error: nothing to peek (flags %#x)\n", flags);
+        return 1;
+    }
+    ringbuffer_span_copy_out(&span, 0, &header, sizeof(header));
+    uint32_t peeked = header.seq;
+    if (ringbuffer_write(&rb, msg, MSG_SIZE) != RINGBUFFER_FULL) {
+        printf("Error: write dropped a record that is being read (flags %#x)\n", flags);
+        return 1;
+    }
+    ringbuffer_span_copy_out(&span, 0, &header, sizeof(header));
+    if (header.seq != peeked) {
+        printf("Error: peeked record was overwritten (flags %#x)\n", flags);
+        return 1;
+    }
+    ringbuffer_consume(&rb, &span);
+    if (ringbuffer_write(&rb, msg, MSG_SIZE) != SUCCESS) {
+        printf("Error: write failed after the reader was done (flags %#x)\n", flags);
+        return 1;
+    }
+
+    /* nothing makes room for a message larger than the ring */
+    if (ringbuffer_write(&rb, msg, RBUF_SIZE + 1) != RINGBUFFER_FULL) {
+        printf("Error: oversized message did not fail (flags %#x)\n", flags);
+        return 1;
+    }
+
+    ringbuffer_destroy(&rb);
+    return 0;
+}
+
+typedef struct {
+    rbctx_t *rb;
+    uint32_t id;
+    _Atomic int *writers_done;
+    size_t dropped;     /* writer: RINGBUFFER_FULL, the message is given up */
+    size_t received;    /* reader */
+    int failed;
+} worker_t;
+
+void *writer(void *arg)
+{
+    worker_t *worker = arg;
+    unsigned char msg[MAX_MSG_SIZE];
+    for (uint32_t seq = 0; seq < MESSAGES_PER_WRITER; seq++) {
+        size_t len = sizeof(msg_header_t) + seq % (MAX_MSG_SIZE - sizeof(msg_header_t));
+        fill_message(msg, len, worker->id, seq);
+        if (ringbuffer_write(worker->rb, msg, len) != SUCCESS) {
+            worker->dropped++;
+        }
+    }
+    (*worker->writers_done)++;
+    return NULL;
+}
+
+void *reader(void *arg)
+{
+    worker_t *worker = arg;
+    unsigned char buf[MAX_MSG_SIZE];
+    int64_t last_seq[NUMBER_OF_WRITERS];
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        last_seq[i] = -1;
+    }
+
+    for (;;) {
+        size_t len = sizeof(buf);
+        int done = *worker->writers_done == NUMBER_OF_WRITERS;  // before the read, so empty then means drained
+        if (ringbuffer_read(worker->rb, buf, &len) != SUCCESS) {
+            if (done) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        /* torn messages would fail the pattern, records only ever skip forward */
+        msg_header_t header;
+        if (check_message(buf, len, &header) || header.writer >= NUMBER_OF_WRITERS ||
+            (int64_t) header.seq <= last_seq[header.writer]) {
+            worker->failed = 1;
+            break;
+        }
+        last_seq[header.writer] = header.seq;
+        worker->received++;
+    }
+    return NULL;
+}
+
+int check_concurrent(int flags)
+{
+    rbctx_t rb;
+    static unsigned char memory[RBUF_SIZE];
+    ringbuffer_init_flags(&rb, memory, RBUF_SIZE, flags | RBUF_OVERWRITE);
+
+    _Atomic int writers_done = 0;
+    worker_t writers[NUMBER_OF_WRITERS], readers[NUMBER_OF_READERS];
+    pthread_t writer_threads[NUMBER_OF_WRITERS], reader_threads[NUMBER_OF_READERS];
+    for (int i = 0; i < NUMBER_OF_READERS; i++) {
+        readers[i] = (worker_t) {.rb = &rb, .writers_done = &writers_done};
+        pthread_create(&reader_threads[i], NULL, reader, &readers[i]);
+    }
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        writers[i] = (worker_t) {.rb = &rb, .id = i, .writers_done = &writers_done};
+        pthread_create(&writer_threads[i], NULL, writer, &writers[i]);
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        pthread_join(writer_threads[i], NULL);
+        total += MESSAGES_PER_WRITER - writers[i].dropped;
+    }
+    for (int i = 0; i < NUMBER_OF_READERS; i++) {
+        pthread_join(reader_threads[i], NULL);
+        if (readers[i].failed) {
+            printf("Error: reader got a torn or reordered message (flags %#x)\n", flags);
+            return 1;
+        }
+        total -= readers[i].received;
+    }
+
+    /* every written message was either read or dropped to make room */
+    rbstats_t stats;
+    ringbuffer_get_stats(&rb, &stats);
+    if (total != stats.evicted || ringbuffer_missed(&rb) != stats.evicted) {
+        printf("Error: %zu messages unaccounted for, %llu evicted (flags %#x)\n",
+               total, (unsigned long long) stats.evicted, flags);
+        return 1;
+    }
+
+    ringbuffer_destroy(&rb);
+    return 0;
+}
+
+int main()
+{
+    int modes[] = {RBUF_LOCKED, RBUF_MPMC, RBUF_MPMC | RBUF_FRAME_VARINT, RBUF_LOCKED | RBUF_FRAME_ALIGNED};
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (check_drop_oldest(modes[i]) || check_concurrent(modes[i])) {
+            return 1;
+        }
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
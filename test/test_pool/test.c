@@ -0,0 +1,209 @@
+#include "../include/pool.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#define MAX_THREADS 8
+#define SCALE_AFTER_NS 1000000L
+
+typedef struct {
+    rbpool_t *pool;
+    int index;
+    _Atomic int running;    /* passes through the park check */
+} worker_t;
+
+void *worker(void *arg)
+{
+    worker_t *w = arg;
+    struct timespec deadline;
+    for (;;) {
+        ringbuffer_deadline(&deadline, 1000000);
+        if (pool_park(w->pool, w->index, &deadline) == SUCCESS) {
+            atomic_fetch_add(&w->running, 1);
+            usleep(100);
+        }
+        pthread_testcancel();
+    }
+    return NULL;
+}
+
+/* report the occupancy for a while, as the workers would */
+static void observe_for(rbpool_t *pool, unsigned int occupancy, long ns)
+{
+    for (long waited = 0; waited < ns; waited += 100000) {
+        pool_observe(pool, occupancy);
+        usleep(100);
+    }
+}
+
+/* did exactly workers 0 .. active-1 make progress in the last while */
+static int check_running(worker_t *workers, int active)
+{
+    for (int i = 0; i < MAX_THREADS; i++) {
+        atomic_store(&workers[i].running, 0);
+    }
+    usleep(20000);
+    for (int i = 0; i < MAX_THREADS; i++) {
+        if ((atomic_load(&workers[i].running) > 0) != (i < active)) {
+            printf("Error: worker %d is %s, %d should run\n", i, i < active ? "parked" : "running", active);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int stop(rbpool_t *pool)
+{
+    int started = pool_stop(pool);
+    for (int i = 0; i < started; i++) {
+        pthread_cancel(pool->threads[i]);
+        pthread_join(pool->threads[i], NULL);
+    }
+    pool_destroy(pool);
+    return started;
+}
+
+static void init_workers(rbpool_t *pool, worker_t *workers, void **args)
+{
+    for (int i = 0; i < MAX_THREADS; i++) {
+        workers[i].pool = pool;
+        workers[i].index = i;
+        atomic_init(&workers[i].running, 0);
+        args[i] = &workers[i];
+    }
+}
+
+int check_fixed()
+{
+    rbpool_t pool;
+    static worker_t workers[MAX_THREADS];
+    void *args[MAX_THREADS];
+    init_workers(&pool, workers, args);
+
+    rbpool_config_t config = {.min_threads = 3, .max_threads = 3, .scale_after_ns = SCALE_AFTER_NS};
+    if (pool_start(&pool, &config, worker, args) != SUCCESS) {
+        printf("Error: fixed pool did not start\n");
+        return 1;
+    }
+    observe_for(&pool, 100, 4 * SCALE_AFTER_NS);
+    if (pool_active(&pool) != 3 || check_running(workers, 3)) {
+        printf("Error: fixed pool changed its size\n");
+        return 1;
+    }
+    return stop(&pool) != 3;
+}
+
+int check_auto()
+{
+    rbpool_t pool;
+    static worker_t workers[MAX_THREADS];
+    void *args[MAX_THREADS];
+    init_workers(&pool, workers, args);
+
+    rbpool_config_t config = {.min_threads = 2, .max_threads = MAX_THREADS, .scale_after_ns = SCALE_AFTER_NS};
+    if (pool_start(&pool, &config, worker, args) != SUCCESS || check_running(workers, 2)) {
+        printf("Error: auto pool did not start with its minimum\n");
+        return 1;
+    }
+
+    /* occupancy between the water marks changes nothing, a short spike neither */
+    observe_for(&pool, 30, 4 * SCALE_AFTER_NS);
+    pool_observe(&pool, 90);
+    pool_observe(&pool, 30);
+    if (pool_active(&pool) != 2) {
+        printf("Error: auto pool scaled without sustained occupancy\n");
+        return 1;
+    }
+
+    /* sustained high occupancy adds workers one period at a time, up to the maximum */
+    observe_for(&pool, 90, 3 * SCALE_AFTER_NS);
+    if (pool_active(&pool) <= 2) {
+        printf("Error: auto pool did not grow\n");
+        return 1;
+    }
+    observe_for(&pool, 90, 20 * SCALE_AFTER_NS);
+    if (pool_active(&pool) != MAX_THREADS || check_running(workers, MAX_THREADS)) {
+        printf("Error: auto pool did not grow to its maximum\n");
+        return 1;
+    }
+
+    /* drained, the workers park down to the minimum and the threads stay */
+    observe_for(&pool, 0, 20 * SCALE_AFTER_NS);
+    if (pool_active(&pool) != 2 || check_running(workers, 2)) {
+        printf("Error: auto pool did not shrink to its minimum\n");
+        return 1;
+    }
+
+    /* parked workers are woken again instead of started twice */
+    observe_for(&pool, 100, 3 * SCALE_AFTER_NS);
+    if (pool_active(&pool) <= 2 || pool.started != MAX_THREADS) {
+        printf("Error: auto pool did not unpark its workers\n");
+        return 1;
+    }
+    return stop(&pool) != MAX_THREADS;
+}
+
+/* bytes of address space in use, from /proc/self/statm */
+static size_t address_space()
+{
+    unsigned long pages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        if (fscanf(statm, "%lu", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(statm);
+    }
+    return pages * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+int check_start_failure()
+{
+    rbpool_t pool;
+    static worker_t workers[MAX_THREADS];
+    void *args[MAX_THREADS];
+    init_workers(&pool, workers, args);
+
+    /* room for the stacks of about two workers, so starting all of them fails half way */
+    struct rlimit before, limited;
+    size_t used = address_space();
+    pthread_attr_t attr;
+    size_t stack_size = 0;
+    pthread_attr_init(&attr);
+    pthread_attr_getstacksize(&attr, &stack_size);
+    pthread_attr_destroy(&attr);
+    if (used == 0 || stack_size == 0 || getrlimit(RLIMIT_AS, &before) != 0) {
+        return 0;
+    }
+    limited = before;
+    limited.rlim_cur = used + 2 * stack_size + stack_size / 2;
+    if (limited.rlim_cur > before.rlim_max || setrlimit(RLIMIT_AS, &limited) != 0) {
+        return 0;
+    }
+    rbpool_config_t config = {.min_threads = MAX_THREADS, .max_threads = MAX_THREADS, .scale_after_ns = SCALE_AFTER_NS};
+    int status = pool_start(&pool, &config, worker, args);
+    setrlimit(RLIMIT_AS, &before);
+
+    if (status != RINGBUFFER_ALLOC_FAILED || pool.threads != NULL || pool.started != 0) {
+        printf("Error: failed start did not release the pool\n");
+        return 1;
+    }
+    /* the workers that did start are gone */
+    if (check_running(workers, 0)) {
+        printf("Error: failed start left workers running\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main()
+{
+    if (check_fixed() || check_auto() || check_start_failure()) {
+        return 1;
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
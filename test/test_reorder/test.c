@@ -0,0 +1,187 @@
+#include "../include/reorder.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define WINDOW_SIZE 16
+#define NUMBER_OF_IDS 20000
+#define NUMBER_OF_THREADS 8
+#define GAP_TIMEOUT_NS 2000000L
+
+/* what the sink saw */
+typedef struct {
+    uint64_t ids[NUMBER_OF_IDS];
+    size_t count;
+    int failed;
+} collected_t;
+
+static void collect(void *arg, uint64_t id, const void *data, size_t len)
+{
+    collected_t *collected = arg;
+    uint64_t stored;
+    memcpy(&stored, data, sizeof(stored));
+    if (len != sizeof(stored) || stored != id || collected->count >= NUMBER_OF_IDS ||
+        (collected->count > 0 && collected->ids[collected->count - 1] >= id)) {
+        collected->failed = 1;
+        return;
+    }
+    collected->ids[collected->count++] = id;
+}
+
+static int insert(rbreorder_t *window, uint64_t id)
+{
+    return reorder_insert(window, id, &id, sizeof(id));
+}
+
+int check_shuffled()
+{
+    rbreorder_t window;
+    static collected_t collected;
+    memset(&collected, 0, sizeof(collected));
+    reorder_init(&window, WINDOW_SIZE, sizeof(uint64_t), RBUF_REORDER_WAIT, 0, collect, &collected);
+
+    /* each block of the window's size arrives backwards, every third id has no record */
+    for (uint64_t block = 0; block < 100; block++) {
+        for (uint64_t i = WINDOW_SIZE; i-- > 0;) {
+            uint64_t id = block * WINDOW_SIZE + i;
+            if (id % 3 == 0 ? reorder_skip(&window, id) : insert(&window, id)) {
+                printf("Error: insert of %llu failed\n", (unsigned long long) id);
+                return 1;
+            }
+        }
+    }
+    if (collected.failed || collected.count != 100 * WINDOW_SIZE - (100 * WINDOW_SIZE + 2) / 3 ||
+        window.base != 100 * WINDOW_SIZE || window.skipped != 0) {
+        printf("Error: shuffled records came out wrong\n");
+        return 1;
+    }
+    reorder_destroy(&window);
+    return 0;
+}
+
+typedef struct {
+    rbreorder_t *window;
+    _Atomic uint64_t *next;
+} worker_t;
+
+void *worker(void *arg)
+{
+    worker_t *w = arg;
+    for (;;) {
+        uint64_t id = atomic_fetch_add(w->next, 1);
+        if (id >= NUMBER_OF_IDS) {
+            break;
+        }
+        if (id % 7 == 0) {
+            usleep(id % 50);  // some take longer, so the ones after them overtake
+        }
+        if (id % 11 == 0) {
+            reorder_skip(w->window, id);
+        } else {
+            insert(w->window, id);
+        }
+    }
+    return NULL;
+}
+
+int check_threads()
+{
+    rbreorder_t window;
+    static collected_t collected;
+    memset(&collected, 0, sizeof(collected));
+    reorder_init(&window, WINDOW_SIZE, sizeof(uint64_t), RBUF_REORDER_WAIT, 0, collect, &collected);
+
+    _Atomic uint64_t next = 0;
+    worker_t workers[NUMBER_OF_THREADS];
+    pthread_t threads[NUMBER_OF_THREADS];
+    for (int i = 0; i < NUMBER_OF_THREADS; i++) {
+        workers[i] = (worker_t) {.window = &window, .next = &next};
+        pthread_create(&threads[i], NULL, worker, &workers[i]);
+    }
+    for (int i = 0; i < NUMBER_OF_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    if (collected.failed || collected.count != NUMBER_OF_IDS - (NUMBER_OF_IDS + 10) / 11 || window.pending != 0) {
+        printf("Error: records processed in parallel came out wrong\n");
+        return 1;
+    }
+    reorder_destroy(&window);
+    return 0;
+}
+
+int check_gaps()
+{
+    rbreorder_t window;
+    static collected_t collected;
+
+    /* a full window gives up on the id it waits for, which then comes too late */
+    memset(&collected, 0, sizeof(collected));
+    reorder_init(&window, WINDOW_SIZE, sizeof(uint64_t), RBUF_REORDER_SKIP_FULL, 0, collect, &collected);
+    for (uint64_t id = 1; id <= WINDOW_SIZE; id++) {
+        insert(&window, id);
+    }
+    if (collected.count != WINDOW_SIZE || window.skipped != 1 || insert(&window, 0) != REORDER_LATE) {
+        printf("Error: full window did not skip the gap\n");
+        return 1;
+    }
+    /* far ahead, the window moves just far enough to hold it */
+    insert(&window, 1000);
+    if (collected.count != WINDOW_SIZE || window.base != 1000 - (WINDOW_SIZE - 1) || collected.failed) {
+        printf("Error: window did not move to a far id\n");
+        return 1;
+    }
+    reorder_destroy(&window);
+
+    /* records wait for a missing id until the timeout */
+    memset(&collected, 0, sizeof(collected));
+    reorder_init(&window, WINDOW_SIZE, sizeof(uint64_t), RBUF_REORDER_SKIP_AFTER, GAP_TIMEOUT_NS,
+                 collect, &collected);
+    insert(&window, 1);
+    insert(&window, 2);
+    reorder_poll(&window);
+    if (collected.count != 0) {
+        printf("Error: gap skipped before its timeout\n");
+        return 1;
+    }
+    usleep(2 * GAP_TIMEOUT_NS / 1000);
+    reorder_poll(&window);
+    if (collected.count != 2 || window.skipped != 1) {
+        printf("Error: gap not skipped after its timeout\n");
+        return 1;
+    }
+    /* an insert beyond the full window waits out the gap instead of blocking for good */
+    for (uint64_t id = 4; id <= WINDOW_SIZE + 3; id++) {
+        insert(&window, id);
+    }
+    if (collected.count != WINDOW_SIZE + 2 || window.skipped != 2 || collected.failed) {
+        printf("Error: blocked insert did not skip the gap\n");
+        return 1;
+    }
+    reorder_destroy(&window);
+
+    /* a flush delivers what is left */
+    memset(&collected, 0, sizeof(collected));
+    reorder_init(&window, WINDOW_SIZE, sizeof(uint64_t), RBUF_REORDER_WAIT, 0, collect, &collected);
+    insert(&window, 0);
+    insert(&window, 2);
+    insert(&window, 5);
+    reorder_flush(&window);
+    if (collected.count != 3 || window.base != 6 || window.skipped != 3 || collected.failed) {
+        printf("Error: flush left records behind\n");
+        return 1;
+    }
+    reorder_destroy(&window);
+    return 0;
+}
+
+int main()
+{
+    if (check_shuffled() || check_threads() || check_gaps()) {
+        return 1;
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "../include/route.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+#define NUMBER_OF_ROUTES 3000
+#define NUMBER_OF_READERS 3
+#define NUMBER_OF_SWAPS 200
+#define MAX_SINKS 8
+
+int check_table()
+{
+    rbrouter_t router;
+    uint32_t sinks[MAX_SINKS];
+    if (route_init(&router) != SUCCESS || route_lookup(&router, 80, sinks, MAX_SINKS) != 0) {
+        printf("Error: new router has routes\n");
+        return 1;
+    }
+
+    /* one port fans out to its sinks in order, the ends of the port range work */
+    rbroute_t routes[] = {{80, 1}, {443, 7}, {80, 2}, {0, 5}, {65535, 6}, {80, 3}};
+    if (route_set(&router, routes, sizeof(routes) / sizeof(routes[0])) != SUCCESS) {
+        printf("Error: set failed\n");
+        return 1;
+    }
+    if (route_lookup(&router, 80, sinks, MAX_SINKS) != 3 || sinks[0] != 1 || sinks[1] != 2 || sinks[2] != 3 ||
+        route_lookup(&router, 0, sinks, MAX_SINKS) != 1 || sinks[0] != 5 ||
+        route_lookup(&router, 65535, sinks, MAX_SINKS) != 1 || sinks[0] != 6 ||
+        route_lookup(&router, 81, sinks, MAX_SINKS) != 0) {
+        printf("Error: wrong sinks\n");
+        return 1;
+    }
+    /* too little room: the count says how many there are */
+    sinks[1] = 99;
+    if (route_lookup(&router, 80, sinks, 1) != 3 || sinks[0] != 1 || sinks[1] != 99) {
+        printf("Error: lookup wrote past its room\n");
+        return 1;
+    }
+
+    /* many routes, each still one lookup */
+    static rbroute_t many[NUMBER_OF_ROUTES];
+    for (uint32_t i = 0; i < NUMBER_OF_ROUTES; i++) {
+        many[i] = (rbroute_t) {.port = (uint16_t) (i * 21), .sink = i};
+    }
+    route_set(&router, many, NUMBER_OF_ROUTES);
+    for (uint32_t i = 0; i < NUMBER_OF_ROUTES; i++) {
+        if (route_lookup(&router, (uint16_t) (i * 21), sinks, MAX_SINKS) != 1 || sinks[0] != i) {
+            printf("Error: route %u lost\n", i);
+            return 1;
+        }
+    }
+    if (route_lookup(&router, 80, sinks, MAX_SINKS) != 0) {
+        printf("Error: old routes survived the swap\n");
+        return 1;
+    }
+    route_destroy(&router);
+    return 0;
+}
+
+typedef struct {
+    rbrouter_t *router;
+    _Atomic int *done;
+    int failed;
+    size_t lookups;
+} reader_t;
+
+/* the two tables the writer swaps between */
+static const rbroute_t table_a[] = {{1000, 1}, {1000, 2}};
+static const rbroute_t table_b[] = {{1000, 3}, {1000, 4}, {1000, 5}, {2000, 9}};
+
+void *reader(void *arg)
+{
+    reader_t *r = arg;
+    uint32_t sinks[MAX_SINKS];
+    while (!atomic_load(r->done)) {
+        size_t count = route_lookup(r->router, 1000, sinks, MAX_SINKS);
+        int is_a = count == 2 && sinks[0] == 1 && sinks[1] == 2;
+        int is_b = count == 3 && sinks[0] == 3 && sinks[1] == 4 && sinks[2] == 5;
+        if (!is_a && !is_b) {
+            r->failed = 1;
+        }
+        r->lookups++;
+    }
+    return NULL;
+}
+
+int check_swap()
+{
+    rbrouter_t router;
+    route_init(&router);
+    route_set(&router, table_a, 2);
+
+    /* lookups during reconfiguration see one table or the other, never a mix or a freed one */
+    _Atomic int done = 0;
+    reader_t readers[NUMBER_OF_READERS];
+    pthread_t threads[NUMBER_OF_READERS];
+    for (int i = 0; i < NUMBER_OF_READERS; i++) {
+        readers[i] = (reader_t) {.router = &router, .done = &done};
+        pthread_create(&threads[i], NULL, reader, &readers[i]);
+    }
+    for (int swap = 0; swap < NUMBER_OF_SWAPS; swap++) {
+        if (swap % 2 == 0 ? route_set(&router, table_b, 4) : route_set(&router, table_a, 2)) {
+            printf("Error: swap failed\n");
+            return 1;
+        }
+    }
+    atomic_store(&done, 1);
+    for (int i = 0; i < NUMBER_OF_READERS; i++) {
+        pthread_join(threads[i], NULL);
+        if (readers[i].failed || readers[i].lookups == 0) {
+            printf("Error: a lookup saw a torn table\n");
+            return 1;
+        }
+    }
+    route_destroy(&router);
+    return 0;
+}
+
+int main()
+{
+    if (check_table() || check_swap()) {
+        return 1;
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,254 @@
+#include "../include/rules.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PORT 128
+#define MAX_LEN 200
+#define RANDOM_ROUNDS 20000
+
+/* the checks validate() had hard-coded */
+static int old_ports_allowed(size_t from, size_t to)
+{
+    return !(from == to || from == 42 || to == 42 || (from + to) == 42);
+}
+
+static int has_substring(const unsigned char *data, size_t len, const unsigned char *pattern, size_t pattern_len)
+{
+    for (size_t i = 0; i + pattern_len <= len; i++) {
+        if (memcmp(data + i, pattern, pattern_len) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int has_subsequence(const unsigned char *data, size_t len, const unsigned char *pattern, size_t pattern_len)
+{
+    size_t matched = 0;
+    for (size_t i = 0; i < len && matched < pattern_len; i++) {
+        matched += data[i] == pattern[matched];
+    }
+    return matched == pattern_len;
+}
+
+typedef struct {
+    const char *text;
+    int subsequence;
+} pattern_t;
+
+static int compile(rbrules_t *rules, const char *text)
+{
+    char error[256];
+    if (rules_compile(rules, text, MAX_PORT, error, sizeof(error)) != SUCCESS) {
+        printf("Error: rules rejected: %s\n", error);
+        return 1;
+    }
+    return 0;
+}
+
+int check_default_ports()
+{
+    rbrules_t rules;
+    if (compile(&rules, "port same\nport either 42\nport sum 42\nsubsequence malicious\n")) {
+        return 1;
+    }
+    for (size_t from = 0; from <= MAX_PORT + 1; from++) {
+        for (size_t to = 0; to <= MAX_PORT + 1; to++) {
+            int expected = from <= MAX_PORT && to <= MAX_PORT && old_ports_allowed(from, to);
+            if (rules_ports_allowed(&rules, from, to) != expected) {
+                printf("Error: ports %zu -> %zu %s\n", from, to, expected ? "dropped" : "let through");
+                return 1;
+            }
+        }
+    }
+    const char *payloads[] = {"hello", "mxaxlxixcxixoxuxs", "maliciou", "suoicilam", ""};
+    int allowed[] = {1, 0, 1, 1, 1};
+    for (size_t i = 0; i < sizeof(payloads) / sizeof(payloads[0]); i++) {
+        if (rules_allowed(&rules, 1, 11, (const unsigned char *) payloads[i], strlen(payloads[i])) != allowed[i]) {
+            printf("Error: payload \"%s\" filtered wrong\n", payloads[i]);
+            return 1;
+        }
+    }
+    rules_destroy(&rules);
+    return 0;
+}
+
+/* the automaton agrees with checking every pattern on its own, whole and in pieces */
+static int check_patterns(const pattern_t *patterns, size_t count)
+{
+    char text[1024] = "";
+    for (size_t p = 0; p < count; p++) {
+        strcat(text, patterns[p].subsequence ? "subsequence " : "substring ");
+        strcat(text, patterns[p].text);
+        strcat(text, "\n");
+    }
+    rbrules_t rules;
+    if (compile(&rules, text)) {
+        return 1;
+    }
+
+    unsigned char data[MAX_LEN];
+    for (int round = 0; round < RANDOM_ROUNDS; round++) {
+        size_t len = rand() % MAX_LEN;
+        for (size_t i = 0; i < len; i++) {
+            // mostly bytes of the patterns, so they match now and then
+            const char *source = patterns[rand() % count].text;
+            data[i] = rand() % 8 == 0 ? (unsigned char) rand() : (unsigned char) source[rand() % strlen(source)];
+        }
+        int expected = 0;
+        for (size_t p = 0; p < count && !expected; p++) {
+            const unsigned char *pattern = (const unsigned char *) patterns[p].text;
+            expected = patterns[p].subsequence ? has_subsequence(data, len, pattern, strlen(patterns[p].text)) :
+                       has_substring(data, len, pattern, strlen(patterns[p].text));
+        }
+        uint32_t whole = rules_scan(&rules, RBUF_RULES_START, data, len);
+        size_t split = len > 0 ? rand() % len : 0;
+        uint32_t pieces = rules_scan(&rules, RBUF_RULES_START, data, split);
+        pieces = rules_scan(&rules, pieces, data + split, len - split);
+        if ((whole == RBUF_RULES_MATCH) != expected || pieces != whole) {
+            printf("Error: automaton of %zu patterns disagrees on a %zu byte payload\n", count, len);
+            return 1;
+        }
+    }
+    rules_destroy(&rules);
+    return 0;
+}
+
+int check_content()
+{
+    srand(7);
+    pattern_t single[] = {{"malicious", 1}};
+    pattern_t substrings[] = {{"he", 0}, {"she", 0}, {"his", 0}, {"hers", 0}};
+    pattern_t mixed[] = {{"malicious", 1}, {"exploit", 1}, {"abab", 0}, {"bab", 0}, {"aaa", 0}, {"xyz", 1}};
+    if (check_patterns(single, 1) || check_patterns(substrings, 4) || check_patterns(mixed, 6)) {
+        return 1;
+    }
+    return 0;
+}
+
+/* a pattern split over pieces of a stream is found in the piece that completes it */
+int check_stream()
+{
+    rbrules_t rules;
+    if (compile(&rules, "substring attack\nsubsequence xyz\n")) {
+        return 1;
+    }
+    const char *pieces[] = {"an att", "ack here", "att", "ack", "at", "tack", "x..", "y..", "z", "no"};
+    int allowed[] = {1, 0, 1, 0, 1, 0, 1, 1, 0, 1};
+    uint32_t state = RBUF_RULES_START;
+    for (size_t i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++) {
+        const unsigned char *piece = (const unsigned char *) pieces[i];
+        if (rules_stream(&rules, &state, piece, strlen(pieces[i])) != allowed[i] ||
+            rules_scan(&rules, RBUF_RULES_START, piece, strlen(pieces[i])) == RBUF_RULES_MATCH) {
+            printf("Error: piece %zu of the stream filtered wrong\n", i);
+            return 1;
+        }
+    }
+
+    /* streamed in packets of every size, a stream matches where the whole payload does */
+    unsigned char data[MAX_LEN];
+    for (int round = 0; round < RANDOM_ROUNDS; round++) {
+        size_t len = rand() % MAX_LEN;
+        for (size_t i = 0; i < len; i++) {
+            data[i] = (unsigned char) "attckxyz"[rand() % 8];
+        }
+        size_t packet = 1 + rand() % 16, first_drop = len;
+        state = RBUF_RULES_START;
+        for (size_t offset = 0; offset < len && first_drop == len; offset += packet) {
+            size_t piece = len - offset < packet ? len - offset : packet;
+            if (!rules_stream(&rules, &state, data + offset, piece)) {
+                first_drop = offset;
+            }
+        }
+        // the first dropped packet is the one in which the whole payload's first match ends
+        size_t end = 0;
+        while (end < len && rules_scan(&rules, RBUF_RULES_START, data, end + 1) != RBUF_RULES_MATCH) {
+            end++;
+        }
+        if (end == len ? first_drop != len : first_drop != end / packet * packet) {
+            printf("Error: stream dropped packet at %zu, the match ends at %zu\n", first_drop, end);
+            return 1;
+        }
+    }
+    rules_destroy(&rules);
+    return 0;
+}
+
+int check_file()
+{
+    rbrules_t rules;
+    char error[256];
+    if (rules_load(&rules, "test/test_rules/rules.txt", MAX_PORT, error, sizeof(error)) != SUCCESS) {
+        printf("Error: rule file rejected: %s\n", error);
+        return 1;
+    }
+    const char *dropped[] = {"x; DROP TABLE users", "a\0\xff", "back\\slash", "e.x.p.l.o.i.t"};
+    size_t dropped_len[] = {19, 3, 10, 13};
+    for (size_t i = 0; i < 4; i++) {
+        if (rules_allowed(&rules, 1, 11, (const unsigned char *) dropped[i], dropped_len[i])) {
+            printf("Error: payload %zu of the rule file let through\n", i);
+            return 1;
+        }
+    }
+    if (!rules_allowed(&rules, 1, 11, (const unsigned char *) "DROP\0TABLE", 10) ||
+        rules_ports_allowed(&rules, 101, 5) || !rules_ports_allowed(&rules, 5, 101) ||
+        rules.port_rules != 4 || rules.content_rules != 5) {
+        printf("Error: rule file compiled wrong\n");
+        return 1;
+    }
+    rules_destroy(&rules);
+
+    if (rules_load(&rules, "test/test_rules/missing.txt", MAX_PORT, error, sizeof(error)) != RULES_INVALID) {
+        printf("Error: missing rule file accepted\n");
+        return 1;
+    }
+    return 0;
+}
+
+int check_errors()
+{
+    const char *invalid[] = {
+        "port same\nfilter everything\n",
+        "port from 129\n",
+        "port to 5-3\n",
+        "port either\n",
+        "port same 4\n",
+        "port sideways 1\n",
+        "substring \\q\n",
+        "subsequence \n",
+        /* the progress of eight subsequences makes more than 65536 states */
+        "subsequence abcdefgh\nsubsequence ijklmnop\nsubsequence qrstuvwx\nsubsequence ABCDEFGH\n"
+        "subsequence IJKLMNOP\nsubsequence QRSTUVWX\nsubsequence 01234567\nsubsequence 89!?+-*/\n",
+    };
+    const char *messages[] = {"line 2:", "line 1:", "line 1:", "line 1:", "line 1:", "line 1:", "line 1:", "line 1:",
+                              "automaton states"};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        rbrules_t rules;
+        char error[256];
+        if (rules_compile(&rules, invalid[i], MAX_PORT, error, sizeof(error)) != RULES_INVALID ||
+            strstr(error, messages[i]) == NULL) {
+            printf("Error: rules %zu not rejected as expected: %s\n", i, error);
+            return 1;
+        }
+    }
+
+    /* no rules let everything through */
+    rbrules_t rules;
+    if (compile(&rules, "# nothing\n\n") || !rules_allowed(&rules, 3, 3, (const unsigned char *) "x", 1)) {
+        printf("Error: empty rules dropped a packet\n");
+        return 1;
+    }
+    rules_destroy(&rules);
+    return 0;
+}
+
+int main()
+{
+    if (check_default_ports() || check_content() || check_stream() || check_file() || check_errors()) {
+        return 1;
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "../include/scan.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LEN 300
+#define RANDOM_ROUNDS 200000
+
+static const char pattern[] = "malicious";
+#define PATTERN_LEN (sizeof(pattern) - 1)
+
+static const char *impl_names[] = {"scalar", "sse2", "avx2"};
+
+/* every supported implementation agrees with the scalar one, from every starting match
+ * and with the message scanned whole or in two pieces */
+static int check(const unsigned char *data, size_t len)
+{
+    for (int impl = RBUF_SCAN_SSE2; impl <= RBUF_SCAN_AVX2; impl++) {
+        if (!ringbuffer_scan_supported(impl)) {
+            continue;
+        }
+        for (size_t matched = 0; matched <= PATTERN_LEN; matched++) {
+            size_t expected = ringbuffer_scan_subsequence_with(RBUF_SCAN_SCALAR, data, len, pattern, PATTERN_LEN, matched);
+            size_t got = ringbuffer_scan_subsequence_with(impl, data, len, pattern, PATTERN_LEN, matched);
+            if (got != expected) {
+                printf("Error: %s found %zu of the pattern in %zu bytes from %zu, scalar %zu\n",
+                       impl_names[impl], got, len, matched, expected);
+                return 1;
+            }
+        }
+        /* and the jump to the next of a few bytes */
+        static const unsigned char sets[][RBUF_SCAN_MAX_FIND] = {"m", "sx", "\0\xffs", "acim"};
+        static const size_t counts[] = {1, 2, 3, 4};
+        for (size_t set = 0; set < sizeof(sets) / sizeof(sets[0]); set++) {
+            size_t count = counts[set];
+            if (ringbuffer_scan_find_with(impl, data, len, sets[set], count) !=
+                ringbuffer_scan_find_with(RBUF_SCAN_SCALAR, data, len, sets[set], count)) {
+                printf("Error: %s found another first byte of set %zu\n", impl_names[impl], set);
+                return 1;
+            }
+        }
+        size_t split = len / 3;
+        size_t whole = ringbuffer_scan_subsequence_with(impl, data, len, pattern, PATTERN_LEN, 0);
+        size_t first = ringbuffer_scan_subsequence_with(impl, data, split, pattern, PATTERN_LEN, 0);
+        if (ringbuffer_scan_subsequence_with(impl, data + split, len - split, pattern, PATTERN_LEN, first) != whole) {
+            printf("Error: %s gave another result for a split message\n", impl_names[impl]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* bytes drawn from the pattern's characters and a few others, so partial matches are common */
+static void random_message(unsigned char *data, size_t len)
+{
+    static const char alphabet[] = "maliciousMALxyz\0\xff\x80";
+    for (size_t i = 0; i < len; i++) {
+        data[i] = rand() % 4 == 0 ? (unsigned char) (rand() & 0xff) : (unsigned char) alphabet[rand() % (sizeof(alphabet) - 1)];
+    }
+}
+
+int check_random()
+{
+    unsigned char data[MAX_LEN];
+    srand(42);
+    for (int round = 0; round < RANDOM_ROUNDS; round++) {
+        size_t len = rand() % MAX_LEN;
+        random_message(data, len);
+        if (check(data, len)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int check_adversarial()
+{
+    unsigned char data[MAX_LEN + 64];
+
+    /* the pattern's characters at every offset around the vector boundaries, with and without
+     * one of them missing, at every alignment of the message */
+    for (size_t offset = 0; offset < 64; offset++) {
+        for (size_t len = 0; len <= MAX_LEN; len++) {
+            unsigned char *msg = data + offset % 32;
+            memset(msg, 'x', len);
+            for (size_t i = 0; i < PATTERN_LEN && i * (offset + 1) < len; i++) {
+                msg[i * (offset + 1)] = pattern[i];
+            }
+            if (check(msg, len)) {
+                return 1;
+            }
+            if (len > 0) {
+                msg[len - 1] = 's';     // the last character only at the very end
+                if (check(msg, len)) {
+                    return 1;
+                }
+            }
+        }
+    }
+
+    /* the whole message is one wanted character, or the pattern backwards */
+    memset(data, 'm', MAX_LEN);
+    if (check(data, MAX_LEN)) {
+        return 1;
+    }
+    for (size_t i = 0; i < MAX_LEN; i++) {
+        data[i] = pattern[PATTERN_LEN - 1 - i % PATTERN_LEN];
+    }
+    if (check(data, MAX_LEN)) {
+        return 1;
+    }
+
+    /* known answers */
+    const char *found = "xxmxxaxxlxxixxcxxixxoxxuxxsxx";
+    const char *missing = "suoicilam malicioux";
+    if (ringbuffer_scan_subsequence((const unsigned char *) found, strlen(found), pattern, PATTERN_LEN, 0) != PATTERN_LEN ||
+        ringbuffer_scan_subsequence((const unsigned char *) missing, strlen(missing), pattern, PATTERN_LEN, 0) != PATTERN_LEN - 1) {
+        printf("Error: wrong result for a known message\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main()
+{
+    if (check_random() || check_adversarial()) {
+        return 1;
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include "../include/ringbuf.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#define BUF_SIZE 30
+
+int check_files(const char *file1, const char *file2) {
+    FILE *fp1 = fopen(file1, "r");
+    if (fp1 == NULL) {
+        fprintf(stderr, "Cannot open file with name %s\n", file1);
+        return 1;
+    }
+    FILE *fp2 = fopen(file2, "r");
+    if (fp2 == NULL) {
+        fprintf(stderr, "Cannot open file with name %s\n", file2);
+        return 1;
+    }
+
+    int c1, c2;
+    while ((c1 = fgetc(fp1)) != EOF) {
+        c2 = fgetc(fp2);
+        if (c1 != c2) {
+            fclose(fp1);
+            fclose(fp2);
+            return 1;
+        }
+    }
+    c2 = fgetc(fp2);
+
+    fclose(fp1);
+    fclose(fp2);
+    return c2 != EOF;
+}
+
+/* the producer process: the file in random sized chunks, an empty message at the end */
+void produce(rbctx_t *ringbuffer_context, const char *src)
+{
+    FILE *fp_src = fopen(src, "r");
+    if (fp_src == NULL) {
+        fprintf(stderr, "Cannot open file with name %s\n", src);
+        exit(1);
+    }
+
+    unsigned char buf[BUF_SIZE];
+    size_t read;
+    do {
+        read = fread(buf, sizeof(*buf), (rand() % BUF_SIZE) + 1, fp_src);
+        if (ringbuffer_write_wait(ringbuffer_context, buf, read, NULL) != SUCCESS) {
+            printf("Error: write failed\n");
+            exit(1);
+        }
+    } while (read > 0);
+
+    fclose(fp_src);
+}
+
+/* the consumer process */
+void consume(rbctx_t *ringbuffer_context, const char *dst)
+{
+    FILE *fp_dst = fopen(dst, "w");
+    if (fp_dst == NULL) {
+        fprintf(stderr, "Cannot open file with name %s\n", dst);
+        exit(1);
+    }
+
+    unsigned char buf[BUF_SIZE];
+    size_t buf_len;
+    do {
+        buf_len = BUF_SIZE;
+        if (ringbuffer_read_wait(ringbuffer_context, buf, &buf_len, NULL) != SUCCESS) {
+            printf("Error: read failed\n");
+            exit(1);
+        }
+        fwrite(buf, sizeof(*buf), buf_len, fp_dst);
+    } while (buf_len > 0);
+
+    fclose(fp_dst);
+}
+
+/* round trip the file from a child process to this one, the child attaches by name or inherits the ring */
+int check_mode(const char *src, const char *dst, size_t rbuf_size, int flags, int by_name)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/ringbuffer-test-%d", (int) getpid());
+
+    rbctx_t ringbuffer_context;
+    if (ringbuffer_shm_create(&ringbuffer_context, by_name ? name : NULL, rbuf_size, flags) != SUCCESS) {
+        printf("Error: cannot create shared ring\n");
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        printf("Error: fork failed\n");
+        return 1;
+    }
+    if (pid == 0) {
+        rbctx_t attached;
+        if (by_name) {
+            if (ringbuffer_shm_attach(&attached, name) != SUCCESS) {
+                printf("Error: cannot attach to %s\n", name);
+                exit(1);
+            }
+            produce(&attached, src);
+            ringbuffer_destroy(&attached);
+        } else {
+            produce(&ringbuffer_context, src);
+        }
+        exit(0);
+    }
+
+    consume(&ringbuffer_context, dst);
+    int status;
+    waitpid(pid, &status, 0);
+    ringbuffer_destroy(&ringbuffer_context);
+    if (by_name) {
+        ringbuffer_shm_unlink(name);
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("Error: producer failed\n");
+        return 1;
+    }
+    if (check_files(src, dst) != 0) {
+        printf("Error: files are not the same (flags %#x%s)\n", flags, by_name ? ", attached by name" : "");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "Too few arguments. Usage %s src_file dst_file\n", argv[0]);
+        exit(1);
+    }
+
+    FILE *fp_src = fopen(argv[1], "r");
+    if (fp_src == NULL) {
+        fprintf(stderr, "Cannot open file with name %s\n", argv[1]);
+        exit(1);
+    }
+    fseek(fp_src, 0, SEEK_END);
+    long file_src_size = ftell(fp_src);
+    fclose(fp_src);
+
+    /* a small ring, so the processes wait on each other and the ring wraps */
+    size_t rbuf_size = MAX((size_t)(BUF_SIZE + 2 * sizeof(size_t)), (size_t) (file_src_size / 16));
+
+    int modes[3] = {RBUF_MPMC, RBUF_SPSC | RBUF_FRAME_VARINT, RBUF_MPMC | RBUF_FRAME_VARINT | RBUF_FRAME_ALIGNED};
+    for (int i = 0; i < 3; i++) {
+        if (check_mode(argv[1], argv[2], rbuf_size, modes[i], 0) != 0 ||
+            check_mode(argv[1], argv[2], rbuf_size, modes[i], 1) != 0) {
+            exit(1);
+        }
+    }
+
+    /* attaching checks the header */
+    rbctx_t ringbuffer_context;
+    if (ringbuffer_shm_attach(&ringbuffer_context, "/ringbuffer-test-missing") != RINGBUFFER_ALLOC_FAILED) {
+        printf("Error: attached to a ring that doesn't exist\n");
+        exit(1);
+    }
+    int fd = shm_open("/ringbuffer-test-garbage", O_RDWR | O_CREAT, 0600);
+    if (fd < 0 || ftruncate(fd, 4096) != 0) {
+        printf("Error: cannot create shared memory\n");
+        exit(1);
+    }
+    close(fd);
+    int status = ringbuffer_shm_attach(&ringbuffer_context, "/ringbuffer-test-garbage");
+    ringbuffer_shm_unlink("/ringbuffer-test-garbage");
+    if (status != RINGBUFFER_INCOMPATIBLE) {
+        printf("Error: attached to memory without a ring header\n");
+        exit(1);
+    }
+
+    printf("Test passed! Files are the same\n");
+    return 0;
+}
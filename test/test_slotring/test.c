@@ -0,0 +1,201 @@
+#include "../include/ringbuf.h"
+#include "../include/slotring.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <string.h>
+
+#ifdef SLOTRING_SLOT_SIZE
+#define SLOT_SIZE SLOTRING_SLOT_SIZE    // the build fixed it, see the Makefile
+#else
+#define SLOT_SIZE 50  // bytes
+#endif
+#define SLOT_COUNT 8
+#define NUMBER_OF_MESSAGES 20000
+#define NUMBER_OF_WRITERS 4
+#define NUMBER_OF_READERS 4
+
+#define CHECK(cond, msg) do { if (!(cond)) { printf("Error: %s\n", msg); exit(1); } } while (0)
+
+_Atomic int READ_COUNT = 0;
+_Atomic int WRITERS_DONE = 0;
+_Atomic int SEEN[NUMBER_OF_MESSAGES];
+
+void test_slots(void *memory, size_t memory_size)
+{
+    slotring_t ring;
+    char buf[SLOT_SIZE];
+    size_t len;
+    uint64_t ticket;
+
+    /* memory for 8.5 slots holds 8 of them */
+    CHECK(slotring_init(&ring, memory, memory_size + slotring_memory_size(1, SLOT_SIZE) / 2, SLOT_SIZE) == SUCCESS,
+          "init failed");
+    CHECK(ring.mask + 1 == SLOT_COUNT, "slot count is not the largest power of two");
+    CHECK(slotring_init(&ring, memory, slotring_memory_size(1, SLOT_SIZE) - 1, SLOT_SIZE) == RINGBUFFER_ALLOC_FAILED,
+          "init without room for a slot");
+    slotring_init(&ring, memory, memory_size, SLOT_SIZE);
+
+    /* fill, overflow and drain in order, three laps */
+    for (int lap = 0; lap < 3; lap++) {
+        for (int i = 0; i < SLOT_COUNT; i++) {
+            CHECK(slotring_write(&ring, &i, sizeof(i)) == SUCCESS, "write into a free slot failed");
+        }
+        CHECK(slotring_write(&ring, "x", 1) == RINGBUFFER_FULL, "write into a full ring");
+        for (int i = 0; i < SLOT_COUNT; i++) {
+            int value;
+            len = sizeof(value);
+            CHECK(slotring_read(&ring, &value, &len) == SUCCESS && len == sizeof(value) && value == i,
+                  "wrong message read");
+        }
+        len = SLOT_SIZE;
+        CHECK(slotring_read(&ring, buf, &len) == RINGBUFFER_EMPTY, "read from an empty ring");
+    }
+
+    /* a too small buffer leaves the message in the ring */
+    slotring_write(&ring, "hello", 6);
+    len = 3;
+    CHECK(slotring_read(&ring, buf, &len) == OUTPUT_BUFFER_TOO_SMALL && len == 6, "too small buffer not reported");
+    len = SLOT_SIZE;
+    CHECK(slotring_read(&ring, buf, &len) == SUCCESS && strcmp(buf, "hello") == 0, "message lost after too small read");
+
+    /* cancelled slots are skipped, batches are all or nothing */
+    CHECK(slotring_reserve(&ring, 1, &ticket) == SUCCESS, "reserve failed");
+    slotring_commit(&ring, ticket, SLOTRING_CANCELLED);
+    slotring_write(&ring, "after", 6);
+    len = SLOT_SIZE;
+    CHECK(slotring_read(&ring, buf, &len) == SUCCESS && strcmp(buf, "after") == 0, "cancelled slot not skipped");
+    slotring_write(&ring, "one", 4);
+    CHECK(slotring_reserve(&ring, SLOT_COUNT, &ticket) == RINGBUFFER_FULL, "batch larger than the free slots");
+    CHECK(slotring_reserve(&ring, SLOT_COUNT - 1, &ticket) == SUCCESS, "batch of the free slots failed");
+}
+
+void test_adapter(void *memory, size_t memory_size)
+{
+    slotring_t ring;
+    rbctx_t rb;
+    rbspan_t span;
+    char buf[SLOT_SIZE * SLOT_COUNT];
+
+    slotring_init(&ring, memory, memory_size, SLOT_SIZE);
+    ringbuffer_init_slotring(&rb, &ring);
+
+    /* reserve/commit/cancel and peek/consume */
+    CHECK(ringbuffer_reserve(&rb, SLOT_SIZE, &span) == SUCCESS && span.len[0] == SLOT_SIZE && span.len[1] == 0,
+          "slot span is not one piece");
+    ringbuffer_span_copy_in(&span, 0, "slot", 5);
+    ringbuffer_commit(&rb, &span, 5);
+    CHECK(ringbuffer_reserve(&rb, 10, &span) == SUCCESS, "second reserve failed");
+    ringbuffer_cancel(&rb, &span);
+    ringbuffer_write(&rb, "next", 5);
+
+    CHECK(ringbuffer_peek(&rb, &span) == SUCCESS && span.len[0] == 5 && strcmp((char *) span.data[0], "slot") == 0,
+          "peek returned the wrong slot");
+    ringbuffer_consume(&rb, &span);
+    size_t len = sizeof(buf);
+    CHECK(ringbuffer_read(&rb, buf, &len) == SUCCESS && len == 5 && strcmp(buf, "next") == 0, "cancelled slot read");
+
+    /* batches */
+    struct iovec in[SLOT_COUNT + 1], out[SLOT_COUNT];
+    char texts[SLOT_COUNT + 1][8];
+    for (int i = 0; i <= SLOT_COUNT; i++) {
+        snprintf(texts[i], sizeof(texts[i]), "msg %d", i);
+        in[i].iov_base = texts[i];
+        in[i].iov_len = strlen(texts[i]) + 1;
+    }
+    CHECK(ringbuffer_write_batch(&rb, in, SLOT_COUNT + 1) == RINGBUFFER_FULL, "batch larger than the ring");
+    CHECK(ringbuffer_write_batch(&rb, in, SLOT_COUNT) == SUCCESS, "batch write failed");
+    size_t count;
+    CHECK(ringbuffer_read_batch(&rb, buf, sizeof(buf), out, SLOT_COUNT, &count) == SUCCESS && count == SLOT_COUNT,
+          "batch read failed");
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        CHECK(strcmp(out[i].iov_base, texts[i]) == 0, "batch read out of order");
+    }
+
+    ringbuffer_destroy(&rb);
+}
+
+void *writer(void *arg)
+{
+    rbctx_t *rb = arg;
+    for (;;) {
+        static _Atomic int next = 0;
+        int i = next++;
+        if (i >= NUMBER_OF_MESSAGES) {
+            break;
+        }
+        ringbuffer_write_wait(rb, &i, sizeof(i), NULL);
+    }
+    WRITERS_DONE++;
+    return NULL;
+}
+
+void *reader(void *arg)
+{
+    rbctx_t *rb = arg;
+    for (;;) {
+        int value;
+        size_t len = sizeof(value);
+        struct timespec deadline;
+        ringbuffer_deadline(&deadline, 1000000L);
+        if (ringbuffer_read_wait(rb, &value, &len, &deadline) != SUCCESS) {
+            if (WRITERS_DONE == NUMBER_OF_WRITERS && READ_COUNT == NUMBER_OF_MESSAGES) {
+                break;
+            }
+            continue;
+        }
+        CHECK(len == sizeof(value) && value >= 0 && value < NUMBER_OF_MESSAGES, "corrupt message");
+        CHECK(SEEN[value]++ == 0, "message read twice");
+        READ_COUNT++;
+    }
+    return NULL;
+}
+
+void test_threaded(void *memory, size_t memory_size)
+{
+    slotring_t ring;
+    rbctx_t rb;
+
+    slotring_init(&ring, memory, memory_size, SLOT_SIZE);
+    ringbuffer_init_slotring(&rb, &ring);
+
+    printf("creating %d writer and %d reader threads\n", NUMBER_OF_WRITERS, NUMBER_OF_READERS);
+    pthread_t w_ids[NUMBER_OF_WRITERS], r_ids[NUMBER_OF_READERS];
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        pthread_create(&w_ids[i], NULL, writer, &rb);
+    }
+    for (int i = 0; i < NUMBER_OF_READERS; i++) {
+        pthread_create(&r_ids[i], NULL, reader, &rb);
+    }
+    for (int i = 0; i < NUMBER_OF_WRITERS; i++) {
+        pthread_join(w_ids[i], NULL);
+    }
+    for (int i = 0; i < NUMBER_OF_READERS; i++) {
+        pthread_join(r_ids[i], NULL);
+    }
+
+    CHECK(READ_COUNT == NUMBER_OF_MESSAGES, "the incorrect number of messages was read");
+    ringbuffer_destroy(&rb);
+}
+
+int main()
+{
+    size_t memory_size = slotring_memory_size(SLOT_COUNT, SLOT_SIZE);
+    uint64_t *memory = malloc(memory_size + slotring_memory_size(1, SLOT_SIZE));
+    if (memory == NULL) {
+        printf("Error: malloc failed\n");
+        exit(1);
+    }
+#ifdef SLOTRING_SLOT_SIZE
+    CHECK(SLOTRING_STRIDE == slotring_memory_size(1, SLOT_SIZE), "compile time stride differs");
+    CHECK(sizeof(slotring_len_t) == (SLOT_SIZE <= 0xfe ? 1 : 2), "wrong slot length type");
+#endif
+
+    test_slots(memory, memory_size);
+    test_adapter(memory, memory_size);
+    test_threaded(memory, memory_size);
+
+    free(memory);
+    printf("Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include "../include/steal.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define DEQUE_SIZE 64
+#define NUMBER_OF_THREADS 8
+#define NUMBER_OF_TASKS 100000
+#define TASKS_PER_PUSH 16
+
+typedef struct {
+    size_t index;
+    _Atomic int runs;
+} task_t;
+
+static task_t tasks[NUMBER_OF_TASKS];
+
+int check_single()
+{
+    rbsteal_t exec;
+    if (steal_init(&exec, 2, DEQUE_SIZE - 1, NULL) != SUCCESS) {
+        printf("Error: init failed\n");
+        return 1;
+    }
+
+    /* the owner gets its newest task, a thief the oldest */
+    for (size_t i = 0; i < DEQUE_SIZE; i++) {
+        if (steal_push(&exec, 0, &tasks[i]) != SUCCESS) {
+            printf("Error: push %zu failed\n", i);
+            return 1;
+        }
+    }
+    if (steal_push(&exec, 0, &tasks[DEQUE_SIZE]) != RINGBUFFER_FULL) {
+        printf("Error: full deque took another task\n");
+        return 1;
+    }
+    if (steal_pop(&exec, 0) != &tasks[DEQUE_SIZE - 1] || steal_oldest(&exec, 1) != &tasks[0] ||
+        steal_oldest(&exec, 0) != NULL || steal_pop(&exec, 1) != NULL) {
+        printf("Error: tasks taken from the wrong end\n");
+        return 1;
+    }
+
+    /* take goes to the other deque once the own one is empty */
+    size_t taken = 0;
+    while (steal_take(&exec, 1) != NULL) {
+        taken++;
+    }
+    if (taken != DEQUE_SIZE - 2 || exec.deques[0].stolen != DEQUE_SIZE - 1 || steal_take(&exec, 0) != NULL) {
+        printf("Error: take got %zu tasks\n", taken);
+        return 1;
+    }
+
+    /* the positions keep going around the deque */
+    for (size_t i = 0; i < 10 * DEQUE_SIZE; i++) {
+        steal_push(&exec, 1, &tasks[i]);
+        if (steal_pop(&exec, 1) != &tasks[i]) {
+            printf("Error: task lost after wrapping\n");
+            return 1;
+        }
+    }
+    steal_destroy(&exec);
+    return 0;
+}
+
+typedef struct {
+    rbsteal_t *exec;
+    int index;
+    _Atomic size_t *done;
+    size_t ran;
+} worker_t;
+
+static void run(worker_t *w, task_t *task)
+{
+    atomic_fetch_add(&task->runs, 1);
+    w->ran++;
+    atomic_fetch_add(w->done, 1);
+}
+
+/* worker 0 produces every task and takes long for some of them, the others only steal */
+void *worker(void *arg)
+{
+    worker_t *w = arg;
+    size_t next = 0;
+    while (atomic_load(w->done) < NUMBER_OF_TASKS) {
+        if (w->index == 0 && next < NUMBER_OF_TASKS) {
+            for (int i = 0; i < TASKS_PER_PUSH && next < NUMBER_OF_TASKS; i++) {
+                if (steal_push(w->exec, 0, &tasks[next]) != SUCCESS) {
+                    break;
+                }
+                next++;
+            }
+        }
+        task_t *task = steal_take(w->exec, w->index);
+        if (task == NULL) {
+            continue;
+        }
+        if (w->index == 0 && task->index % 64 == 0) {
+            usleep(10);
+        }
+        run(w, task);
+    }
+    return NULL;
+}
+
+int check_threads()
+{
+    rbsteal_t exec;
+    if (steal_init(&exec, NUMBER_OF_THREADS, DEQUE_SIZE, NULL) != SUCCESS) {
+        printf("Error: init failed\n");
+        return 1;
+    }
+    for (size_t i = 0; i < NUMBER_OF_TASKS; i++) {
+        tasks[i].index = i;
+        atomic_init(&tasks[i].runs, 0);
+    }
+
+    _Atomic size_t done = 0;
+    worker_t workers[NUMBER_OF_THREADS];
+    pthread_t threads[NUMBER_OF_THREADS];
+    for (int i = 0; i < NUMBER_OF_THREADS; i++) {
+        workers[i] = (worker_t) {.exec = &exec, .index = i, .done = &done, .ran = 0};
+        pthread_create(&threads[i], NULL, worker, &workers[i]);
+    }
+    for (int i = 0; i < NUMBER_OF_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    /* every task ran exactly once, and the slow producer had help */
+    for (size_t i = 0; i < NUMBER_OF_TASKS; i++) {
+        if (atomic_load(&tasks[i].runs) != 1) {
+            printf("Error: task %zu ran %d times\n", i, atomic_load(&tasks[i].runs));
+            return 1;
+        }
+    }
+    if (workers[0].ran == NUMBER_OF_TASKS || exec.deques[0].stolen != NUMBER_OF_TASKS - workers[0].ran) {
+        printf("Error: no tasks were stolen\n");
+        return 1;
+    }
+    steal_destroy(&exec);
+    return 0;
+}
+
+int main()
+{
+    if (check_single() || check_threads()) {
+        return 1;
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "../include/ringbuf.h"
+#include "../include/trace.h"
+#include <stdio.h>
+#include <pthread.h>
+#include <string.h>
+
+#define NUMBER_OF_MESSAGES 100
+#define RBUF_SIZE 500  // bytes
+#define TRACE_FILE "/tmp/test_trace.bin"
+
+void *writer(void *arg)
+{
+    rbctx_t *rb = arg;
+    for (int i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        ringbuffer_write_wait(rb, &i, sizeof(i), NULL);
+    }
+    return NULL;
+}
+
+int main()
+{
+    char* rbuf = malloc(RBUF_SIZE);
+    rbctx_t *ringbuffer_context = malloc(sizeof(rbctx_t));
+    if (rbuf == NULL || ringbuffer_context == NULL) {
+        printf("Error: malloc failed\n");
+        exit(1);
+    }
+    ringbuffer_init(ringbuffer_context, rbuf, RBUF_SIZE);
+
+    /* nothing is recorded while tracing is off */
+    int msg = 0;
+    size_t msg_len = sizeof(msg);
+    ringbuffer_write(ringbuffer_context, &msg, sizeof(msg));
+    ringbuffer_read(ringbuffer_context, &msg, &msg_len);
+
+    /* one writer thread and the main thread as reader each fill their own trace ring */
+    trace_set_level(TRACE_DEBUG);
+    pthread_t w_id;
+    pthread_create(&w_id, NULL, writer, ringbuffer_context);
+    for (int i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        msg_len = sizeof(msg);
+        if (ringbuffer_read_wait(ringbuffer_context, &msg, &msg_len, NULL) != SUCCESS || msg != i) {
+            printf("Error: read failed\n");
+            exit(1);
+        }
+    }
+    pthread_join(w_id, NULL);
+    trace_set_level(TRACE_OFF);
+
+    if (trace_dump(TRACE_FILE) != 0) {
+        printf("Error: cannot write %s\n", TRACE_FILE);
+        exit(1);
+    }
+
+    /****************************************************************
+    * CHECK THE DUMP
+    * every message was committed once by the writer thread
+    * and claimed and released once by the reader thread
+    * ***************************************************************/
+
+    FILE *fp = fopen(TRACE_FILE, "rb");
+    trace_file_header_t header;
+    if (fp == NULL || fread(&header, sizeof(header), 1, fp) != 1 || header.event_size != sizeof(trace_event_t)) {
+        printf("Error: bad trace file header\n");
+        exit(1);
+    }
+
+    int counts[TRACE_NUMBER_OF_EVENTS] = {0};
+    int number_of_threads = 0;
+    trace_file_thread_t thread;
+    while (fread(&thread, sizeof(thread), 1, fp) == 1) {
+        number_of_threads++;
+        for (uint64_t i = 0; i < thread.number_of_events; i++) {
+            trace_event_t event;
+            if (fread(&event, sizeof(event), 1, fp) != 1 || event.event >= TRACE_NUMBER_OF_EVENTS || event.thread != thread.thread) {
+                printf("Error: bad trace event\n");
+                exit(1);
+            }
+            counts[event.event]++;
+        }
+    }
+    fclose(fp);
+    remove(TRACE_FILE);
+
+    if (number_of_threads != 2) {
+        printf("Error: expected 2 traced threads, got %d\n", number_of_threads);
+        exit(1);
+    }
+    if (counts[TRACE_WRITE_COMMIT] != NUMBER_OF_MESSAGES || counts[TRACE_READ_CLAIM] != NUMBER_OF_MESSAGES ||
+        counts[TRACE_READ_RELEASE] != NUMBER_OF_MESSAGES) {
+        printf("Error: expected %d commits, claims and releases, got %d %d %d\n", NUMBER_OF_MESSAGES,
+               counts[TRACE_WRITE_COMMIT], counts[TRACE_READ_CLAIM], counts[TRACE_READ_RELEASE]);
+        exit(1);
+    }
+
+    ringbuffer_destroy(ringbuffer_context);
+    free(rbuf);
+    free(ringbuffer_context);
+
+    printf("Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "../include/ringbuf.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BATCH 4
+#define RBUF_SIZE 150  // bytes, holds about two batches
+
+int check_mode(int flags) {
+    char *msg[BATCH] = {"first", "second message", "third", "and the fourth one"};
+    struct iovec batch[BATCH];
+    size_t batch_len = 0;
+    for (int i = 0; i < BATCH; i++) {
+        batch[i].iov_base = msg[i];
+        batch[i].iov_len = strlen(msg[i]) + 1;
+        batch_len += batch[i].iov_len;
+    }
+
+    char* rbuf = malloc(RBUF_SIZE);
+    rbctx_t *ringbuffer_context = malloc(sizeof(rbctx_t));
+    if (rbuf == NULL || ringbuffer_context == NULL) {
+        printf("Error: malloc failed\n");
+        exit(1);
+    }
+    ringbuffer_init_flags(ringbuffer_context, rbuf, RBUF_SIZE, flags);
+
+    for (int round = 0; round < 10; round++) {
+        /* the second batch doesn't fit as a whole, so nothing of it may be written */
+        if (ringbuffer_write_batch(ringbuffer_context, batch, BATCH) != SUCCESS) {
+            printf("Error: batch write failed\n");
+            return 1;
+        }
+        if (ringbuffer_write_batch(ringbuffer_context, batch, BATCH) != RINGBUFFER_FULL) {
+            printf("Error: batch write should not fit\n");
+            return 1;
+        }
+
+        char read_buf[RBUF_SIZE];
+        struct iovec read[BATCH];
+        size_t count;
+
+        /* a buffer too small for the first message */
+        if (ringbuffer_read_batch(ringbuffer_context, read_buf, 2, read, BATCH, &count) != OUTPUT_BUFFER_TOO_SMALL) {
+            printf("Error: read should not fit\n");
+            return 1;
+        }
+
+        /* limited by the number of messages, then by the buffer size */
+        if (ringbuffer_read_batch(ringbuffer_context, read_buf, sizeof(read_buf), read, 1, &count) != SUCCESS ||
+            count != 1 || strcmp(read[0].iov_base, msg[0]) != 0) {
+            printf("Error: first message does not match\n");
+            return 1;
+        }
+        if (ringbuffer_read_batch(ringbuffer_context, read_buf, batch_len - batch[0].iov_len - 1, read, BATCH, &count) != SUCCESS ||
+            count != 2) {
+            printf("Error: expected two messages, got %zu\n", count);
+            return 1;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (read[i].iov_len != batch[i + 1].iov_len || strcmp(read[i].iov_base, msg[i + 1]) != 0) {
+                printf("Error: read message does not match\n");
+                return 1;
+            }
+        }
+        if (ringbuffer_read_batch(ringbuffer_context, read_buf, sizeof(read_buf), read, BATCH, &count) != SUCCESS ||
+            count != 1 || strcmp(read[0].iov_base, msg[3]) != 0) {
+            printf("Error: last message does not match\n");
+            return 1;
+        }
+        if (ringbuffer_read_batch(ringbuffer_context, read_buf, sizeof(read_buf), read, BATCH, &count) != RINGBUFFER_EMPTY) {
+            printf("Error: ringbuffer should be empty\n");
+            return 1;
+        }
+    }
+
+    ringbuffer_destroy(ringbuffer_context);
+    free(rbuf);
+    free(ringbuffer_context);
+    return 0;
+}
+
+int main()
+{
+    if (check_mode(RBUF_LOCKED) != 0 || check_mode(RBUF_MPMC) != 0) {
+        exit(1);
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
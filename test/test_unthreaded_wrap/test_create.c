@@ -0,0 +1,61 @@
+#include "../include/ringbuf.h"
+#include <stdio.h>
+#include <string.h>
+
+#define NUMBER_OF_MESSAGES 10000
+#define BUF_SIZE 1000
+#define RBUF_SIZE 5000  // bytes, not a multiple of the page size
+
+int check_create(int flags)
+{
+    rbctx_t ringbuffer_context;
+    if (ringbuffer_create(&ringbuffer_context, RBUF_SIZE, flags) != SUCCESS) {
+        printf("Error: could not create ringbuffer with flags %#x\n", flags);
+        return 1;
+    }
+    size_t expected_size = flags & RBUF_FRAME_ALIGNED ? RBUF_SIZE - RBUF_SIZE % RBUF_CACHE_LINE : RBUF_SIZE;
+    if ((uintptr_t) ringbuffer_context.begin % 4096 != 0 || ringbuffer_context.size != expected_size) {
+        printf("Error: unexpected ring memory\n");
+        return 1;
+    }
+
+    /* messages wrap around the end of the ring many times */
+    unsigned char msg[BUF_SIZE], read_buf[BUF_SIZE];
+    for (int i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        size_t msg_len = (rand() % BUF_SIZE) + 1;
+        for (size_t j = 0; j < msg_len; j++) {
+            msg[j] = (unsigned char) rand();
+        }
+
+        size_t read_len = BUF_SIZE;
+        if (ringbuffer_write(&ringbuffer_context, msg, msg_len) != SUCCESS ||
+            ringbuffer_read(&ringbuffer_context, read_buf, &read_len) != SUCCESS ||
+            read_len != msg_len || memcmp(msg, read_buf, msg_len) != 0) {
+            printf("Error: round trip failed with flags %#x\n", flags);
+            return 1;
+        }
+    }
+
+    ringbuffer_free(&ringbuffer_context);
+    return 0;
+}
+
+int main()
+{
+    int flags[6] = {
+        RBUF_LOCKED,
+        RBUF_MPMC | RBUF_FRAME_ALIGNED,
+        RBUF_SPSC | RBUF_PREFAULT,
+        RBUF_LOCKED | RBUF_HUGE_PAGES,
+        RBUF_MPMC | RBUF_HUGE_PAGES | RBUF_PREFAULT | RBUF_FRAME_VARINT,
+        RBUF_LOCKED | RBUF_MLOCK,
+    };
+    for (int i = 0; i < 6; i++) {
+        if (check_create(flags[i]) != 0) {
+            exit(1);
+        }
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "../include/ringbuf.h"
+#include <stdio.h>
+#include <string.h>
+
+#define NUMBER_OF_MESSAGES 5000
+#define BUF_SIZE 200
+#define RBUF_SIZE 1000  // bytes
+
+/* the reader side expects exactly the sequence of messages the writer side produced */
+unsigned char expected[NUMBER_OF_MESSAGES][BUF_SIZE];
+size_t expected_len[NUMBER_OF_MESSAGES];
+
+void random_message(int i)
+{
+    expected_len[i] = rand() % 4 == 0 ? rand() % BUF_SIZE : rand() % 16;
+    for (size_t j = 0; j < expected_len[i]; j++) {
+        expected[i][j] = (unsigned char) rand();
+    }
+}
+
+/* write message i with one of the write paths */
+int write_message(rbctx_t *rb, int i)
+{
+    rbspan_t span;
+    switch (i % 3) {
+    case 0:
+        return ringbuffer_write(rb, expected[i], expected_len[i]);
+    case 1: {
+        /* reserve more than needed and throw a reservation away in between */
+        if (ringbuffer_reserve(rb, 3, &span) != SUCCESS) {
+            return RINGBUFFER_FULL;
+        }
+        ringbuffer_cancel(rb, &span);
+        if (ringbuffer_reserve(rb, expected_len[i] + 5, &span) != SUCCESS) {
+            return RINGBUFFER_FULL;
+        }
+        ringbuffer_span_copy_in(&span, 0, expected[i], expected_len[i]);
+        ringbuffer_commit(rb, &span, expected_len[i]);
+        return SUCCESS;
+    }
+    default: {
+        struct iovec batch = {expected[i], expected_len[i]};
+        return ringbuffer_write_batch(rb, &batch, 1);
+    }
+    }
+}
+
+int check_mode(int flags)
+{
+    char* rbuf = malloc(RBUF_SIZE);
+    rbctx_t *ringbuffer_context = malloc(sizeof(rbctx_t));
+    if (rbuf == NULL || ringbuffer_context == NULL) {
+        printf("Error: malloc failed\n");
+        exit(1);
+    }
+    ringbuffer_init_flags(ringbuffer_context, rbuf + 3, RBUF_SIZE - 3, flags);
+
+    int written = 0, read = 0;
+    while (read < NUMBER_OF_MESSAGES) {
+        /* fill the ring, then drain part of it */
+        while (written < NUMBER_OF_MESSAGES && write_message(ringbuffer_context, written) == SUCCESS) {
+            written++;
+        }
+
+        int to_read = (rand() % 5) + 1;
+        for (int k = 0; k < to_read && read < written; k++, read++) {
+            rbspan_t span;
+            unsigned char buf[BUF_SIZE];
+            if (ringbuffer_peek(ringbuffer_context, &span) != SUCCESS) {
+                printf("Error: peek failed for message %d, flags %x\n", read, flags);
+                return 1;
+            }
+            if ((flags & RBUF_FRAME_ALIGNED) && ((uintptr_t) span.data[0] - span.header_len) % RBUF_CACHE_LINE != 0) {
+                printf("Error: record is not cache line aligned, flags %x\n", flags);
+                return 1;
+            }
+            size_t len = ringbuffer_span_copy_out(&span, 0, buf, sizeof(buf));
+            ringbuffer_consume(ringbuffer_context, &span);
+            if (len != expected_len[read] || memcmp(buf, expected[read], len) != 0) {
+                printf("Error: message %d does not match, flags %x\n", read, flags);
+                return 1;
+            }
+        }
+    }
+
+    ringbuffer_destroy(ringbuffer_context);
+    free(rbuf);
+    free(ringbuffer_context);
+    return 0;
+}
+
+/* number of 10 byte messages that fit into an empty ring */
+int capacity(int flags)
+{
+    char rbuf[RBUF_SIZE];
+    char msg[10] = {0};
+    rbctx_t ringbuffer_context;
+    ringbuffer_init_flags(&ringbuffer_context, rbuf, RBUF_SIZE, flags);
+    int count = 0;
+    while (ringbuffer_write(&ringbuffer_context, msg, sizeof(msg)) == SUCCESS) {
+        count++;
+    }
+    ringbuffer_destroy(&ringbuffer_context);
+    return count;
+}
+
+int main()
+{
+    for (int i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        random_message(i);
+    }
+
+    int framings[4] = {RBUF_FRAME_FIXED, RBUF_FRAME_VARINT, RBUF_FRAME_FIXED | RBUF_FRAME_ALIGNED, RBUF_FRAME_VARINT | RBUF_FRAME_ALIGNED};
+    for (int i = 0; i < 4; i++) {
+        if (check_mode(RBUF_LOCKED | framings[i]) != 0 || check_mode(RBUF_MPMC | framings[i]) != 0 ||
+            check_mode(RBUF_SPSC | framings[i]) != 0) {
+            exit(1);
+        }
+    }
+
+    /* a 1 byte header instead of 8 */
+    if (capacity(RBUF_FRAME_VARINT) != RBUF_SIZE / 11 || capacity(RBUF_FRAME_FIXED) != RBUF_SIZE / 18) {
+        printf("Error: unexpected capacity %d (varint) / %d (fixed)\n", capacity(RBUF_FRAME_VARINT), capacity(RBUF_FRAME_FIXED));
+        exit(1);
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "../include/ringbuf.h"
+#include <stdio.h>
+#include <string.h>
+
+#define NUMBER_OF_MESSAGES 10000
+#define BUF_SIZE 1000
+
+int main()
+{
+    rbctx_t *ringbuffer_context = malloc(sizeof(rbctx_t));
+    if (ringbuffer_context == NULL) {
+        printf("Error: malloc failed\n");
+        exit(1);
+    }
+    if (ringbuffer_create_mirrored(ringbuffer_context, 1, RBUF_LOCKED) != SUCCESS) {
+        printf("Error: could not map mirrored ringbuffer\n");
+        exit(1);
+    }
+
+    /* random sized messages, so records and headers land on every offset across the end */
+    unsigned char msg[BUF_SIZE], read_buf[BUF_SIZE];
+    size_t wrapped = 0;
+    for (int i = 0; i < NUMBER_OF_MESSAGES; i++) {
+        size_t msg_len = (rand() % BUF_SIZE) + 1;
+        for (size_t j = 0; j < msg_len; j++) {
+            msg[j] = (unsigned char) rand();
+        }
+
+        if (ringbuffer_write(ringbuffer_context, msg, msg_len) != SUCCESS) {
+            printf("Error: write failed\n");
+            exit(1);
+        }
+
+        rbspan_t span;
+        if (ringbuffer_peek(ringbuffer_context, &span) != SUCCESS) {
+            printf("Error: peek failed\n");
+            exit(1);
+        }
+        if (span.len[1] != 0 || span.len[0] != msg_len) {
+            printf("Error: message is not contiguous\n");
+            exit(1);
+        }
+        if (span.data[0] + msg_len > ringbuffer_context->begin + ringbuffer_context->size) {
+            wrapped++;
+        }
+        memcpy(read_buf, span.data[0], msg_len);
+        ringbuffer_consume(ringbuffer_context, &span);
+
+        if (memcmp(msg, read_buf, msg_len) != 0) {
+            printf("Error: read message does not match\n");
+            exit(1);
+        }
+    }
+
+    if (wrapped == 0) {
+        printf("Error: no message crossed the end of the ring\n");
+        exit(1);
+    }
+
+    ringbuffer_destroy(ringbuffer_context);
+    free(ringbuffer_context);
+
+    printf("Test passed!\n");
+    return 0;
+}
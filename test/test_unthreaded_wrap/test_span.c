@@ -0,0 +1,83 @@
+#include "../include/ringbuf.h"
+#include <stdio.h>
+#include <string.h>
+
+int check_mode(int flags) {
+    char msg[] = "Hello World. Nice to meet you.";
+    size_t msg_len = strlen(msg) + 1; // include the null terminator
+    size_t rbuf_size = msg_len + sizeof(size_t) + 10; // plenty of wrap arounds
+    if (flags & RBUF_MPMC) {
+        rbuf_size += 2 * sizeof(uint64_t); // the commit word and the alignment of records
+    }
+
+    char* rbuf = malloc(rbuf_size);
+    rbctx_t *ringbuffer_context = malloc(sizeof(rbctx_t));
+    if (rbuf == NULL || ringbuffer_context == NULL) {
+        printf("Error: malloc failed\n");
+        exit(1);
+    }
+    ringbuffer_init_flags(ringbuffer_context, rbuf, rbuf_size, flags);
+
+    int wraps = 0;
+    for (int round = 0; round < 10; round++) {
+        /* reserve more than needed, write into the ring memory and commit what was used */
+        rbspan_t span;
+        if (ringbuffer_reserve(ringbuffer_context, msg_len + 4, &span) != SUCCESS) {
+            printf("Error: reserve failed\n");
+            return 1;
+        }
+        wraps += span.len[1] > 0;
+        ringbuffer_span_copy_in(&span, 0, msg, msg_len);
+        ringbuffer_commit(ringbuffer_context, &span, msg_len);
+
+        /* the ring is full now, a cancelled reservation is not seen by readers */
+        if (ringbuffer_reserve(ringbuffer_context, msg_len, &span) != RINGBUFFER_FULL) {
+            printf("Error: reserve should fail on a full ring\n");
+            return 1;
+        }
+
+        rbspan_t peeked;
+        if (ringbuffer_peek(ringbuffer_context, &peeked) != SUCCESS) {
+            printf("Error: peek failed\n");
+            return 1;
+        }
+        char read_buf[sizeof(msg)];
+        if (peeked.len[0] + peeked.len[1] != msg_len ||
+            ringbuffer_span_copy_out(&peeked, 0, read_buf, sizeof(read_buf)) != msg_len ||
+            strcmp(msg, read_buf) != 0) {
+            printf("Error: peeked message does not match\n");
+            return 1;
+        }
+        ringbuffer_consume(ringbuffer_context, &peeked);
+
+        if (ringbuffer_reserve(ringbuffer_context, 4, &span) != SUCCESS) {
+            printf("Error: reserve failed\n");
+            return 1;
+        }
+        ringbuffer_cancel(ringbuffer_context, &span);
+        if (ringbuffer_peek(ringbuffer_context, &peeked) != RINGBUFFER_EMPTY) {
+            printf("Error: cancelled reservation was read\n");
+            return 1;
+        }
+    }
+
+    if (wraps == 0) {
+        printf("Error: no reservation wrapped around\n");
+        return 1;
+    }
+
+    ringbuffer_destroy(ringbuffer_context);
+    free(rbuf);
+    free(ringbuffer_context);
+    return 0;
+}
+
+int main()
+{
+    if (check_mode(RBUF_LOCKED) != 0 || check_mode(RBUF_MPMC) != 0) {
+        exit(1);
+    }
+
+    printf("Test passed!\n");
+    return 0;
+}
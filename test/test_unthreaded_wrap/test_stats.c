@@ -0,0 +1,116 @@
+#include "../include/ringbuf.h"
+#include "../include/slotring.h"
+#include <stdio.h>
+#include <string.h>
+
+#define RBUF_SIZE 1000  // bytes
+#define MSG_SIZE 100
+#define WAIT_NS 2000000L
+
+#define CHECK(cond, what) \
+    if (!(cond)) { \
+        printf("Error: %s (flags %#x)\n", what, flags); \
+        return 1; \
+    }
+
+int check_stats(rbctx_t *rb, int flags, size_t record_len)
+{
+    unsigned char msg[MSG_SIZE], read_buf[MSG_SIZE];
+    memset(msg, 'a', MSG_SIZE);
+    rbstats_t stats;
+
+    ringbuffer_get_stats(rb, &stats);
+    CHECK(stats.messages_in == 0 && stats.occupancy == 0 && stats.high_water == 0, "fresh ring has statistics");
+
+    /* fill the ring up */
+    size_t written = 0;
+    while (ringbuffer_write(rb, msg, MSG_SIZE) == SUCCESS) {
+        written++;
+    }
+    ringbuffer_get_stats(rb, &stats);
+    CHECK(stats.messages_in == written && stats.bytes_in == written * MSG_SIZE, "wrong messages in");
+    CHECK(stats.full == 1, "FULL was not counted");
+    CHECK(stats.occupancy == written * record_len && stats.high_water == stats.occupancy, "wrong occupancy");
+
+    /* a full ring times out in write_wait, an empty one in read_wait */
+    struct timespec deadline;
+    ringbuffer_deadline(&deadline, WAIT_NS);
+    CHECK(ringbuffer_write_wait(rb, msg, MSG_SIZE, &deadline) == RINGBUFFER_FULL, "write_wait did not time out");
+
+    size_t read_len = MSG_SIZE;
+    for (size_t i = 0; i < written; i++) {
+        CHECK(ringbuffer_read(rb, read_buf, &read_len) == SUCCESS, "read failed");
+    }
+    ringbuffer_deadline(&deadline, WAIT_NS);
+    CHECK(ringbuffer_read_wait(rb, read_buf, &read_len, &deadline) == RINGBUFFER_EMPTY, "read_wait did not time out");
+
+    ringbuffer_get_stats(rb, &stats);
+    CHECK(stats.messages_out == written && stats.bytes_out == written * MSG_SIZE, "wrong messages out");
+    CHECK(stats.empty >= 1, "EMPTY was not counted");
+    CHECK(stats.write_wait_ns >= WAIT_NS / 2 && stats.read_wait_ns >= WAIT_NS / 2, "waits were not timed");
+    CHECK(stats.occupancy == 0 && stats.high_water == written * record_len, "wrong high-water mark");
+
+    /* a new window starts from zero, its high-water mark from the current occupancy */
+    ringbuffer_write(rb, msg, MSG_SIZE);
+    ringbuffer_reset_stats(rb);
+    ringbuffer_get_stats(rb, &stats);
+    CHECK(stats.messages_in == 0 && stats.messages_out == 0 && stats.full == 0 && stats.empty == 0 &&
+          stats.write_wait_ns == 0 && stats.read_wait_ns == 0 && stats.write_splits == 0,
+          "reset kept counters");
+    CHECK(stats.occupancy == record_len && stats.high_water == record_len, "reset lost the occupancy");
+
+    /* the ring has wrapped meanwhile, messages across its end are counted as splits */
+    for (int i = 0; i < 20; i++) {
+        ringbuffer_write(rb, msg, MSG_SIZE);
+        ringbuffer_read(rb, read_buf, &read_len);
+    }
+    ringbuffer_read(rb, read_buf, &read_len);
+    ringbuffer_get_stats(rb, &stats);
+    CHECK(stats.messages_in == 20 && stats.messages_out == 21, "wrong counts after reset");
+    if (flags & RBUF_SLOTS) {
+        CHECK(stats.write_splits == 0 && stats.read_splits == 0, "slots split messages");
+    } else {
+        CHECK(stats.write_splits > 0 && stats.read_splits > 0, "splits were not counted");
+    }
+    return 0;
+}
+
+int check_mode(int flags)
+{
+    rbctx_t rb;
+    _Alignas(uint64_t) unsigned char memory[RBUF_SIZE];
+    ringbuffer_init_flags(&rb, memory, RBUF_SIZE, flags);
+    size_t record_len = flags & RBUF_FRAME_VARINT ? 2 + MSG_SIZE : sizeof(uint64_t) + MSG_SIZE;
+    if (flags & RBUF_MPMC) {
+        // a commit word in front, records start on 8 bytes
+        record_len = (sizeof(uint64_t) + record_len + 7) & ~(size_t) 7;
+    }
+    int ret = check_stats(&rb, flags, record_len);
+    ringbuffer_destroy(&rb);
+    return ret;
+}
+
+int main()
+{
+    int modes[] = {RBUF_LOCKED, RBUF_SPSC, RBUF_MPMC, RBUF_MPMC | RBUF_FRAME_VARINT};
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (check_mode(modes[i])) {
+            return 1;
+        }
+    }
+
+    /* slot rings count occupancy in slots */
+    int flags = RBUF_SLOTS;
+    slotring_t slots;
+    static uint64_t slot_memory[RBUF_SIZE / sizeof(uint64_t)];
+    CHECK(slotring_init(&slots, slot_memory, sizeof(slot_memory), MSG_SIZE) == SUCCESS, "no slot ring");
+    rbctx_t rb;
+    ringbuffer_init_slotring(&rb, &slots);
+    if (check_stats(&rb, flags, MSG_SIZE)) {
+        return 1;
+    }
+    ringbuffer_destroy(&rb);
+
+    printf("Test passed!\n");
+    return 0;
+}
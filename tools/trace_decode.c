@@ -0,0 +1,74 @@
+#include "../include/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* prints a trace file written by trace_dump, events of all threads merged by time
+ * cmd: ./build/tools/trace_decode trace.bin */
+
+int compare_events(const void *a, const void *b)
+{
+    const trace_event_t *event_a = a, *event_b = b;
+    if (event_a->timestamp_ns != event_b->timestamp_ns) {
+        return event_a->timestamp_ns < event_b->timestamp_ns ? -1 : 1;
+    }
+    return (int) event_a->thread - (int) event_b->thread;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "Too few arguments. Usage %s trace_file\n", argv[0]);
+        exit(1);
+    }
+
+    FILE *fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open file with name %s\n", argv[1]);
+        exit(1);
+    }
+
+    trace_file_header_t header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC)) != 0 ||
+        header.version != TRACE_FILE_VERSION || header.event_size != sizeof(trace_event_t)) {
+        fprintf(stderr, "%s is not a trace file of version %d\n", argv[1], TRACE_FILE_VERSION);
+        exit(1);
+    }
+
+    /* read the events of all threads into one array */
+    trace_event_t *events = NULL;
+    size_t number_of_events = 0;
+    trace_file_thread_t thread;
+    while (fread(&thread, sizeof(thread), 1, fp) == 1) {
+        events = realloc(events, (number_of_events + thread.number_of_events) * sizeof(trace_event_t));
+        if (events == NULL) {
+            fprintf(stderr, "Error: malloc failed\n");
+            exit(1);
+        }
+        if (fread(events + number_of_events, sizeof(trace_event_t), thread.number_of_events, fp) != thread.number_of_events) {
+            fprintf(stderr, "Error: trace of thread %u is truncated\n", thread.thread);
+            exit(1);
+        }
+        number_of_events += thread.number_of_events;
+    }
+    fclose(fp);
+
+    qsort(events, number_of_events, sizeof(trace_event_t), compare_events);
+
+    /* one line per event, time in microseconds since the first event */
+    for (size_t i = 0; i < number_of_events; i++) {
+        trace_event_t *event = &events[i];
+        const char *name = trace_event_name(event->event);
+        if (name == NULL) {
+            printf("%12.3f t%-3u unknown(%u) %lu %lu\n", (event->timestamp_ns - events[0].timestamp_ns) / 1000.0,
+                   event->thread, event->event, event->arg0, event->arg1);
+            continue;
+        }
+        printf("%12.3f t%-3u %-16s %s=%lu %s=%lu\n", (event->timestamp_ns - events[0].timestamp_ns) / 1000.0,
+               event->thread, name, trace_event_arg_name(event->event, 0), event->arg0,
+               trace_event_arg_name(event->event, 1), event->arg1);
+    }
+
+    free(events);
+    return 0;
+}